@@ -0,0 +1,578 @@
+// Runs io_load over a matrix of parameters, every combination --runs times
+// from a cold cache where that is permitted, and prints one CSV row per
+// combination and direction with the mean of each metric over the runs and
+// the half-width of its 95% confidence interval.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define MATRIX_MAX_VALUES 32
+#define MATRIX_MAX_EXTRA 64
+
+typedef enum {
+  AXIS_ENGINE,
+  AXIS_RW,
+  AXIS_TYPE,
+  AXIS_BLOCK_SIZE,
+  AXIS_BLOCK_COUNT,
+  AXIS_DIRECT,
+  AXIS_CACHE_PAGES,
+  AXIS_POLICY,
+  AXIS_COUNT
+} axis_id_t;
+
+// Each axis is an io_load flag taking a comma-separated list here. Axes of
+// the vtpc engine only are left out of the other engines' runs.
+static const struct {
+  const char* flag;
+  const char* column;
+  const char* defaults;
+  bool vtpc_only;
+} axes[] = {
+    [AXIS_ENGINE] = {"--engine", "engine", "psync,vtpc", false},
+    [AXIS_RW] = {"--rw", "rw", "read", false},
+    [AXIS_TYPE] = {"--type", "type", "sequence,random", false},
+    [AXIS_BLOCK_SIZE] = {"--block_size", "block_size", "4096", false},
+    [AXIS_BLOCK_COUNT] = {"--block_count", "block_count", "4096", false},
+    [AXIS_DIRECT] = {"--direct", "direct", "off", false},
+    [AXIS_CACHE_PAGES] = {"--cache_pages", "cache_pages", "0", true},
+    [AXIS_POLICY] = {"--policy", "policy", "mru", true},
+};
+
+typedef enum {
+  METRIC_IOPS,
+  METRIC_MIB,
+  METRIC_LAT_MEAN,
+  METRIC_LAT_P99,
+  METRIC_COUNT
+} metric_id_t;
+
+// io_load CSV columns, also the prefixes of ours.
+static const char* const metrics[] = {
+    [METRIC_IOPS] = "iops",
+    [METRIC_MIB] = "mib_per_s",
+    [METRIC_LAT_MEAN] = "lat_mean_us",
+    [METRIC_LAT_P99] = "lat_p99_us",
+};
+
+typedef struct {
+  char* values[MATRIX_MAX_VALUES];
+  int count;
+} axis_t;
+
+typedef struct {
+  const char* io_load;
+  const char* path;
+  const char* out_path;
+  int runs;
+  bool drop;
+  axis_t axes[AXIS_COUNT];
+  // Passed to every run after "--".
+  char* extra[MATRIX_MAX_EXTRA];
+  int extra_count;
+} matrix_t;
+
+// Samples of one direction, runs of METRIC_COUNT values.
+typedef struct {
+  double* values;
+  int count;
+} series_t;
+
+static void print_usage(const char* prog) {
+  fprintf(stderr,
+          "Usage: %s --file <path> [--io_load path] [--runs N] [--drop_caches on|off] [--out path]\n"
+          "          [--engine list] [--rw list] [--type list] [--block_size list]\n"
+          "          [--block_count list] [--direct list] [--cache_pages list] [--policy list]\n"
+          "          [-- io_load arguments for every run]\n"
+          "Lists are comma-separated values of the io_load flag of the same name.\n",
+          prog);
+}
+
+static bool parse_list(char* text, axis_t* axis) {
+  axis->count = 0;
+  char* save = NULL;
+  for (char* value = strtok_r(text, ",", &save); value != NULL; value = strtok_r(NULL, ",", &save)) {
+    if (axis->count == MATRIX_MAX_VALUES)
+      return false;
+    axis->values[axis->count++] = value;
+  }
+  return axis->count > 0;
+}
+
+static int parse_args(int argc, char* argv[], matrix_t* matrix) {
+  static char defaults[AXIS_COUNT][64];
+  memset(matrix, 0, sizeof(*matrix));
+  matrix->io_load = "io_load";
+  matrix->runs = 5;
+  matrix->drop = true;
+  for (int a = 0; a < AXIS_COUNT; ++a) {
+    snprintf(defaults[a], sizeof(defaults[a]), "%s", axes[a].defaults);
+    parse_list(defaults[a], &matrix->axes[a]);
+  }
+
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--") == 0) {
+      for (++i; i < argc; ++i) {
+        if (matrix->extra_count == MATRIX_MAX_EXTRA) {
+          fprintf(stderr, "Too many io_load arguments\n");
+          return -1;
+        }
+        matrix->extra[matrix->extra_count++] = argv[i];
+      }
+      break;
+    }
+    if (i + 1 >= argc) {
+      fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+      return -1;
+    }
+
+    int axis = 0;
+    while (axis < AXIS_COUNT && strcmp(argv[i], axes[axis].flag) != 0)
+      ++axis;
+    if (axis < AXIS_COUNT) {
+      if (!parse_list(argv[++i], &matrix->axes[axis])) {
+        fprintf(stderr, "%s takes 1 to %d comma-separated values\n", axes[axis].flag, MATRIX_MAX_VALUES);
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--file") == 0) {
+      matrix->path = argv[++i];
+    } else if (strcmp(argv[i], "--io_load") == 0) {
+      matrix->io_load = argv[++i];
+    } else if (strcmp(argv[i], "--out") == 0) {
+      matrix->out_path = argv[++i];
+    } else if (strcmp(argv[i], "--runs") == 0) {
+      matrix->runs = atoi(argv[++i]);
+      if (matrix->runs <= 0) {
+        fprintf(stderr, "runs must be > 0\n");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--drop_caches") == 0) {
+      const char* val = argv[++i];
+      if (strcmp(val, "on") == 0) {
+        matrix->drop = true;
+      } else if (strcmp(val, "off") == 0) {
+        matrix->drop = false;
+      } else {
+        fprintf(stderr, "--drop_caches accepts on/off\n");
+        return -1;
+      }
+    } else {
+      fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+      return -1;
+    }
+  }
+
+  if (matrix->path == NULL) {
+    fprintf(stderr, "--file is required\n");
+    return -1;
+  }
+  return 0;
+}
+
+// Reads of the largest combination have to fit, so a shorter file is filled
+// up with random bytes first rather than left with a hole.
+static int prepare_file(const matrix_t* matrix) {
+  uint64_t size = 0;
+  for (int s = 0; s < matrix->axes[AXIS_BLOCK_SIZE].count; ++s) {
+    for (int c = 0; c < matrix->axes[AXIS_BLOCK_COUNT].count; ++c) {
+      uint64_t bytes = strtoull(matrix->axes[AXIS_BLOCK_SIZE].values[s], NULL, 10) *
+                       strtoull(matrix->axes[AXIS_BLOCK_COUNT].values[c], NULL, 10);
+      if (bytes > size)
+        size = bytes;
+    }
+  }
+
+  int fd = open(matrix->path, O_WRONLY | O_CREAT, 0666);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    fprintf(stderr, "Failed to open %s: %s\n", matrix->path, strerror(errno));
+    if (fd >= 0)
+      close(fd);
+    return -1;
+  }
+
+  static uint64_t chunk[1 << 17];
+  uint64_t state = 0x9E3779B97F4A7C15ULL;
+  int result = 0;
+  for (uint64_t at = (uint64_t)st.st_size; at < size;) {
+    for (size_t i = 0; i < sizeof(chunk) / sizeof(chunk[0]); ++i) {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      chunk[i] = state;
+    }
+    size_t len = (size - at < sizeof(chunk)) ? (size_t)(size - at) : sizeof(chunk);
+    ssize_t done = pwrite(fd, chunk, len, (off_t)at);
+    if (done <= 0) {
+      fprintf(stderr, "Failed to fill %s: %s\n", matrix->path, strerror(errno));
+      result = -1;
+      break;
+    }
+    at += (uint64_t)done;
+  }
+  if (close(fd) != 0)
+    result = -1;
+  return result;
+}
+
+// All of the kernel page cache needs root; otherwise only the clean pages of
+// the file under test are dropped.
+static void drop_caches(const char* path) {
+  static bool warned = false;
+  sync();
+#if defined(__linux__)
+  int fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+  if (fd >= 0) {
+    bool dropped = write(fd, "3\n", 2) == 2;
+    close(fd);
+    if (dropped)
+      return;
+  }
+#endif
+#if defined(POSIX_FADV_DONTNEED)
+  int file = open(path, O_RDONLY);
+  if (file >= 0) {
+    posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED);
+    close(file);
+  }
+#endif
+  if (!warned) {
+    fprintf(stderr, "Cannot drop the whole page cache, dropping %s only\n", path);
+    warned = true;
+  }
+}
+
+// Whether the combination at index passes axis to io_load.
+static bool applies(const matrix_t* matrix, const int index[AXIS_COUNT], int axis) {
+  return !axes[axis].vtpc_only || strcmp(matrix->axes[AXIS_ENGINE].values[index[AXIS_ENGINE]], "vtpc") == 0;
+}
+
+// Runs io_load once for the combination at index and returns its CSV output,
+// or NULL after printing why, with what it wrote to stderr.
+static char* run_io_load(const matrix_t* matrix, const int index[AXIS_COUNT], int errors) {
+  char* argv[8 + 2 * AXIS_COUNT + MATRIX_MAX_EXTRA];
+  int argc = 0;
+  argv[argc++] = (char*)matrix->io_load;
+  argv[argc++] = "--file";
+  argv[argc++] = (char*)matrix->path;
+  argv[argc++] = "--output-format";
+  argv[argc++] = "csv";
+  for (int a = 0; a < AXIS_COUNT; ++a) {
+    if (!applies(matrix, index, a))
+      continue;
+    argv[argc++] = (char*)axes[a].flag;
+    argv[argc++] = matrix->axes[a].values[index[a]];
+  }
+  for (int i = 0; i < matrix->extra_count; ++i)
+    argv[argc++] = matrix->extra[i];
+  argv[argc] = NULL;
+
+  int out[2];
+  if (pipe(out) != 0) {
+    fprintf(stderr, "pipe failed: %s\n", strerror(errno));
+    return NULL;
+  }
+  if (ftruncate(errors, 0) != 0 || lseek(errors, 0, SEEK_SET) != 0) {
+    fprintf(stderr, "Failed to reset the error log: %s\n", strerror(errno));
+    close(out[0]);
+    close(out[1]);
+    return NULL;
+  }
+  fflush(NULL);
+  pid_t pid = fork();
+  if (pid < 0) {
+    fprintf(stderr, "fork failed: %s\n", strerror(errno));
+    close(out[0]);
+    close(out[1]);
+    return NULL;
+  }
+  if (pid == 0) {
+    dup2(out[1], STDOUT_FILENO);
+    dup2(errors, STDERR_FILENO);
+    close(out[0]);
+    close(out[1]);
+    execvp(argv[0], argv);
+    fprintf(stderr, "Failed to run %s: %s\n", argv[0], strerror(errno));
+    _exit(127);
+  }
+
+  close(out[1]);
+  size_t size = 0;
+  size_t capacity = 4096;
+  char* text = malloc(capacity);
+  for (;;) {
+    if (text != NULL && size + 1 == capacity) {
+      char* grown = realloc(text, capacity * 2);
+      if (grown == NULL) {
+        free(text);
+        text = NULL;
+      } else {
+        text = grown;
+        capacity *= 2;
+      }
+    }
+    char discard[4096];
+    char* into = (text != NULL) ? text + size : discard;
+    size_t room = (text != NULL) ? capacity - size - 1 : sizeof(discard);
+    ssize_t got = read(out[0], into, room);
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got <= 0)
+      break;
+    size += (text != NULL) ? (size_t)got : 0;
+  }
+  close(out[0]);
+
+  int status = 0;
+  while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+  }
+  if (text == NULL || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "Failed:");
+    for (int i = 0; i < argc; ++i)
+      fprintf(stderr, " %s", argv[i]);
+    fprintf(stderr, "\n");
+    char log[4096];
+    ssize_t got = pread(errors, log, sizeof(log) - 1, 0);
+    if (got > 0) {
+      log[got] = '\0';
+      fprintf(stderr, "%s", log);
+    }
+    free(text);
+    return NULL;
+  }
+  text[size] = '\0';
+  return text;
+}
+
+// Adds the "all" rows of an io_load CSV report to series, reads first, each
+// of which has room for runs rows.
+static int collect(char* text, series_t series[2], int runs) {
+  int columns[METRIC_COUNT];
+  int scope = -1;
+  int dir = -1;
+  char* save = NULL;
+  char* line = strtok_r(text, "\n", &save);
+  if (line == NULL)
+    return -1;
+  int column = 0;
+  char* field_save = NULL;
+  for (int m = 0; m < METRIC_COUNT; ++m)
+    columns[m] = -1;
+  for (char* field = strtok_r(line, ",", &field_save); field != NULL;
+       field = strtok_r(NULL, ",", &field_save), ++column) {
+    if (strcmp(field, "scope") == 0)
+      scope = column;
+    else if (strcmp(field, "dir") == 0)
+      dir = column;
+    for (int m = 0; m < METRIC_COUNT; ++m) {
+      if (strcmp(field, metrics[m]) == 0)
+        columns[m] = column;
+    }
+  }
+  for (int m = 0; m < METRIC_COUNT; ++m) {
+    if (columns[m] < 0)
+      return -1;
+  }
+  if (scope < 0 || dir < 0)
+    return -1;
+
+  int rows = 0;
+  while ((line = strtok_r(NULL, "\n", &save)) != NULL) {
+    double values[METRIC_COUNT];
+    bool all = false;
+    bool write = false;
+    column = 0;
+    for (char* field = strtok_r(line, ",", &field_save); field != NULL;
+         field = strtok_r(NULL, ",", &field_save), ++column) {
+      if (column == scope)
+        all = strcmp(field, "all") == 0;
+      else if (column == dir)
+        write = strcmp(field, "write") == 0;
+      for (int m = 0; m < METRIC_COUNT; ++m) {
+        if (column == columns[m])
+          values[m] = strtod(field, NULL);
+      }
+    }
+    series_t* into = &series[write];
+    if (!all || into->count == runs)
+      continue;
+    memcpy(&into->values[(size_t)into->count * METRIC_COUNT], values, sizeof(values));
+    into->count++;
+    rows++;
+  }
+  return rows > 0 ? 0 : -1;
+}
+
+// Two-sided 95% quantile of Student's t with df degrees of freedom.
+static double t_quantile(int df) {
+  static const double table[] = {
+      12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131,
+      2.120,  2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+  };
+  if (df <= 30)
+    return table[df - 1];
+  return df <= 60 ? 2.000 : (df <= 120 ? 1.980 : 1.960);
+}
+
+static void print_header(FILE* out) {
+  for (int a = 0; a < AXIS_COUNT; ++a)
+    fprintf(out, "%s,", axes[a].column);
+  fprintf(out, "dir,runs");
+  for (int m = 0; m < METRIC_COUNT; ++m)
+    fprintf(out, ",%s_mean,%s_ci95", metrics[m], metrics[m]);
+  fprintf(out, "\n");
+}
+
+// The interval is left empty for a single run.
+static void print_row(FILE* out, const matrix_t* matrix, const int index[AXIS_COUNT], bool write,
+                      const series_t* series) {
+  for (int a = 0; a < AXIS_COUNT; ++a)
+    fprintf(out, "%s,", applies(matrix, index, a) ? matrix->axes[a].values[index[a]] : "-");
+  fprintf(out, "%s,%d", write ? "write" : "read", series->count);
+  int n = series->count;
+  for (int m = 0; m < METRIC_COUNT; ++m) {
+    double sum = 0;
+    for (int r = 0; r < n; ++r)
+      sum += series->values[r * METRIC_COUNT + m];
+    double mean = sum / n;
+    if (n < 2) {
+      fprintf(out, ",%.3f,", mean);
+      continue;
+    }
+    double squares = 0;
+    for (int r = 0; r < n; ++r) {
+      double diff = series->values[r * METRIC_COUNT + m] - mean;
+      squares += diff * diff;
+    }
+    double half = t_quantile(n - 1) * sqrt(squares / (n - 1)) / sqrt(n);
+    fprintf(out, ",%.3f,%.3f", mean, half);
+  }
+  fprintf(out, "\n");
+  fflush(out);
+}
+
+// Other engines than vtpc run the first value of the vtpc axes only. io_load
+// lets --type override the order of --rw randrw, so randrw runs with the
+// random type only rather than under a label it does not match.
+static bool runs(const matrix_t* matrix, const int index[AXIS_COUNT]) {
+  for (int a = 0; a < AXIS_COUNT; ++a) {
+    if (!applies(matrix, index, a) && index[a] != 0)
+      return false;
+  }
+  return strcmp(matrix->axes[AXIS_RW].values[index[AXIS_RW]], "randrw") != 0 ||
+         strcmp(matrix->axes[AXIS_TYPE].values[index[AXIS_TYPE]], "random") == 0;
+}
+
+// Steps index to the next combination that runs, false after the last one.
+static bool next_combination(const matrix_t* matrix, int index[AXIS_COUNT]) {
+  for (;;) {
+    int a = AXIS_COUNT - 1;
+    while (a >= 0 && ++index[a] == matrix->axes[a].count)
+      index[a--] = 0;
+    if (a < 0)
+      return false;
+    if (runs(matrix, index))
+      return true;
+  }
+}
+
+// Sets index to the first combination that runs, false if none does.
+static bool first_combination(const matrix_t* matrix, int index[AXIS_COUNT]) {
+  for (int a = 0; a < AXIS_COUNT; ++a)
+    index[a] = 0;
+  return runs(matrix, index) || next_combination(matrix, index);
+}
+
+static int count_combinations(const matrix_t* matrix) {
+  int index[AXIS_COUNT];
+  int count = 0;
+  for (bool more = first_combination(matrix, index); more; more = next_combination(matrix, index))
+    ++count;
+  return count;
+}
+
+int main(int argc, char* argv[]) {
+  matrix_t matrix;
+  if (parse_args(argc, argv, &matrix) != 0) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  int total = count_combinations(&matrix);
+  if (total == 0) {
+    fprintf(stderr, "No combination to run: randrw needs --type random\n");
+    return 1;
+  }
+  if (prepare_file(&matrix) != 0)
+    return 1;
+
+  FILE* out = stdout;
+  if (matrix.out_path != NULL) {
+    out = fopen(matrix.out_path, "w");
+    if (out == NULL) {
+      fprintf(stderr, "Failed to open %s: %s\n", matrix.out_path, strerror(errno));
+      return 1;
+    }
+  }
+  FILE* errors = tmpfile();
+  series_t series[2];
+  for (int d = 0; d < 2; ++d)
+    series[d].values = malloc((size_t)matrix.runs * METRIC_COUNT * sizeof(double));
+  if (errors == NULL || series[0].values == NULL || series[1].values == NULL) {
+    fprintf(stderr, "Failed to set up: %s\n", strerror(errno));
+    return 1;
+  }
+
+  print_header(out);
+  int failed = 0;
+  int index[AXIS_COUNT];
+  first_combination(&matrix, index);
+  int number = 1;
+  do {
+    fprintf(stderr, "[%d/%d]", number++, total);
+    for (int a = 0; a < AXIS_COUNT; ++a) {
+      if (applies(&matrix, index, a))
+        fprintf(stderr, " %s=%s", axes[a].column, matrix.axes[a].values[index[a]]);
+    }
+    fprintf(stderr, "\n");
+
+    series[0].count = series[1].count = 0;
+    bool ok = true;
+    for (int r = 0; ok && r < matrix.runs; ++r) {
+      if (matrix.drop)
+        drop_caches(matrix.path);
+      char* text = run_io_load(&matrix, index, fileno(errors));
+      if (text == NULL || collect(text, series, matrix.runs) != 0) {
+        if (text != NULL)
+          fprintf(stderr, "io_load printed no results\n");
+        ok = false;
+      }
+      free(text);
+    }
+    if (!ok) {
+      failed++;
+      continue;
+    }
+    for (int d = 0; d < 2; ++d) {
+      if (series[d].count > 0)
+        print_row(out, &matrix, index, d == 1, &series[d]);
+    }
+  } while (next_combination(&matrix, index));
+
+  fprintf(stderr, "%d of %d combinations failed\n", failed, total);
+  free(series[0].values);
+  free(series[1].values);
+  fclose(errors);
+  if (out != stdout && fclose(out) != 0)
+    failed++;
+  return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,250 @@
+#include <benchmark/benchmark.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "file.hpp"
+
+extern "C" {
+#include <fcntl.h>
+
+#include "vtpc.h"
+}
+
+namespace {
+
+constexpr const char* bench_path = "/tmp/vtpc_bench";
+
+enum backend : int64_t {
+  libc = 0,
+  vtpc = 1,
+};
+
+// Every benchmark takes {backend, capacity in pages, page size in KiB}; the
+// libc backend ignores the last two and is registered once.
+auto open(const benchmark::State& state) -> std::unique_ptr<vt::file> {
+  if (state.range(0) == backend::libc) {
+    return vt::file::open_libc(bench_path);
+  }
+
+  vtpc_options options;
+  vtpc_options_init(&options);
+  options.capacity = static_cast<size_t>(state.range(1));
+  options.page_size = static_cast<size_t>(state.range(2)) << 10U;
+  return vt::file::open_vtpc(bench_path, options);
+}
+
+auto page_size(const benchmark::State& state) -> size_t {
+  return static_cast<size_t>(state.range(2)) << 10U;
+}
+
+auto label(benchmark::State& state) -> void {
+  state.SetLabel(state.range(0) == backend::libc ? "libc" : "vtpc");
+}
+
+auto prefill(size_t size) -> void {
+  auto file = vt::file::open_libc(bench_path);
+  file->seek(0);
+  file->write(std::string(size, 'x'));
+  file->sync();
+}
+
+// Small reads from one resident page.
+auto bm_hit_read(benchmark::State& state) -> void {
+  prefill(page_size(state));
+  auto file = open(state);
+  std::string buffer(64, 0);  // NOLINT
+  file->seek(0);
+  file->read(buffer.data(), buffer.size());
+
+  for (auto _ : state) {
+    file->seek(0);
+    file->read(buffer.data(), buffer.size());
+    benchmark::DoNotOptimize(buffer.data());
+  }
+
+  state.SetBytesProcessed(state.iterations() * int64_t(buffer.size()));
+  label(state);
+}
+
+// Small reads walking one resident page through vtpc_read itself, so every
+// read but the one after the rewind at the end of the page takes the fast
+// path without a seek in between.
+auto bm_hit_read_raw(benchmark::State& state) -> void {
+  const size_t page = page_size(state);
+  prefill(page);
+  vtpc_options options;
+  vtpc_options_init(&options);
+  options.capacity = static_cast<size_t>(state.range(1));
+  options.page_size = page;
+  const int fd = vtpc_open_ex(bench_path, O_RDONLY, 0, &options);
+  if (fd < 0) {
+    state.SkipWithError("vtpc_open_ex failed");
+    return;
+  }
+  std::string buffer(64, 0);  // NOLINT
+  vtpc_read(fd, buffer.data(), buffer.size());
+  size_t position = buffer.size();
+
+  for (auto _ : state) {
+    if (position == page) {
+      vtpc_lseek(fd, 0, SEEK_SET);
+      position = 0;
+    }
+    benchmark::DoNotOptimize(vtpc_read(fd, buffer.data(), buffer.size()));
+    position += buffer.size();
+  }
+
+  vtpc_close(fd);
+  state.SetBytesProcessed(state.iterations() * int64_t(buffer.size()));
+  label(state);
+}
+
+// Page-sized random reads over a file eight times the cache.
+auto bm_miss_read(benchmark::State& state) -> void {
+  const size_t page = page_size(state);
+  const size_t pages = 8 * static_cast<size_t>(state.range(1));
+  prefill(pages * page);
+  auto file = open(state);
+  std::string buffer(page, 0);
+  std::mt19937_64 random(1);
+  std::uniform_int_distribution<size_t> page_dist(0, pages - 1);
+
+  for (auto _ : state) {
+    file->seek(static_cast<off_t>(page_dist(random) * page));
+    file->read(buffer.data(), buffer.size());
+    benchmark::DoNotOptimize(buffer.data());
+  }
+
+  state.SetBytesProcessed(state.iterations() * int64_t(page));
+  label(state);
+}
+
+// Dirty every resident page, then write them all back.
+auto bm_flush(benchmark::State& state) -> void {
+  const size_t page = page_size(state);
+  const size_t pages = static_cast<size_t>(state.range(1));
+  prefill(pages * page);
+  auto file = open(state);
+  const std::string buffer(page, 'y');
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    for (size_t i = 0; i < pages; ++i) {
+      file->seek(static_cast<off_t>(i * page));
+      file->write(buffer.data(), buffer.size());
+    }
+    state.ResumeTiming();
+    file->sync();
+  }
+
+  state.SetBytesProcessed(state.iterations() * int64_t(pages * page));
+  label(state);
+}
+
+// Sequential page writes over four times the cache, so every write past
+// the first lap evicts a dirty page.
+auto bm_evict(benchmark::State& state) -> void {
+  const size_t page = page_size(state);
+  const size_t pages = 4 * static_cast<size_t>(state.range(1));
+  prefill(pages * page);
+  auto file = open(state);
+  const std::string buffer(page, 'z');
+  size_t next = 0;
+
+  for (auto _ : state) {
+    file->seek(static_cast<off_t>(next * page));
+    file->write(buffer.data(), buffer.size());
+    next = (next + 1) % pages;
+  }
+
+  state.SetBytesProcessed(state.iterations() * int64_t(page));
+  label(state);
+}
+
+auto bm_open_close(benchmark::State& state) -> void {
+  prefill(page_size(state));
+
+  for (auto _ : state) {
+    auto file = open(state);
+    benchmark::DoNotOptimize(file.get());
+  }
+
+  label(state);
+}
+
+// One dirty byte per fsync, the cost of a durable small update.
+auto bm_fsync(benchmark::State& state) -> void {
+  prefill(page_size(state));
+  auto file = open(state);
+
+  for (auto _ : state) {
+    file->seek(0);
+    file->write("f", 1);
+    file->sync();
+  }
+
+  label(state);
+}
+
+// 70% reads, 30% writes of 512 B to 16 KiB at random offsets over a file
+// four times the cache.
+auto bm_mixed(benchmark::State& state) -> void {
+  const size_t size = 4 * static_cast<size_t>(state.range(1)) * page_size(state);
+  constexpr size_t max_count = 16 << 10U;
+  prefill(size + max_count);
+  auto file = open(state);
+  std::string buffer(max_count, 'm');
+  std::mt19937_64 random(2);
+  std::uniform_int_distribution<size_t> action_dist(0, 99);  // NOLINT
+  std::uniform_int_distribution<size_t> offset_dist(0, size);
+  std::uniform_int_distribution<size_t> count_dist(512, max_count);  // NOLINT
+  int64_t bytes = 0;
+
+  for (auto _ : state) {
+    const size_t count = count_dist(random);
+    file->seek(static_cast<off_t>(offset_dist(random)));
+    if (action_dist(random) < 70) {  // NOLINT
+      file->read(buffer.data(), count);
+    } else {
+      file->write(buffer.data(), count);
+    }
+    bytes += int64_t(count);
+  }
+
+  state.SetBytesProcessed(bytes);
+  label(state);
+}
+
+auto vtpc_matrix(benchmark::internal::Benchmark* bench) -> void {
+  bench->ArgNames({"backend", "capacity", "page_kib"});
+  for (int64_t capacity : {64, 1024}) {  // NOLINT
+    for (int64_t page_kib : {4, 16, 64}) {  // NOLINT
+      bench->Args({backend::vtpc, capacity, page_kib});
+    }
+  }
+}
+
+auto matrix(benchmark::internal::Benchmark* bench) -> void {
+  bench->Args({backend::libc, 64, 4});  // NOLINT
+  vtpc_matrix(bench);
+}
+
+}  // namespace
+
+BENCHMARK(bm_hit_read)->Apply(matrix);
+BENCHMARK(bm_hit_read_raw)->Apply(vtpc_matrix);
+BENCHMARK(bm_miss_read)->Apply(matrix);
+BENCHMARK(bm_flush)->Apply(matrix);
+BENCHMARK(bm_evict)->Apply(matrix);
+BENCHMARK(bm_open_close)->Apply(matrix);
+BENCHMARK(bm_fsync)->Apply(matrix);
+BENCHMARK(bm_mixed)->Apply(matrix);
+
+BENCHMARK_MAIN();
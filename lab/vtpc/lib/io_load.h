@@ -2,11 +2,13 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <sys/types.h>
 
 typedef enum {
   MODE_READ,
-  MODE_WRITE
+  MODE_WRITE,
+  MODE_MIXED
 } io_mode_t;
 
 typedef enum {
@@ -14,9 +16,60 @@ typedef enum {
   ORDER_RANDOM
 } io_order_t;
 
+typedef enum {
+  ADVICE_NONE,
+  ADVICE_NORMAL,
+  ADVICE_SEQUENTIAL,
+  ADVICE_RANDOM,
+  ADVICE_WILLNEED,
+  ADVICE_DONTNEED,
+  ADVICE_NOREUSE
+} io_advice_t;
+
+typedef enum {
+  OUTPUT_TEXT,
+  OUTPUT_JSON,
+  OUTPUT_CSV
+} io_output_t;
+
+typedef enum {
+  DIST_UNIFORM,
+  DIST_ZIPF,
+  DIST_PARETO,
+  DIST_HOTSPOT,
+  DIST_NORMAL
+} io_dist_kind_t;
+
+// Random-order offset distribution from --dist. param is the zipf theta, the
+// pareto h or the normal standard deviation in percent of the range;
+// hotspot sends hot_ops of the operations to the first hot_space of it.
+typedef struct {
+  io_dist_kind_t kind;
+  double param;
+  double hot_ops;
+  double hot_space;
+} io_dist_t;
+
+typedef enum {
+  ARRIVAL_CONSTANT,
+  ARRIVAL_POISSON
+} io_arrival_t;
+
+typedef enum {
+  POLICY_MRU,
+  POLICY_LRU,
+  POLICY_FIFO,
+  POLICY_CLOCK
+} io_policy_t;
+
 typedef struct {
   io_mode_t mode;
+  // Offsets step by block_size, the larger of the two transfer sizes.
   size_t block_size;
+  size_t read_size;
+  size_t write_size;
+  // Percent of reads in MODE_MIXED.
+  unsigned rwmixread;
   size_t block_count;
   const char* path;
   int repeat;
@@ -25,8 +78,248 @@ typedef struct {
   bool range_set;
   off_t range_start;
   off_t range_end;
+  io_advice_t advice;
+  int threads;
+  bool shared;
+  const struct io_engine* engine;
+  // vtpc engine only: resident pages, 0 for the library default, and the
+  // replacement policy.
+  size_t cache_pages;
+  io_policy_t policy;
+  unsigned iodepth;
+  io_output_t output;
+  io_dist_t dist;
+  // Target IOPS over all threads, 0 runs closed-loop. Latency then counts
+  // from each transfer's scheduled start, not from when it was issued.
+  double rate;
+  io_arrival_t arrival;
+  // Seconds. runtime > 0 repeats passes until it is up, after ramp seconds
+  // of warm-up that count only towards the interval rows, if any.
+  double runtime;
+  double ramp;
+  double interval;
+  // Stamp every written block and check every block read, see io_verify_t.
+  bool verify;
+  // --trace file to replay instead of the generated pattern, and whether to
+  // keep its recorded timing. run_io_workload() loads it into trace.
+  const char* trace_path;
+  bool trace_timed;
+  const struct io_trace* trace;
 } options_t;
 
+// Per-thread xoshiro256** state.
+typedef struct {
+  uint64_t s[4];
+} io_rng_t;
+
+// A distribution over slots with its constants precomputed, so each draw is
+// O(1). Read-only once set up and shared by the threads of a worker.
+typedef struct {
+  io_dist_t dist;
+  uint64_t slots;
+  uint64_t stride;
+  double zeta_n;
+  double alpha;
+  double eta;
+  double half_pow;
+  double pareto_pow;
+  uint64_t hot_slots;
+} io_sampler_t;
+
+void rng_seed(io_rng_t* rng, uint64_t seed);
+uint64_t rng_next(io_rng_t* rng);
+// Uniform in [0, 1).
+double rng_double(io_rng_t* rng);
+bool parse_dist(const char* text, io_dist_t* dist);
+void sampler_init(io_sampler_t* sampler, const io_dist_t* dist, uint64_t slots);
+uint64_t sampler_next(const io_sampler_t* sampler, io_rng_t* rng);
+
+// Log-linear latency histogram in nanoseconds: exact below 64 ns, then 32
+// buckets per power of two (about 3% apart) up to 2^40 ns, where it clamps.
+#define IO_HIST_SUB_BITS 5
+#define IO_HIST_MAX_BITS 40
+#define IO_HIST_BUCKETS ((IO_HIST_MAX_BITS - IO_HIST_SUB_BITS + 1) << IO_HIST_SUB_BITS)
+
+typedef struct {
+  uint64_t counts[IO_HIST_BUCKETS];
+} io_hist_t;
+
+static inline void hist_record(io_hist_t* hist, uint64_t ns) {
+  unsigned bucket;
+  if (ns < (2U << IO_HIST_SUB_BITS)) {
+    bucket = (unsigned)ns;
+  } else {
+    unsigned shift = (unsigned)(63 - __builtin_clzll(ns)) - IO_HIST_SUB_BITS;
+    bucket = (shift << IO_HIST_SUB_BITS) + (unsigned)(ns >> shift);
+    if (bucket >= IO_HIST_BUCKETS)
+      bucket = IO_HIST_BUCKETS - 1;
+  }
+  hist->counts[bucket]++;
+}
+
+// Latency at percentile pct (0..100) of count recorded values, the middle of
+// its bucket.
+uint64_t hist_percentile(const io_hist_t* hist, uint64_t count, double pct);
+
+// Latency runs from queueing a request to reaping it; the submit part ends
+// when the submitting call returns and is 0 for synchronous transfers.
+typedef struct {
+  size_t ops;
+  uint64_t bytes;
+  uint64_t latency_sum_ns;
+  uint64_t latency_min_ns;
+  uint64_t latency_max_ns;
+  uint64_t submit_sum_ns;
+  uint64_t submit_max_ns;
+  io_hist_t latency;
+  double seconds;
+} io_stats_t;
+
+typedef enum {
+  SCOPE_ITERATION,
+  SCOPE_INTERVAL,
+  SCOPE_THREAD,
+  SCOPE_ALL
+} io_scope_t;
+
+typedef struct {
+  void* buffer;
+  size_t count;
+  off_t offset;
+  bool write;
+  ssize_t result;
+  int error;
+  uint64_t queued_ns;
+  uint64_t submitted_ns;
+  // Under --verify, what verify_fill() or verify_reading() returned.
+  uint64_t token;
+} io_request_t;
+
+// One transfer of block_size bytes at offset, safe to call from several
+// threads at once. Returns the bytes done or -1 with errno set.
+typedef ssize_t (*io_op_t)(void* ctx, void* buffer, size_t count, off_t offset);
+
+// How the workers reach the file. open() gets the options with the range
+// resolved and returns a context shared by all workers, or NULL after
+// printing why. close() writes back, prints engine statistics and frees it.
+typedef struct io_engine {
+  const char* name;
+  void* (*open)(const options_t* opts);
+  void (*advise)(void* ctx, const options_t* opts);
+  io_op_t read;
+  io_op_t write;
+  int (*close)(void* ctx);
+  // Optional: writes back to stable storage, for the fsyncs of a --trace.
+  int (*sync)(void* ctx);
+  // Optional queue-depth interface, one queue per worker. submit() hands
+  // count requests to the kernel in one call; reap() waits for at least min
+  // completions and returns up to max of them with result and error set.
+  // Engines without it run --iodepth as a pool of synchronous threads.
+  void* (*queue_open)(void* ctx, unsigned depth);
+  int (*submit)(void* queue, io_request_t** requests, unsigned count);
+  int (*reap)(void* queue, io_request_t** done, unsigned max, unsigned min);
+  void (*queue_close)(void* queue);
+} io_engine_t;
+
+extern const io_engine_t io_engine_psync;
+extern const io_engine_t io_engine_vtpc;
+extern const io_engine_t io_engine_mmap;
+extern const io_engine_t io_engine_uring;
+extern const io_engine_t io_engine_aio;
+
+const io_engine_t* find_engine(const char* name);
+// Helpers for engines working on a plain descriptor: open() for the mode,
+// printing why on failure, and posix_fadvise() of the range.
+int open_flags(const options_t* opts);
+int open_fd(const options_t* opts);
+void advise_fd(int fd, const options_t* opts);
+
 void print_usage(const char* prog);
 int parse_args(int argc, char* argv[], options_t* opts);
 int run_io_workload(const options_t* opts);
+
+// --verify state shared by all workers. Each written block starts with a
+// header holding its offset, this run's epoch and a per-block generation,
+// followed by filler derived from both and covered by a CRC32C. Per block
+// of the range, state counts the writes issued and those still in flight,
+// committed is the oldest generation a read may still return, and overlapped
+// the newest write issued while another one was in flight.
+typedef struct {
+  uint64_t epoch;
+  off_t range_start;
+  size_t block_size;
+  size_t slots;
+  uint64_t* state;
+  uint64_t* committed;
+  uint64_t* overlapped;
+  uint64_t failed;
+  unsigned reports;
+} io_verify_t;
+
+// CRC32C (Castagnoli), with the SSE4.2 or ARMv8 instruction when the CPU has
+// it; verify_init() picks the implementation.
+uint32_t crc32c(uint32_t crc, const void* data, size_t len);
+bool verify_hardware(void);
+int verify_init(io_verify_t* verify, const options_t* opts);
+void verify_free(io_verify_t* verify);
+// Fills count bytes for offset and returns a token for verify_written(),
+// which is called once the write is done.
+uint64_t verify_fill(io_verify_t* verify, void* buffer, size_t count, off_t offset);
+void verify_written(io_verify_t* verify, off_t offset, uint64_t token);
+// Called before a read is issued; the token it returns goes to verify_check().
+uint64_t verify_reading(io_verify_t* verify, off_t offset);
+// Checks a block read at offset, printing the first few mismatches.
+bool verify_check(io_verify_t* verify, const void* buffer, size_t count, off_t offset, uint64_t token);
+
+typedef enum {
+  TRACE_READ,
+  TRACE_WRITE,
+  TRACE_SYNC
+} io_trace_kind_t;
+
+typedef struct {
+  // Since the first operation of the trace.
+  uint64_t time_ns;
+  uint64_t offset;
+  uint32_t length;
+  uint16_t kind;
+  // Replaying thread, one per thread id the trace recorded.
+  uint16_t stream;
+} io_trace_op_t;
+
+// A trace grouped by stream: stream s owns ops[starts[s]] up to
+// ops[starts[s + 1]], in recorded order.
+typedef struct io_trace {
+  io_trace_op_t* ops;
+  size_t count;
+  size_t* starts;
+  int streams;
+  uint64_t span_ns;
+  uint32_t max_length;
+  uint64_t end;
+  size_t reads;
+  size_t writes;
+  size_t syncs;
+} io_trace_t;
+
+// Reads a vtpc binary trace (vtpc_trace.h) or a text one with a line per
+// operation: "<ns> <r|w|s> <offset> <length> [<thread id>]".
+int load_trace(const char* path, io_trace_t* trace);
+void free_trace(io_trace_t* trace);
+
+// Bytes the workers cover from range_start: one worker's share, times the
+// thread count unless they share the range.
+off_t workload_span(const options_t* opts);
+// Runs opts->threads workers of opts->repeat passes over their sub-ranges of
+// [range_start, range_end), each keeping opts->iodepth transfers in flight
+// through the engine context, and prints per-thread and aggregate results.
+// Returns 0 on success and the wall time in *seconds.
+int run_workers(const options_t* opts, void* ctx, double* seconds);
+
+// Results in opts->output: text lines, CSV records under one header, or one
+// JSON document whose "results" array holds a row per report_stats() call.
+void report_begin(const options_t* opts);
+// stats holds the reads, then the writes; mixed runs report both.
+void report_stats(const options_t* opts, io_scope_t scope, int index, const io_stats_t stats[2]);
+// Closes the JSON document of failed runs too, with "ok" set to false.
+void report_end(const options_t* opts, double seconds, bool ok);
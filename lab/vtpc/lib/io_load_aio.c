@@ -0,0 +1,85 @@
+#include "io_load.h"
+
+#include <aio.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct {
+  int fd;
+} aio_t;
+
+static void* aio_open(const options_t* opts) {
+  aio_t* ctx = malloc(sizeof(*ctx));
+  if (ctx == NULL) {
+    fprintf(stderr, "malloc failed\n");
+    return NULL;
+  }
+
+  ctx->fd = open_fd(opts);
+  if (ctx->fd < 0) {
+    free(ctx);
+    return NULL;
+  }
+  return ctx;
+}
+
+static void aio_advise(void* ctx, const options_t* opts) {
+  advise_fd(((aio_t*)ctx)->fd, opts);
+}
+
+// Submits one request and waits for it, one in flight per worker.
+static ssize_t aio_transfer(aio_t* ctx, void* buffer, size_t count, off_t offset, bool write) {
+  struct aiocb cb;
+  memset(&cb, 0, sizeof(cb));
+  cb.aio_fildes = ctx->fd;
+  cb.aio_buf = buffer;
+  cb.aio_nbytes = count;
+  cb.aio_offset = offset;
+  if ((write ? aio_write(&cb) : aio_read(&cb)) != 0)
+    return -1;
+
+  const struct aiocb* list[] = {&cb};
+  while (aio_error(&cb) == EINPROGRESS) {
+    if (aio_suspend(list, 1, NULL) != 0 && errno != EINTR)
+      return -1;
+  }
+
+  int err = aio_error(&cb);
+  ssize_t done = aio_return(&cb);
+  if (err != 0) {
+    errno = err;
+    return -1;
+  }
+  return done;
+}
+
+static ssize_t aio_read_block(void* ctx, void* buffer, size_t count, off_t offset) {
+  return aio_transfer(ctx, buffer, count, offset, false);
+}
+
+static ssize_t aio_write_block(void* ctx, void* buffer, size_t count, off_t offset) {
+  return aio_transfer(ctx, buffer, count, offset, true);
+}
+
+static int aio_sync(void* ctx) {
+  return fsync(((aio_t*)ctx)->fd);
+}
+
+static int aio_close(void* ctx) {
+  int result = close(((aio_t*)ctx)->fd);
+  free(ctx);
+  return result;
+}
+
+const io_engine_t io_engine_aio = {
+    .name = "posix_aio",
+    .open = aio_open,
+    .advise = aio_advise,
+    .read = aio_read_block,
+    .write = aio_write_block,
+    .close = aio_close,
+    .sync = aio_sync,
+};
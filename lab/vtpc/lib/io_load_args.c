@@ -34,17 +34,84 @@ static bool parse_range(const char* text, off_t* start, off_t* end, bool* range_
   return true;
 }
 
+// One size for both directions, or "read,write".
+static bool parse_block_size(const char* text, options_t* opts) {
+  char* end = NULL;
+  opts->read_size = (size_t)strtoull(text, &end, 10);
+  opts->write_size = opts->read_size;
+  if (*end == ',')
+    opts->write_size = (size_t)strtoull(end + 1, &end, 10);
+  if (*end != '\0' || opts->read_size == 0 || opts->write_size == 0)
+    return false;
+  opts->block_size = opts->read_size > opts->write_size ? opts->read_size : opts->write_size;
+  return true;
+}
+
+static bool parse_advice(const char* text, io_advice_t* advice) {
+  static const struct {
+    const char* name;
+    io_advice_t advice;
+  } names[] = {
+      {"normal", ADVICE_NORMAL},
+      {"sequential", ADVICE_SEQUENTIAL},
+      {"random", ADVICE_RANDOM},
+      {"willneed", ADVICE_WILLNEED},
+      {"dontneed", ADVICE_DONTNEED},
+      {"noreuse", ADVICE_NOREUSE},
+  };
+
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+    if (strcmp(text, names[i].name) == 0) {
+      *advice = names[i].advice;
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool parse_policy(const char* text, io_policy_t* policy) {
+  static const struct {
+    const char* name;
+    io_policy_t policy;
+  } names[] = {
+      {"mru", POLICY_MRU},
+      {"lru", POLICY_LRU},
+      {"fifo", POLICY_FIFO},
+      {"clock", POLICY_CLOCK},
+  };
+
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+    if (strcmp(text, names[i].name) == 0) {
+      *policy = names[i].policy;
+      return true;
+    }
+  }
+  return false;
+}
+
 void print_usage(const char* prog) {
   fprintf(stderr,
-          "Usage: %s --rw <read|write> --block_size <bytes> --block_count <count>\n"
+          "Usage: %s --rw <read|write|rw|randrw> --block_size <bytes>[,<write bytes>]\n"
+          "          --block_count <count> [--rwmixread percent]\n"
           "          --file <path> [--range start-end] [--direct on|off]\n"
-          "          [--type sequence|random] [--repeat N]\n",
+          "          [--type sequence|random] [--repeat N]\n"
+          "          [--fadvise normal|sequential|random|willneed|dontneed|noreuse]\n"
+          "          [--threads N] [--split disjoint|shared]\n"
+          "          [--engine psync|vtpc|mmap|io_uring|posix_aio] [--iodepth N]\n"
+          "          [--cache_pages N] [--policy mru|lru|fifo|clock]\n"
+          "          [--output-format text|json|csv] [--rate IOPS] [--arrival constant|poisson]\n"
+          "          [--runtime sec] [--ramp sec] [--interval sec] [--verify]\n"
+          "          [--trace path] [--replay fast|timed]\n"
+          "          [--dist uniform|zipf[:theta]|pareto[:h]|hotspot[:ops%%/space%%]|normal[:stddev%%]]\n",
           prog);
 }
 
 int parse_args(int argc, char* argv[], options_t* opts) {
   opts->mode = MODE_READ;
   opts->block_size = 4096;
+  opts->read_size = 4096;
+  opts->write_size = 4096;
+  opts->rwmixread = 50;
   opts->block_count = 1024;
   opts->path = NULL;
   opts->repeat = 1;
@@ -53,6 +120,26 @@ int parse_args(int argc, char* argv[], options_t* opts) {
   opts->range_set = false;
   opts->range_start = 0;
   opts->range_end = 0;
+  opts->advice = ADVICE_NONE;
+  opts->threads = 1;
+  opts->shared = false;
+  opts->engine = &io_engine_psync;
+  opts->cache_pages = 0;
+  opts->policy = POLICY_MRU;
+  bool cache_set = false;
+  opts->iodepth = 1;
+  opts->output = OUTPUT_TEXT;
+  parse_dist("uniform", &opts->dist);
+  opts->rate = 0;
+  opts->arrival = ARRIVAL_CONSTANT;
+  opts->runtime = 0;
+  opts->ramp = 0;
+  opts->interval = 0;
+  opts->verify = false;
+  opts->trace_path = NULL;
+  opts->trace_timed = false;
+  opts->trace = NULL;
+  bool replay_set = false;
 
   for (int i = 1; i < argc; ++i) {
     if (strcmp(argv[i], "--rw") == 0 && i + 1 < argc) {
@@ -61,16 +148,28 @@ int parse_args(int argc, char* argv[], options_t* opts) {
         opts->mode = MODE_READ;
       } else if (strcmp(mode, "write") == 0) {
         opts->mode = MODE_WRITE;
+      } else if (strcmp(mode, "rw") == 0) {
+        opts->mode = MODE_MIXED;
+        opts->order = ORDER_SEQUENCE;
+      } else if (strcmp(mode, "randrw") == 0) {
+        opts->mode = MODE_MIXED;
+        opts->order = ORDER_RANDOM;
       } else {
         fprintf(stderr, "Unknown --rw value: %s\n", mode);
         return -1;
       }
     } else if (strcmp(argv[i], "--block_size") == 0 && i + 1 < argc) {
-      opts->block_size = (size_t)strtoull(argv[++i], NULL, 10);
-      if (opts->block_size == 0) {
+      if (!parse_block_size(argv[++i], opts)) {
         fprintf(stderr, "block_size must be > 0\n");
         return -1;
       }
+    } else if (strcmp(argv[i], "--rwmixread") == 0 && i + 1 < argc) {
+      int percent = atoi(argv[++i]);
+      if (percent < 0 || percent > 100) {
+        fprintf(stderr, "rwmixread must be in 0..100\n");
+        return -1;
+      }
+      opts->rwmixread = (unsigned)percent;
     } else if (strcmp(argv[i], "--block_count") == 0 && i + 1 < argc) {
       opts->block_count = (size_t)strtoull(argv[++i], NULL, 10);
       if (opts->block_count == 0) {
@@ -110,6 +209,115 @@ int parse_args(int argc, char* argv[], options_t* opts) {
         fprintf(stderr, "Invalid range format\n");
         return -1;
       }
+    } else if (strcmp(argv[i], "--fadvise") == 0 && i + 1 < argc) {
+      if (!parse_advice(argv[++i], &opts->advice)) {
+        fprintf(stderr, "Unknown --fadvise value: %s\n", argv[i]);
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      opts->threads = atoi(argv[++i]);
+      if (opts->threads <= 0) {
+        fprintf(stderr, "threads must be > 0\n");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--split") == 0 && i + 1 < argc) {
+      const char* val = argv[++i];
+      if (strcmp(val, "disjoint") == 0) {
+        opts->shared = false;
+      } else if (strcmp(val, "shared") == 0) {
+        opts->shared = true;
+      } else {
+        fprintf(stderr, "--split accepts disjoint/shared\n");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+      opts->engine = find_engine(argv[++i]);
+      if (opts->engine == NULL) {
+        fprintf(stderr, "Unknown --engine value: %s\n", argv[i]);
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--cache_pages") == 0 && i + 1 < argc) {
+      opts->cache_pages = (size_t)strtoull(argv[++i], NULL, 10);
+      cache_set = true;
+    } else if (strcmp(argv[i], "--policy") == 0 && i + 1 < argc) {
+      if (!parse_policy(argv[++i], &opts->policy)) {
+        fprintf(stderr, "Unknown --policy value: %s\n", argv[i]);
+        return -1;
+      }
+      cache_set = true;
+    } else if (strcmp(argv[i], "--iodepth") == 0 && i + 1 < argc) {
+      int depth = atoi(argv[++i]);
+      if (depth <= 0 || depth > 4096) {
+        fprintf(stderr, "iodepth must be in 1..4096\n");
+        return -1;
+      }
+      opts->iodepth = (unsigned)depth;
+    } else if (strcmp(argv[i], "--dist") == 0 && i + 1 < argc) {
+      if (!parse_dist(argv[++i], &opts->dist)) {
+        fprintf(stderr, "Invalid --dist value: %s\n", argv[i]);
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+      opts->rate = strtod(argv[++i], NULL);
+      if (opts->rate <= 0) {
+        fprintf(stderr, "rate must be > 0\n");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--runtime") == 0 && i + 1 < argc) {
+      opts->runtime = strtod(argv[++i], NULL);
+      if (opts->runtime <= 0) {
+        fprintf(stderr, "runtime must be > 0\n");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--ramp") == 0 && i + 1 < argc) {
+      opts->ramp = strtod(argv[++i], NULL);
+      if (opts->ramp < 0) {
+        fprintf(stderr, "ramp must be >= 0\n");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+      opts->interval = strtod(argv[++i], NULL);
+      if (opts->interval <= 0) {
+        fprintf(stderr, "interval must be > 0\n");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--verify") == 0) {
+      opts->verify = true;
+    } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+      opts->trace_path = argv[++i];
+    } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      const char* val = argv[++i];
+      if (strcmp(val, "fast") == 0) {
+        opts->trace_timed = false;
+      } else if (strcmp(val, "timed") == 0) {
+        opts->trace_timed = true;
+      } else {
+        fprintf(stderr, "--replay accepts fast/timed\n");
+        return -1;
+      }
+      replay_set = true;
+    } else if (strcmp(argv[i], "--arrival") == 0 && i + 1 < argc) {
+      const char* val = argv[++i];
+      if (strcmp(val, "constant") == 0) {
+        opts->arrival = ARRIVAL_CONSTANT;
+      } else if (strcmp(val, "poisson") == 0) {
+        opts->arrival = ARRIVAL_POISSON;
+      } else {
+        fprintf(stderr, "--arrival accepts constant/poisson\n");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--output-format") == 0 && i + 1 < argc) {
+      const char* val = argv[++i];
+      if (strcmp(val, "text") == 0) {
+        opts->output = OUTPUT_TEXT;
+      } else if (strcmp(val, "json") == 0) {
+        opts->output = OUTPUT_JSON;
+      } else if (strcmp(val, "csv") == 0) {
+        opts->output = OUTPUT_CSV;
+      } else {
+        fprintf(stderr, "--output-format accepts text/json/csv\n");
+        return -1;
+      }
     } else {
       fprintf(stderr, "Unknown argument: %s\n", argv[i]);
       return -1;
@@ -120,6 +328,29 @@ int parse_args(int argc, char* argv[], options_t* opts) {
     fprintf(stderr, "--file is required\n");
     return -1;
   }
+  if (opts->dist.kind != DIST_UNIFORM && opts->order != ORDER_RANDOM) {
+    fprintf(stderr, "--dist needs --type random\n");
+    return -1;
+  }
+  if (opts->verify && opts->read_size != opts->write_size) {
+    fprintf(stderr, "--verify needs the same block size for reads and writes\n");
+    return -1;
+  }
+  if (cache_set && opts->engine != &io_engine_vtpc) {
+    fprintf(stderr, "--cache_pages and --policy need --engine vtpc\n");
+    return -1;
+  }
+  if (replay_set && opts->trace_path == NULL) {
+    fprintf(stderr, "--replay needs --trace\n");
+    return -1;
+  }
+  // A trace sets the offsets, sizes and timing itself, one transfer at a
+  // time per recorded thread.
+  if (opts->trace_path != NULL &&
+      (opts->verify || opts->iodepth > 1 || opts->rate > 0 || opts->range_set || opts->dist.kind != DIST_UNIFORM)) {
+    fprintf(stderr, "--trace does not combine with --verify, --iodepth, --rate, --range or --dist\n");
+    return -1;
+  }
 
   return 0;
 }
@@ -0,0 +1,221 @@
+#include "io_load.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Slots summed exactly for the zipf normalization; the tail beyond comes from
+// the Euler-Maclaurin estimate, so setup stays cheap on huge ranges.
+#define ZETA_EXACT_TERMS (1U << 16)
+
+static uint64_t splitmix64(uint64_t* state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+void rng_seed(io_rng_t* rng, uint64_t seed) {
+  for (int i = 0; i < 4; ++i)
+    rng->s[i] = splitmix64(&seed);
+}
+
+static uint64_t rotl(uint64_t x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+// xoshiro256**
+uint64_t rng_next(io_rng_t* rng) {
+  uint64_t* s = rng->s;
+  uint64_t result = rotl(s[1] * 5, 7) * 9;
+  uint64_t t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = rotl(s[3], 45);
+  return result;
+}
+
+double rng_double(io_rng_t* rng) {
+  return (double)(rng_next(rng) >> 11) * 0x1.0p-53;
+}
+
+// Multiply-shift instead of a modulo, without its bias worth caring about.
+static uint64_t rng_below(io_rng_t* rng, uint64_t bound) {
+  return (uint64_t)(((unsigned __int128)rng_next(rng) * bound) >> 64);
+}
+
+static double zeta(uint64_t n, double theta) {
+  uint64_t exact = n < ZETA_EXACT_TERMS ? n : ZETA_EXACT_TERMS;
+  double sum = 0;
+  for (uint64_t i = 1; i <= exact; ++i)
+    sum += pow((double)i, -theta);
+  if (n > exact) {
+    double a = (double)exact;
+    double b = (double)n;
+    sum += (pow(b, 1 - theta) - pow(a, 1 - theta)) / (1 - theta) + (pow(b, -theta) - pow(a, -theta)) / 2;
+  }
+  return sum;
+}
+
+static uint64_t gcd(uint64_t a, uint64_t b) {
+  while (b != 0) {
+    uint64_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+static bool parse_percent(const char* text, char** end, double* value) {
+  *value = strtod(text, end);
+  return *end != text && *value > 0 && *value <= 100;
+}
+
+bool parse_dist(const char* text, io_dist_t* dist) {
+  memset(dist, 0, sizeof(*dist));
+  const char* colon = strchr(text, ':');
+  size_t name_len = colon != NULL ? (size_t)(colon - text) : strlen(text);
+  const char* arg = colon != NULL ? colon + 1 : NULL;
+  char* end = NULL;
+
+  if (strncmp(text, "uniform", name_len) == 0 && name_len == 7) {
+    dist->kind = DIST_UNIFORM;
+    return arg == NULL;
+  }
+  if (strncmp(text, "zipf", name_len) == 0 && name_len == 4) {
+    dist->kind = DIST_ZIPF;
+    dist->param = 1.2;
+    if (arg == NULL)
+      return true;
+    dist->param = strtod(arg, &end);
+    return end != arg && *end == '\0' && dist->param > 0 && dist->param != 1;
+  }
+  if (strncmp(text, "pareto", name_len) == 0 && name_len == 6) {
+    dist->kind = DIST_PARETO;
+    dist->param = 0.2;
+    if (arg == NULL)
+      return true;
+    dist->param = strtod(arg, &end);
+    return end != arg && *end == '\0' && dist->param > 0 && dist->param < 1;
+  }
+  if (strncmp(text, "hotspot", name_len) == 0 && name_len == 7) {
+    dist->kind = DIST_HOTSPOT;
+    dist->hot_ops = 0.9;
+    dist->hot_space = 0.1;
+    if (arg == NULL)
+      return true;
+    double ops = 0;
+    double space = 0;
+    if (!parse_percent(arg, &end, &ops) || *end != '/')
+      return false;
+    const char* rest = end + 1;
+    if (!parse_percent(rest, &end, &space) || *end != '\0' || space == 100)
+      return false;
+    dist->hot_ops = ops / 100;
+    dist->hot_space = space / 100;
+    return true;
+  }
+  if (strncmp(text, "normal", name_len) == 0 && name_len == 6) {
+    dist->kind = DIST_NORMAL;
+    dist->param = 15;
+    if (arg == NULL)
+      return true;
+    return parse_percent(arg, &end, &dist->param) && *end == '\0';
+  }
+  return false;
+}
+
+void sampler_init(io_sampler_t* sampler, const io_dist_t* dist, uint64_t slots) {
+  memset(sampler, 0, sizeof(*sampler));
+  sampler->dist = *dist;
+  sampler->slots = slots;
+  if (slots < 2) {
+    sampler->dist.kind = DIST_UNIFORM;
+    return;
+  }
+
+  // Spread hot ranks over the range so they do not sit next to each other
+  // and ride on readahead: rank * stride mod slots is a permutation.
+  uint64_t stride = 0x9E3779B97F4A7C15ULL % slots;
+  if (stride == 0)
+    stride = 1;
+  while (gcd(stride, slots) != 1)
+    stride++;
+  sampler->stride = stride;
+
+  double theta = dist->param;
+  double n = (double)slots;
+  switch (dist->kind) {
+    case DIST_ZIPF: {
+      // Gray et al., "Quickly Generating Billion-Record Synthetic Databases".
+      double zeta2 = 1 + pow(0.5, theta);
+      sampler->zeta_n = zeta(slots, theta);
+      sampler->alpha = 1 / (1 - theta);
+      sampler->eta = (1 - pow(2 / n, 1 - theta)) / (1 - zeta2 / sampler->zeta_n);
+      sampler->half_pow = pow(0.5, theta);
+      break;
+    }
+    case DIST_PARETO:
+      // 1 - h of the operations land on the first h of the ranks.
+      sampler->pareto_pow = log(dist->param) / log(1 - dist->param);
+      break;
+    case DIST_HOTSPOT:
+      sampler->hot_slots = (uint64_t)(n * dist->hot_space);
+      if (sampler->hot_slots == 0)
+        sampler->hot_slots = 1;
+      if (sampler->hot_slots >= slots)
+        sampler->hot_slots = slots - 1;
+      break;
+    default:
+      break;
+  }
+}
+
+static uint64_t scatter(const io_sampler_t* sampler, uint64_t rank) {
+  return (uint64_t)(((unsigned __int128)rank * sampler->stride) % sampler->slots);
+}
+
+uint64_t sampler_next(const io_sampler_t* sampler, io_rng_t* rng) {
+  uint64_t slots = sampler->slots;
+  switch (sampler->dist.kind) {
+    case DIST_ZIPF: {
+      double u = rng_double(rng);
+      double uz = u * sampler->zeta_n;
+      uint64_t rank;
+      if (uz < 1)
+        rank = 0;
+      else if (uz < 1 + sampler->half_pow)
+        rank = 1;
+      else
+        rank = (uint64_t)((double)slots * pow(sampler->eta * u - sampler->eta + 1, sampler->alpha));
+      return scatter(sampler, rank < slots ? rank : slots - 1);
+    }
+    case DIST_PARETO: {
+      uint64_t rank = (uint64_t)((double)(slots - 1) * pow(rng_double(rng), sampler->pareto_pow));
+      return scatter(sampler, rank < slots ? rank : slots - 1);
+    }
+    case DIST_HOTSPOT:
+      // The hot share is the start of the range.
+      if (rng_double(rng) < sampler->dist.hot_ops)
+        return rng_below(rng, sampler->hot_slots);
+      return sampler->hot_slots + rng_below(rng, slots - sampler->hot_slots);
+    case DIST_NORMAL: {
+      // Box-Muller around the middle, redrawing what falls outside.
+      double mean = (double)slots / 2;
+      double sigma = (double)slots * sampler->dist.param / 100;
+      for (;;) {
+        double u1 = rng_double(rng);
+        double u2 = rng_double(rng);
+        double z = sqrt(-2 * log(1 - u1)) * cos(2 * 3.14159265358979323846 * u2);
+        double slot = mean + z * sigma;
+        if (slot >= 0 && slot < (double)slots)
+          return (uint64_t)slot;
+      }
+    }
+    default:
+      return rng_below(rng, slots);
+  }
+}
@@ -0,0 +1,123 @@
+#include "io_load.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct {
+  int fd;
+  char* map;
+  size_t len;
+  bool writable;
+} map_t;
+
+// The whole file up to range_end is mapped once and shared by the workers;
+// transfers are plain copies and writes reach the file on close.
+static void* map_open(const options_t* opts) {
+  map_t* ctx = calloc(1, sizeof(*ctx));
+  if (ctx == NULL) {
+    fprintf(stderr, "calloc failed\n");
+    return NULL;
+  }
+
+  ctx->writable = opts->mode != MODE_READ;
+  ctx->len = (size_t)opts->range_end;
+  ctx->fd = open(opts->path, ctx->writable ? (O_RDWR | O_CREAT) : O_RDONLY, 0666);
+  if (ctx->fd < 0) {
+    fprintf(stderr, "Failed to open %s: %s\n", opts->path, strerror(errno));
+    free(ctx);
+    return NULL;
+  }
+
+  if (opts->use_direct)
+    fprintf(stderr, "Warning: --direct has no effect on mapped files\n");
+
+  struct stat st;
+  if (fstat(ctx->fd, &st) != 0 || (ctx->writable && st.st_size < opts->range_end &&
+                                   ftruncate(ctx->fd, opts->range_end) != 0)) {
+    fprintf(stderr, "Failed to size %s: %s\n", opts->path, strerror(errno));
+    close(ctx->fd);
+    free(ctx);
+    return NULL;
+  }
+
+  int prot = ctx->writable ? (PROT_READ | PROT_WRITE) : PROT_READ;
+  ctx->map = mmap(NULL, ctx->len, prot, MAP_SHARED, ctx->fd, 0);
+  if (ctx->map == MAP_FAILED) {
+    fprintf(stderr, "mmap failed: %s\n", strerror(errno));
+    close(ctx->fd);
+    free(ctx);
+    return NULL;
+  }
+  return ctx;
+}
+
+static void map_advise(void* ctx, const options_t* opts) {
+  static const int advice[] = {
+      [ADVICE_NORMAL] = MADV_NORMAL,
+      [ADVICE_SEQUENTIAL] = MADV_SEQUENTIAL,
+      [ADVICE_RANDOM] = MADV_RANDOM,
+      [ADVICE_WILLNEED] = MADV_WILLNEED,
+      [ADVICE_DONTNEED] = MADV_DONTNEED,
+      [ADVICE_NOREUSE] = MADV_NORMAL,
+  };
+
+  map_t* map = ctx;
+  off_t page = (off_t)sysconf(_SC_PAGESIZE);
+  off_t start = opts->range_start / page * page;
+  if (madvise(map->map + start, (size_t)(opts->range_end - start), advice[opts->advice]) != 0)
+    fprintf(stderr, "madvise failed: %s\n", strerror(errno));
+}
+
+static size_t map_clamp(const map_t* map, size_t count, off_t offset) {
+  if ((size_t)offset >= map->len)
+    return 0;
+  return (count < map->len - (size_t)offset) ? count : map->len - (size_t)offset;
+}
+
+static ssize_t map_read(void* ctx, void* buffer, size_t count, off_t offset) {
+  map_t* map = ctx;
+  count = map_clamp(map, count, offset);
+  memcpy(buffer, map->map + offset, count);
+  return (ssize_t)count;
+}
+
+static ssize_t map_write(void* ctx, void* buffer, size_t count, off_t offset) {
+  map_t* map = ctx;
+  count = map_clamp(map, count, offset);
+  memcpy(map->map + offset, buffer, count);
+  return (ssize_t)count;
+}
+
+static int map_sync(void* ctx) {
+  map_t* map = ctx;
+  return map->writable ? msync(map->map, map->len, MS_SYNC) : 0;
+}
+
+static int map_close(void* ctx) {
+  map_t* map = ctx;
+  int result = 0;
+  if (map->writable && msync(map->map, map->len, MS_SYNC) != 0) {
+    fprintf(stderr, "msync failed: %s\n", strerror(errno));
+    result = -1;
+  }
+  if (munmap(map->map, map->len) != 0 || close(map->fd) != 0)
+    result = -1;
+  free(map);
+  return result;
+}
+
+const io_engine_t io_engine_mmap = {
+    .name = "mmap",
+    .open = map_open,
+    .advise = map_advise,
+    .read = map_read,
+    .write = map_write,
+    .close = map_close,
+    .sync = map_sync,
+};
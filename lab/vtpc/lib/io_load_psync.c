@@ -0,0 +1,56 @@
+#include "io_load.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef struct {
+  int fd;
+} psync_t;
+
+static void* psync_open(const options_t* opts) {
+  psync_t* ctx = malloc(sizeof(*ctx));
+  if (ctx == NULL) {
+    fprintf(stderr, "malloc failed\n");
+    return NULL;
+  }
+
+  ctx->fd = open_fd(opts);
+  if (ctx->fd < 0) {
+    free(ctx);
+    return NULL;
+  }
+  return ctx;
+}
+
+static void psync_advise(void* ctx, const options_t* opts) {
+  advise_fd(((psync_t*)ctx)->fd, opts);
+}
+
+static ssize_t psync_read(void* ctx, void* buffer, size_t count, off_t offset) {
+  return pread(((psync_t*)ctx)->fd, buffer, count, offset);
+}
+
+static ssize_t psync_write(void* ctx, void* buffer, size_t count, off_t offset) {
+  return pwrite(((psync_t*)ctx)->fd, buffer, count, offset);
+}
+
+static int psync_sync(void* ctx) {
+  return fsync(((psync_t*)ctx)->fd);
+}
+
+static int psync_close(void* ctx) {
+  int result = close(((psync_t*)ctx)->fd);
+  free(ctx);
+  return result;
+}
+
+const io_engine_t io_engine_psync = {
+    .name = "psync",
+    .open = psync_open,
+    .advise = psync_advise,
+    .read = psync_read,
+    .write = psync_write,
+    .close = psync_close,
+    .sync = psync_sync,
+};
@@ -0,0 +1,156 @@
+#include "io_load.h"
+
+#include <stdio.h>
+
+uint64_t hist_percentile(const io_hist_t* hist, uint64_t count, double pct) {
+  if (count == 0)
+    return 0;
+
+  uint64_t rank = (uint64_t)((double)count * pct / 100.0 + 0.5);
+  if (rank == 0)
+    rank = 1;
+  uint64_t seen = 0;
+  for (unsigned bucket = 0; bucket < IO_HIST_BUCKETS; ++bucket) {
+    seen += hist->counts[bucket];
+    if (seen < rank)
+      continue;
+    if (bucket < (2U << IO_HIST_SUB_BITS))
+      return bucket;
+    unsigned shift = (bucket >> IO_HIST_SUB_BITS) - 1;
+    uint64_t low = (uint64_t)(bucket - (shift << IO_HIST_SUB_BITS)) << shift;
+    return low + ((1ULL << shift) >> 1);
+  }
+  return 0;
+}
+
+static const char* mode_name(const options_t* opts) {
+  if (opts->trace != NULL)
+    return opts->trace_timed ? "trace-timed" : "trace";
+  if (opts->mode == MODE_MIXED)
+    return opts->order == ORDER_RANDOM ? "randrw" : "rw";
+  return opts->mode == MODE_READ ? "read" : "write";
+}
+
+static const char* scope_name(io_scope_t scope) {
+  static const char* const names[] = {
+      [SCOPE_ITERATION] = "iteration",
+      [SCOPE_INTERVAL] = "interval",
+      [SCOPE_THREAD] = "thread",
+      [SCOPE_ALL] = "all",
+  };
+  return names[scope];
+}
+
+typedef struct {
+  double iops;
+  double mib;
+  double min;
+  double mean;
+  double max;
+  double p50;
+  double p90;
+  double p99;
+  double p999;
+  double slat_mean;
+  double slat_max;
+} summary_t;
+
+// Rates per second and latencies in microseconds.
+static summary_t summarize(const io_stats_t* stats) {
+  summary_t s = {0};
+  if (stats->seconds > 0) {
+    s.iops = (double)stats->ops / stats->seconds;
+    s.mib = (double)stats->bytes / stats->seconds / (1024.0 * 1024.0);
+  }
+  if (stats->ops == 0)
+    return s;
+
+  double ops = (double)stats->ops;
+  s.min = (double)stats->latency_min_ns / 1e3;
+  s.mean = (double)stats->latency_sum_ns / ops / 1e3;
+  s.max = (double)stats->latency_max_ns / 1e3;
+  // Bucket midpoints can stray past the exact extremes.
+  const double pcts[] = {50, 90, 99, 99.9};
+  double* values[] = {&s.p50, &s.p90, &s.p99, &s.p999};
+  for (size_t i = 0; i < sizeof(pcts) / sizeof(pcts[0]); ++i) {
+    double value = (double)hist_percentile(&stats->latency, stats->ops, pcts[i]) / 1e3;
+    *values[i] = value < s.min ? s.min : (value > s.max ? s.max : value);
+  }
+  s.slat_mean = (double)stats->submit_sum_ns / ops / 1e3;
+  s.slat_max = (double)stats->submit_max_ns / 1e3;
+  return s;
+}
+
+void report_begin(const options_t* opts) {
+  if (opts->output == OUTPUT_JSON) {
+    printf("{\"engine\":\"%s\",\"rw\":\"%s\",\"order\":\"%s\",\"block_size\":%zu,\"block_count\":%zu,"
+           "\"read_size\":%zu,\"write_size\":%zu,\"rwmixread\":%u,\"repeat\":%d,\"threads\":%d,\"iodepth\":%u,"
+           "\"rate\":%.1f,\"arrival\":\"%s\",\"runtime\":%.3f,\"ramp\":%.3f,"
+           "\"interval\":%.3f,\"verify\":%s,\"results\":[",
+           opts->engine->name, mode_name(opts), opts->order == ORDER_RANDOM ? "random" : "sequence",
+           opts->block_size, opts->block_count, opts->read_size, opts->write_size,
+           opts->mode == MODE_MIXED ? opts->rwmixread : (opts->mode == MODE_READ ? 100U : 0U), opts->repeat,
+           opts->threads, opts->iodepth, opts->rate, opts->arrival == ARRIVAL_POISSON ? "poisson" : "constant",
+           opts->runtime, opts->ramp, opts->interval, opts->verify ? "true" : "false");
+  } else if (opts->output == OUTPUT_CSV) {
+    printf("engine,rw,block_size,threads,iodepth,scope,index,dir,ops,bytes,seconds,iops,mib_per_s,"
+           "lat_min_us,lat_mean_us,lat_p50_us,lat_p90_us,lat_p99_us,lat_p99.9_us,lat_max_us,"
+           "slat_mean_us,slat_max_us\n");
+  }
+}
+
+static void report_row(const options_t* opts, io_scope_t scope, int index, bool write, const io_stats_t* stats) {
+  static bool first_row = true;
+  const char* dir = write ? "write" : "read";
+  summary_t s = summarize(stats);
+
+  if (opts->output == OUTPUT_JSON) {
+    printf("%s{\"scope\":\"%s\",\"index\":%d,\"dir\":\"%s\",\"ops\":%zu,\"bytes\":%llu,\"seconds\":%.6f,\"iops\":%.1f,"
+           "\"mib_per_s\":%.3f,\"latency_us\":{\"min\":%.3f,\"mean\":%.3f,\"p50\":%.3f,\"p90\":%.3f,"
+           "\"p99\":%.3f,\"p99.9\":%.3f,\"max\":%.3f},\"slat_us\":{\"mean\":%.3f,\"max\":%.3f}}",
+           first_row ? "" : ",", scope_name(scope), index, dir, stats->ops, (unsigned long long)stats->bytes,
+           stats->seconds, s.iops, s.mib, s.min, s.mean, s.p50, s.p90, s.p99, s.p999, s.max, s.slat_mean,
+           s.slat_max);
+    first_row = false;
+    return;
+  }
+  if (opts->output == OUTPUT_CSV) {
+    printf("%s,%s,%zu,%d,%u,%s,%d,%s,%zu,%llu,%.6f,%.1f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+           opts->engine->name, mode_name(opts), opts->block_size, opts->threads, opts->iodepth,
+           scope_name(scope), index, dir, stats->ops, (unsigned long long)stats->bytes, stats->seconds, s.iops,
+           s.mib, s.min, s.mean, s.p50, s.p90, s.p99, s.p999, s.max, s.slat_mean, s.slat_max);
+    return;
+  }
+
+  if (scope == SCOPE_ITERATION)
+    printf("Iteration %d", index);
+  else if (scope == SCOPE_INTERVAL)
+    printf("Interval %d", index);
+  else if (scope == SCOPE_THREAD)
+    printf("Thread %d", index);
+  else
+    printf("All threads");
+  if (opts->mode == MODE_MIXED)
+    printf(" %s", dir);
+  printf(": ops=%zu time=%.6f s iops=%.0f bandwidth=%.2f MiB/s latency min=%.2f avg=%.2f p50=%.2f p90=%.2f "
+         "p99=%.2f p99.9=%.2f max=%.2f us",
+         stats->ops, stats->seconds, s.iops, s.mib, s.min, s.mean, s.p50, s.p90, s.p99, s.p999, s.max);
+  // The thread pool has no separate submission step to report.
+  if (opts->iodepth > 1 && opts->engine->queue_open != NULL)
+    printf(" slat avg=%.2f max=%.2f us clat avg=%.2f us", s.slat_mean, s.slat_max, s.mean - s.slat_mean);
+  printf("\n");
+}
+
+void report_stats(const options_t* opts, io_scope_t scope, int index, const io_stats_t stats[2]) {
+  if (opts->mode != MODE_WRITE)
+    report_row(opts, scope, index, false, &stats[0]);
+  if (opts->mode != MODE_READ)
+    report_row(opts, scope, index, true, &stats[1]);
+}
+
+void report_end(const options_t* opts, double seconds, bool ok) {
+  if (opts->output == OUTPUT_JSON)
+    printf("],\"seconds\":%.6f,\"ok\":%s}\n", seconds, ok ? "true" : "false");
+  else if (opts->output == OUTPUT_TEXT && ok)
+    printf("Total time (%s): %.6f s\n", opts->engine->name, seconds);
+}
@@ -1,31 +1,35 @@
+#define _GNU_SOURCE
+
 #include "io_load.h"
 
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
-#include <time.h>
 #include <unistd.h>
 
-static void* allocate_buffer(size_t size) {
-  void* buffer = malloc(size);
-  if (buffer == NULL)
-    fprintf(stderr, "malloc failed\n");
-  return buffer;
-}
+#if defined(__linux__)
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sysmacros.h>
+#endif
 
-static double seconds_between(const struct timespec* start,
-                              const struct timespec* end) {
-  time_t sec = end->tv_sec - start->tv_sec;
-  long nsec = end->tv_nsec - start->tv_nsec;
-  if (nsec < 0) {
-    sec -= 1;
-    nsec += 1000000000L;
+static const io_engine_t* const engines[] = {
+    &io_engine_psync,
+    &io_engine_vtpc,
+    &io_engine_mmap,
+    &io_engine_uring,
+    &io_engine_aio,
+};
+
+const io_engine_t* find_engine(const char* name) {
+  for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); ++i) {
+    if (strcmp(engines[i]->name, name) == 0)
+      return engines[i];
   }
-  return (double)sec + (double)nsec / 1e9;
+  return NULL;
 }
 
 static int check_range(const options_t* opts, const struct stat* st) {
@@ -34,15 +38,15 @@ static int check_range(const options_t* opts, const struct stat* st) {
 
   if (!opts->range_set) {
     range_start = 0;
-    if (opts->mode == MODE_READ) {
+    if (opts->mode != MODE_WRITE) {
       range_end = st->st_size;
     } else {
-      range_end = range_start + (off_t)(opts->block_size * opts->block_count);
+      range_end = range_start + workload_span(opts);
     }
   }
 
-  if (opts->mode == MODE_READ && range_end > st->st_size) {
-    fprintf(stderr, "Range exceeds file size for read mode\n");
+  if (opts->mode != MODE_WRITE && range_end > st->st_size) {
+    fprintf(stderr, "Range exceeds file size for reads\n");
     return -1;
   }
 
@@ -52,8 +56,7 @@ static int check_range(const options_t* opts, const struct stat* st) {
   }
 
   off_t span = range_end - range_start;
-  if (opts->order == ORDER_SEQUENCE &&
-      span < (off_t)(opts->block_size * opts->block_count)) {
+  if (opts->order == ORDER_SEQUENCE && span < workload_span(opts)) {
     fprintf(stderr, "Range is too small for sequential access\n");
     return -1;
   }
@@ -61,116 +64,235 @@ static int check_range(const options_t* opts, const struct stat* st) {
   return 0;
 }
 
-static off_t pick_offset(const options_t* opts, off_t range_start, size_t index) {
-  if (opts->order == ORDER_RANDOM) {
-    off_t range_bytes = opts->range_end - opts->range_start;
-    if (range_bytes < (off_t)opts->block_size)
-      return opts->range_start;
+void advise_fd(int fd, const options_t* opts) {
+#if defined(POSIX_FADV_NORMAL)
+  static const int advice[] = {
+      [ADVICE_NORMAL] = POSIX_FADV_NORMAL,
+      [ADVICE_SEQUENTIAL] = POSIX_FADV_SEQUENTIAL,
+      [ADVICE_RANDOM] = POSIX_FADV_RANDOM,
+      [ADVICE_WILLNEED] = POSIX_FADV_WILLNEED,
+      [ADVICE_DONTNEED] = POSIX_FADV_DONTNEED,
+      [ADVICE_NOREUSE] = POSIX_FADV_NOREUSE,
+  };
 
-    off_t slots = range_bytes / (off_t)opts->block_size;
-    if (slots <= 0)
-      slots = 1;
-    off_t slot = (off_t)(rand() % (int)slots);
-    return opts->range_start + slot * (off_t)opts->block_size;
-  }
+  if (opts->advice == ADVICE_NONE)
+    return;
+  int err = posix_fadvise(fd, opts->range_start, opts->range_end - opts->range_start, advice[opts->advice]);
+  if (err != 0)
+    fprintf(stderr, "posix_fadvise failed: %s\n", strerror(err));
+#else
+  (void)fd;
+  if (opts->advice != ADVICE_NONE)
+    fprintf(stderr, "Warning: posix_fadvise not supported on this platform\n");
+#endif
+}
 
-  return range_start + (off_t)(index * opts->block_size);
+int open_flags(const options_t* opts) {
+  if (opts->mode == MODE_READ)
+    return O_RDONLY;
+  return (opts->mode == MODE_WRITE ? O_WRONLY : O_RDWR) | O_CREAT;
 }
 
-int run_io_workload(const options_t* opts) {
-  int flags = (opts->mode == MODE_READ) ? O_RDONLY : (O_WRONLY | O_CREAT);
-  int fd = open(opts->path, flags, 0666);
-  if (fd < 0) {
-    fprintf(stderr, "Failed to open %s: %s\n", opts->path, strerror(errno));
-    return 1;
-  }
+#if defined(__linux__)
+static size_t read_size_file(const char* path) {
+  FILE* file = fopen(path, "r");
+  if (file == NULL)
+    return 0;
+  unsigned long value = 0;
+  if (fscanf(file, "%lu", &value) != 1)
+    value = 0;
+  fclose(file);
+  return value;
+}
+#endif
 
-#if defined(F_NOCACHE)
-  if (opts->use_direct && fcntl(fd, F_NOCACHE, 1) != 0)
-    fprintf(stderr, "fcntl failed: %s\n", strerror(errno));
+// Alignment O_DIRECT needs of file offsets and sizes, and of buffers. statx()
+// reports both on Linux 6.1+; before that, the logical block size of the
+// device holding the file is the rule for both.
+static int direct_alignment(int fd, size_t* offset_align, size_t* memory_align) {
+  *offset_align = *memory_align = 512;
+#if defined(__linux__)
+#if defined(STATX_DIOALIGN)
+  struct statx stx;
+  if (statx(fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &stx) == 0 && (stx.stx_mask & STATX_DIOALIGN) != 0) {
+    if (stx.stx_dio_offset_align == 0)
+      return -1;
+    *offset_align = stx.stx_dio_offset_align;
+    *memory_align = stx.stx_dio_mem_align;
+    return 0;
+  }
+#endif
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+    return 0;
+  int block = 0;
+  if (S_ISBLK(st.st_mode) && ioctl(fd, BLKSSZGET, &block) == 0 && block > 0) {
+    *offset_align = *memory_align = (size_t)block;
+    return 0;
+  }
+  // A partition has no queue of its own; its parent's is one level up.
+  char path[96];
+  unsigned major_id = major(st.st_dev);
+  unsigned minor_id = minor(st.st_dev);
+  snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/queue/logical_block_size", major_id, minor_id);
+  size_t size = read_size_file(path);
+  if (size == 0) {
+    snprintf(path, sizeof(path), "/sys/dev/block/%u:%u/../queue/logical_block_size", major_id, minor_id);
+    size = read_size_file(path);
+  }
+  if (size != 0)
+    *offset_align = *memory_align = size;
 #else
-  if (opts->use_direct)
-    fprintf(stderr, "Warning: F_NOCACHE not supported on this platform\n");
+  (void)fd;
 #endif
+  return 0;
+}
 
-  struct stat st;
-  if (fstat(fd, &st) != 0) {
-    fprintf(stderr, "fstat failed: %s\n", strerror(errno));
-    close(fd);
-    return 1;
+// A replayed trace brings its own offsets and lengths, each has to be aligned.
+static int check_direct_trace(const io_trace_t* trace, size_t offset_align) {
+  for (size_t i = 0; i < trace->count; ++i) {
+    const io_trace_op_t* op = &trace->ops[i];
+    if (op->kind == TRACE_SYNC || (op->offset % offset_align == 0 && op->length % offset_align == 0))
+      continue;
+    fprintf(stderr, "--direct needs trace operations aligned to %zu bytes, found %s of %u bytes at %llu\n",
+            offset_align, op->kind == TRACE_READ ? "a read" : "a write", op->length,
+            (unsigned long long)op->offset);
+    return -1;
   }
+  return 0;
+}
 
-  options_t local_opts = *opts;
-  if (!local_opts.range_set) {
-    local_opts.range_start = 0;
-    if (local_opts.mode == MODE_READ)
-      local_opts.range_end = st.st_size;
+// Transfers go straight from the workers' buffers, which are page-aligned,
+// so sizes and the range start have to be multiples of the block size.
+static int check_direct(int fd, const options_t* opts) {
+  size_t offset_align = 0;
+  size_t memory_align = 0;
+  if (direct_alignment(fd, &offset_align, &memory_align) != 0) {
+    fprintf(stderr, "--direct: %s does not support direct I/O\n", opts->path);
+    return -1;
+  }
+  if (memory_align > (size_t)sysconf(_SC_PAGESIZE)) {
+    fprintf(stderr, "--direct needs buffers aligned to %zu bytes, above the page size\n", memory_align);
+    return -1;
+  }
+  if (opts->trace != NULL)
+    return check_direct_trace(opts->trace, offset_align);
+  if (opts->read_size % offset_align != 0 || opts->write_size % offset_align != 0 ||
+      opts->range_start % (off_t)offset_align != 0) {
+    fprintf(stderr, "--direct needs block sizes and the range start in multiples of %zu bytes\n", offset_align);
+    return -1;
+  }
+  return 0;
+}
+
+int open_fd(const options_t* opts) {
+  int flags = open_flags(opts);
+#if defined(O_DIRECT)
+  if (opts->use_direct)
+    flags |= O_DIRECT;
+#endif
+  int fd = open(opts->path, flags, 0666);
+  if (fd < 0) {
+    if (opts->use_direct && errno == EINVAL)
+      fprintf(stderr, "Failed to open %s: the file system does not support O_DIRECT\n", opts->path);
     else
-      local_opts.range_end = local_opts.range_start + (off_t)(local_opts.block_size * local_opts.block_count);
+      fprintf(stderr, "Failed to open %s: %s\n", opts->path, strerror(errno));
+    return -1;
   }
+  if (!opts->use_direct)
+    return fd;
 
-  if (check_range(&local_opts, &st) != 0) {
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+  if (fcntl(fd, F_NOCACHE, 1) != 0) {
+    fprintf(stderr, "fcntl(F_NOCACHE) failed: %s\n", strerror(errno));
     close(fd);
-    return 1;
+    return -1;
   }
-
-  void* buffer = allocate_buffer(local_opts.block_size);
-  if (buffer == NULL) {
+#elif !defined(O_DIRECT)
+  fprintf(stderr, "--direct is not supported on this platform\n");
+  close(fd);
+  return -1;
+#endif
+  if (check_direct(fd, opts) != 0) {
     close(fd);
-    return 1;
+    return -1;
   }
+  return fd;
+}
 
-  if (local_opts.mode == MODE_WRITE) {
-    for (size_t i = 0; i < local_opts.block_size; ++i)
-      ((unsigned char*)buffer)[i] = (unsigned char)('A' + (i % 26));
-  }
-
-  srand(0);
-
-  struct timespec total_start = {0}, total_end = {0};
-  clock_gettime(CLOCK_MONOTONIC, &total_start);
-
-  for (int r = 0; r < local_opts.repeat; ++r) {
-    struct timespec start, end;
-    clock_gettime(CLOCK_MONOTONIC, &start);
-
-    for (size_t i = 0; i < local_opts.block_count; ++i) {
-      off_t offset = pick_offset(&local_opts, local_opts.range_start, i);
-      ssize_t done;
-      if (local_opts.mode == MODE_READ) {
-        done = pread(fd, buffer, local_opts.block_size, offset);
-      } else {
-        done = pwrite(fd, buffer, local_opts.block_size, offset);
-      }
-      if (done < 0) {
-        fprintf(stderr, "I/O error at block %zu: %s\n", i, strerror(errno));
-        free(buffer);
-        close(fd);
-        return 1;
-      }
-      if ((size_t)done != local_opts.block_size) {
-        fprintf(stderr, "Short transfer at block %zu\n", i);
-        free(buffer);
-        close(fd);
-        return 1;
-      }
-    }
+// A trace brings its own threads, transfer sizes and range.
+static void use_trace(options_t* opts, const io_trace_t* trace) {
+  opts->trace = trace;
+  opts->threads = trace->streams;
+  opts->block_size = opts->read_size = opts->write_size = trace->max_length;
+  opts->block_count = trace->count;
+  if (trace->reads > 0 && trace->writes > 0)
+    opts->mode = MODE_MIXED;
+  else
+    opts->mode = trace->writes > 0 ? MODE_WRITE : MODE_READ;
+  opts->rwmixread = (unsigned)(trace->reads * 100 / (trace->reads + trace->writes));
+  opts->range_set = true;
+  opts->range_start = 0;
+  opts->range_end = (off_t)trace->end;
+}
 
-    clock_gettime(CLOCK_MONOTONIC, &end);
-    time_t sec = end.tv_sec - start.tv_sec;
-    long nsec = end.tv_nsec - start.tv_nsec;
-    if (nsec < 0) {
-      sec -= 1;
-      nsec += 1000000000L;
+static int resolve_range(options_t* opts) {
+  struct stat st;
+  memset(&st, 0, sizeof(st));
+  if (stat(opts->path, &st) != 0 && (opts->mode != MODE_WRITE || errno != ENOENT)) {
+    fprintf(stderr, "stat failed: %s\n", strerror(errno));
+    return -1;
+  }
+
+  // Writes may extend the file before a trace reads it back.
+  if (opts->trace != NULL) {
+    if (opts->mode == MODE_READ && opts->range_end > st.st_size) {
+      fprintf(stderr, "Trace reads past the end of %s\n", opts->path);
+      return -1;
     }
-    double elapsed = (double)sec + (double)nsec / 1e9;
-    printf("Iteration %d: blocks=%zu size=%zu bytes time=%.6f s\n", r + 1, local_opts.block_count, local_opts.block_size, elapsed);
+    return 0;
   }
 
-  clock_gettime(CLOCK_MONOTONIC, &total_end);
-  printf("Total time: %.6f s\n", seconds_between(&total_start, &total_end));
+  if (!opts->range_set) {
+    opts->range_start = 0;
+    if (opts->mode != MODE_WRITE)
+      opts->range_end = st.st_size;
+    else
+      opts->range_end = opts->range_start + workload_span(opts);
+  }
+  return check_range(opts, &st);
+}
 
-  free(buffer);
-  close(fd);
-  return 0;
+static int run_engine(const options_t* opts) {
+  const io_engine_t* engine = opts->engine;
+  void* ctx = engine->open(opts);
+  if (ctx == NULL)
+    return 1;
+
+  if (opts->advice != ADVICE_NONE)
+    engine->advise(ctx, opts);
+
+  double seconds = 0;
+  report_begin(opts);
+  int result = run_workers(opts, ctx, &seconds);
+  report_end(opts, seconds, result == 0);
+
+  if (engine->close(ctx) != 0)
+    result = 1;
+  return result;
+}
+
+int run_io_workload(const options_t* opts) {
+  options_t local_opts = *opts;
+  io_trace_t trace;
+  if (opts->trace_path != NULL) {
+    if (load_trace(opts->trace_path, &trace) != 0)
+      return 1;
+    use_trace(&local_opts, &trace);
+  }
+
+  int result = resolve_range(&local_opts) != 0 ? 1 : run_engine(&local_opts);
+  if (opts->trace_path != NULL)
+    free_trace(&trace);
+  return result;
 }
@@ -0,0 +1,233 @@
+#include "io_load.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vtpc_trace.h"
+
+#define TRACE_MAX_STREAMS 65535
+#define TRACE_LINE_MAX 256
+
+typedef struct {
+  uint64_t time_ns;
+  uint64_t offset;
+  uint32_t length;
+  uint16_t kind;
+  uint16_t stream;
+  size_t index;
+} raw_op_t;
+
+typedef struct {
+  raw_op_t* ops;
+  size_t count;
+  size_t capacity;
+  // Thread ids in order of first appearance, their index is the stream.
+  uint32_t* tids;
+  int streams;
+  int last;
+} loader_t;
+
+static int stream_of(loader_t* loader, uint32_t tid) {
+  if (loader->last < loader->streams && loader->tids[loader->last] == tid)
+    return loader->last;
+  for (int s = 0; s < loader->streams; ++s) {
+    if (loader->tids[s] == tid)
+      return loader->last = s;
+  }
+  if (loader->streams == TRACE_MAX_STREAMS)
+    return -1;
+  uint32_t* tids = realloc(loader->tids, (size_t)(loader->streams + 1) * sizeof(*tids));
+  if (tids == NULL)
+    return -1;
+  loader->tids = tids;
+  loader->tids[loader->streams] = tid;
+  return loader->last = loader->streams++;
+}
+
+static int add_op(loader_t* loader, uint64_t time_ns, int kind, uint64_t offset, uint64_t length, uint32_t tid) {
+  if (kind != TRACE_SYNC && length == 0)
+    return 0;
+  if (length > UINT32_MAX) {
+    fprintf(stderr, "Trace operation of %llu bytes is too long\n", (unsigned long long)length);
+    return -1;
+  }
+  int stream = stream_of(loader, tid);
+  if (stream < 0) {
+    fprintf(stderr, "Trace has more than %d threads\n", TRACE_MAX_STREAMS);
+    return -1;
+  }
+  if (loader->count == loader->capacity) {
+    size_t capacity = (loader->capacity == 0) ? 4096 : loader->capacity * 2;
+    raw_op_t* ops = realloc(loader->ops, capacity * sizeof(*ops));
+    if (ops == NULL) {
+      fprintf(stderr, "realloc failed\n");
+      return -1;
+    }
+    loader->ops = ops;
+    loader->capacity = capacity;
+  }
+  raw_op_t* op = &loader->ops[loader->count];
+  op->time_ns = time_ns;
+  op->offset = offset;
+  op->length = (uint32_t)length;
+  op->kind = (uint16_t)kind;
+  op->stream = (uint16_t)stream;
+  op->index = loader->count++;
+  return 0;
+}
+
+// Records of several handles share one file, each replayed on the file
+// under test.
+static int load_binary(FILE* in, const char* path, loader_t* loader) {
+  struct vtpc_trace_header header;
+  if (fread(&header, sizeof(header), 1, in) != 1 || header.record_size != sizeof(struct vtpc_trace_record)) {
+    fprintf(stderr, "%s: bad vtpc trace header\n", path);
+    return -1;
+  }
+  static const int kinds[] = {
+      [VTPC_TRACE_READ] = TRACE_READ,
+      [VTPC_TRACE_WRITE] = TRACE_WRITE,
+      [VTPC_TRACE_FSYNC] = TRACE_SYNC,
+  };
+  struct vtpc_trace_record records[1024];
+  size_t got = 0;
+  while ((got = fread(records, sizeof(records[0]), 1024, in)) > 0) {
+    for (size_t i = 0; i < got; ++i) {
+      const struct vtpc_trace_record* record = &records[i];
+      if (record->op > VTPC_TRACE_FSYNC) {
+        fprintf(stderr, "%s: unknown operation %u\n", path, record->op);
+        return -1;
+      }
+      if (add_op(loader, record->timestamp_ns, kinds[record->op], record->offset, record->length, record->tid) != 0)
+        return -1;
+    }
+  }
+  return ferror(in) ? -1 : 0;
+}
+
+static int parse_kind(const char* text) {
+  if (strcmp(text, "r") == 0 || strcmp(text, "read") == 0)
+    return TRACE_READ;
+  if (strcmp(text, "w") == 0 || strcmp(text, "write") == 0)
+    return TRACE_WRITE;
+  if (strcmp(text, "s") == 0 || strcmp(text, "sync") == 0 || strcmp(text, "fsync") == 0)
+    return TRACE_SYNC;
+  return -1;
+}
+
+// Blank lines and those starting with '#' are skipped.
+static int load_text(FILE* in, const char* path, loader_t* loader) {
+  char line[TRACE_LINE_MAX];
+  for (size_t number = 1; fgets(line, sizeof(line), in) != NULL; ++number) {
+    if (strchr(line, '\n') == NULL && !feof(in)) {
+      fprintf(stderr, "%s:%zu: line too long\n", path, number);
+      return -1;
+    }
+    unsigned long long time_ns = 0;
+    unsigned long long offset = 0;
+    unsigned long long length = 0;
+    unsigned long tid = 0;
+    char op[16];
+    char first = 0;
+    if (sscanf(line, " %c", &first) != 1 || first == '#')
+      continue;
+    int fields = sscanf(line, "%llu %15s %llu %llu %lu", &time_ns, op, &offset, &length, &tid);
+    int kind = fields >= 2 ? parse_kind(op) : -1;
+    if (fields < 4 || kind < 0) {
+      fprintf(stderr, "%s:%zu: expected \"<ns> <r|w|s> <offset> <length> [<thread id>]\"\n", path, number);
+      return -1;
+    }
+    if (add_op(loader, time_ns, kind, offset, length, (uint32_t)tid) != 0)
+      return -1;
+  }
+  return ferror(in) ? -1 : 0;
+}
+
+// By stream, then time, then position in the file.
+static int compare_ops(const void* lhs, const void* rhs) {
+  const raw_op_t* a = lhs;
+  const raw_op_t* b = rhs;
+  if (a->stream != b->stream)
+    return a->stream < b->stream ? -1 : 1;
+  if (a->time_ns != b->time_ns)
+    return a->time_ns < b->time_ns ? -1 : 1;
+  return a->index < b->index ? -1 : (a->index > b->index);
+}
+
+static int build(loader_t* loader, io_trace_t* trace) {
+  qsort(loader->ops, loader->count, sizeof(*loader->ops), compare_ops);
+  trace->ops = malloc(loader->count * sizeof(*trace->ops));
+  trace->starts = calloc((size_t)loader->streams + 1, sizeof(*trace->starts));
+  if (trace->ops == NULL || trace->starts == NULL) {
+    fprintf(stderr, "malloc failed\n");
+    return -1;
+  }
+
+  uint64_t first = UINT64_MAX;
+  for (size_t i = 0; i < loader->count; ++i) {
+    if (loader->ops[i].time_ns < first)
+      first = loader->ops[i].time_ns;
+  }
+  trace->count = loader->count;
+  trace->streams = loader->streams;
+  for (size_t i = 0; i < loader->count; ++i) {
+    const raw_op_t* raw = &loader->ops[i];
+    io_trace_op_t* op = &trace->ops[i];
+    op->time_ns = raw->time_ns - first;
+    op->offset = raw->offset;
+    op->length = raw->length;
+    op->kind = raw->kind;
+    op->stream = raw->stream;
+    trace->starts[raw->stream + 1] = i + 1;
+    if (op->time_ns > trace->span_ns)
+      trace->span_ns = op->time_ns;
+    if (op->kind == TRACE_SYNC) {
+      trace->syncs++;
+      continue;
+    }
+    if (op->kind == TRACE_READ)
+      trace->reads++;
+    else
+      trace->writes++;
+    if (op->length > trace->max_length)
+      trace->max_length = op->length;
+    if (op->offset + op->length > trace->end)
+      trace->end = op->offset + op->length;
+  }
+  return 0;
+}
+
+int load_trace(const char* path, io_trace_t* trace) {
+  memset(trace, 0, sizeof(*trace));
+  FILE* in = fopen(path, "rb");
+  if (in == NULL) {
+    fprintf(stderr, "Failed to open trace %s: %s\n", path, strerror(errno));
+    return -1;
+  }
+
+  loader_t loader = {0};
+  uint64_t magic = 0;
+  bool binary = fread(&magic, sizeof(magic), 1, in) == 1 && magic == VTPC_TRACE_MAGIC;
+  rewind(in);
+  int result = binary ? load_binary(in, path, &loader) : load_text(in, path, &loader);
+  fclose(in);
+  if (result == 0)
+    result = build(&loader, trace);
+  if (result == 0 && trace->max_length == 0) {
+    fprintf(stderr, "%s: no reads or writes to replay\n", path);
+    result = -1;
+  }
+  free(loader.ops);
+  free(loader.tids);
+  if (result != 0)
+    free_trace(trace);
+  return result;
+}
+
+void free_trace(io_trace_t* trace) {
+  free(trace->ops);
+  free(trace->starts);
+  memset(trace, 0, sizeof(*trace));
+}
@@ -0,0 +1,323 @@
+#include "io_load.h"
+
+#include <stdio.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define URING_ENTRIES 8
+
+// A ring set up with the raw syscalls, without liburing.
+typedef struct ring {
+  struct ring* next;
+  const void* owner;
+  int fd;
+  unsigned* sq_tail;
+  unsigned* sq_mask;
+  unsigned* sq_array;
+  unsigned* cq_head;
+  unsigned* cq_tail;
+  unsigned* cq_mask;
+  struct io_uring_sqe* sqes;
+  struct io_uring_cqe* cqes;
+  void* sq_ptr;
+  size_t sq_len;
+  void* cq_ptr;
+  size_t cq_len;
+  size_t sqes_len;
+} ring_t;
+
+// Workers each get their own ring on first use; the context keeps them all
+// to tear down on close.
+typedef struct {
+  int fd;
+  pthread_mutex_t lock;
+  ring_t* rings;
+} uring_t;
+
+static __thread ring_t* t_ring;
+
+static void ring_destroy(ring_t* ring) {
+  if (ring->sqes != NULL)
+    munmap(ring->sqes, ring->sqes_len);
+  if (ring->cq_ptr != NULL && ring->cq_ptr != ring->sq_ptr)
+    munmap(ring->cq_ptr, ring->cq_len);
+  if (ring->sq_ptr != NULL)
+    munmap(ring->sq_ptr, ring->sq_len);
+  close(ring->fd);
+  free(ring);
+}
+
+static ring_t* ring_create(unsigned entries) {
+  ring_t* ring = calloc(1, sizeof(*ring));
+  if (ring == NULL)
+    return NULL;
+
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+  if (ring->fd < 0) {
+    free(ring);
+    return NULL;
+  }
+
+  ring->sq_len = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_len = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+    if (ring->cq_len > ring->sq_len)
+      ring->sq_len = ring->cq_len;
+    ring->cq_len = ring->sq_len;
+  }
+
+  ring->sq_ptr = mmap(NULL, ring->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                      IORING_OFF_SQ_RING);
+  if (ring->sq_ptr == MAP_FAILED) {
+    ring->sq_ptr = NULL;
+    ring_destroy(ring);
+    return NULL;
+  }
+  if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+    ring->cq_ptr = ring->sq_ptr;
+  } else {
+    ring->cq_ptr = mmap(NULL, ring->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                        IORING_OFF_CQ_RING);
+    if (ring->cq_ptr == MAP_FAILED) {
+      ring->cq_ptr = NULL;
+      ring_destroy(ring);
+      return NULL;
+    }
+  }
+  ring->sqes_len = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                    IORING_OFF_SQES);
+  if (ring->sqes == MAP_FAILED) {
+    ring->sqes = NULL;
+    ring_destroy(ring);
+    return NULL;
+  }
+
+  char* sq = ring->sq_ptr;
+  char* cq = ring->cq_ptr;
+  ring->sq_tail = (unsigned*)(sq + params.sq_off.tail);
+  ring->sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+  ring->sq_array = (unsigned*)(sq + params.sq_off.array);
+  ring->cq_head = (unsigned*)(cq + params.cq_off.head);
+  ring->cq_tail = (unsigned*)(cq + params.cq_off.tail);
+  ring->cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+  return ring;
+}
+
+static ring_t* uring_ring(uring_t* ctx) {
+  if (t_ring != NULL && t_ring->owner == ctx)
+    return t_ring;
+
+  ring_t* ring = ring_create(URING_ENTRIES);
+  if (ring == NULL)
+    return NULL;
+  ring->owner = ctx;
+  pthread_mutex_lock(&ctx->lock);
+  ring->next = ctx->rings;
+  ctx->rings = ring;
+  pthread_mutex_unlock(&ctx->lock);
+  t_ring = ring;
+  return ring;
+}
+
+static void* uring_open(const options_t* opts) {
+  uring_t* ctx = calloc(1, sizeof(*ctx));
+  if (ctx == NULL) {
+    fprintf(stderr, "calloc failed\n");
+    return NULL;
+  }
+
+  ctx->fd = open_fd(opts);
+  if (ctx->fd < 0) {
+    free(ctx);
+    return NULL;
+  }
+  pthread_mutex_init(&ctx->lock, NULL);
+
+  // Fail early rather than in every worker when io_uring is unavailable.
+  if (uring_ring(ctx) == NULL) {
+    fprintf(stderr, "io_uring_setup failed: %s\n", strerror(errno));
+    close(ctx->fd);
+    pthread_mutex_destroy(&ctx->lock);
+    free(ctx);
+    return NULL;
+  }
+  return ctx;
+}
+
+static void uring_advise(void* ctx, const options_t* opts) {
+  advise_fd(((uring_t*)ctx)->fd, opts);
+}
+
+// Queues one request, submits it and waits for its completion.
+static ssize_t uring_transfer(uring_t* ctx, void* buffer, size_t count, off_t offset, int opcode) {
+  ring_t* ring = uring_ring(ctx);
+  if (ring == NULL)
+    return -1;
+
+  unsigned tail = *ring->sq_tail;
+  unsigned index = tail & *ring->sq_mask;
+  struct io_uring_sqe* sqe = &ring->sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = (__u8)opcode;
+  sqe->fd = ctx->fd;
+  sqe->addr = (__u64)(uintptr_t)buffer;
+  sqe->len = (__u32)count;
+  sqe->off = (__u64)offset;
+  ring->sq_array[index] = index;
+  __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+  unsigned head = *ring->cq_head;
+  unsigned submit = 1;
+  while (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+    if (syscall(__NR_io_uring_enter, ring->fd, submit, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    submit = 0;
+  }
+
+  int res = ring->cqes[head & *ring->cq_mask].res;
+  __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+  if (res < 0) {
+    errno = -res;
+    return -1;
+  }
+  return res;
+}
+
+static ssize_t uring_read(void* ctx, void* buffer, size_t count, off_t offset) {
+  return uring_transfer(ctx, buffer, count, offset, IORING_OP_READ);
+}
+
+static ssize_t uring_write(void* ctx, void* buffer, size_t count, off_t offset) {
+  return uring_transfer(ctx, buffer, count, offset, IORING_OP_WRITE);
+}
+
+// Queues for --iodepth are private rings of their own depth, not cached per
+// thread like the ones behind read and write.
+static void* uring_queue_open(void* ctx, unsigned depth) {
+  ring_t* ring = ring_create(depth);
+  if (ring != NULL)
+    ring->owner = ctx;
+  return ring;
+}
+
+static int uring_submit(void* queue, io_request_t** requests, unsigned count) {
+  ring_t* ring = queue;
+  const uring_t* ctx = ring->owner;
+  unsigned tail = *ring->sq_tail;
+  for (unsigned i = 0; i < count; ++i) {
+    io_request_t* request = requests[i];
+    unsigned index = (tail + i) & *ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = request->write ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd = ctx->fd;
+    sqe->addr = (__u64)(uintptr_t)request->buffer;
+    sqe->len = (__u32)request->count;
+    sqe->off = (__u64)request->offset;
+    sqe->user_data = (__u64)(uintptr_t)request;
+    ring->sq_array[index] = index;
+  }
+  __atomic_store_n(ring->sq_tail, tail + count, __ATOMIC_RELEASE);
+
+  while (count > 0) {
+    long submitted = syscall(__NR_io_uring_enter, ring->fd, count, 0, 0, NULL, 0);
+    if (submitted < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    count -= (unsigned)submitted;
+  }
+  return 0;
+}
+
+static int uring_reap(void* queue, io_request_t** done, unsigned max, unsigned min) {
+  ring_t* ring = queue;
+  unsigned got = 0;
+  for (;;) {
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail && got < max; ++head) {
+      const struct io_uring_cqe* cqe = &ring->cqes[head & *ring->cq_mask];
+      io_request_t* request = (io_request_t*)(uintptr_t)cqe->user_data;
+      request->result = cqe->res < 0 ? -1 : cqe->res;
+      request->error = cqe->res < 0 ? -cqe->res : 0;
+      done[got++] = request;
+    }
+    __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    if (got >= min)
+      return (int)got;
+
+    if (syscall(__NR_io_uring_enter, ring->fd, 0, min - got, IORING_ENTER_GETEVENTS, NULL, 0) < 0 &&
+        errno != EINTR)
+      return -1;
+  }
+}
+
+static void uring_queue_close(void* queue) {
+  ring_destroy(queue);
+}
+
+static int uring_sync(void* ctx) {
+  return fsync(((uring_t*)ctx)->fd);
+}
+
+static int uring_close(void* ctx) {
+  uring_t* uring = ctx;
+  if (t_ring != NULL && t_ring->owner == uring)
+    t_ring = NULL;
+  while (uring->rings != NULL) {
+    ring_t* ring = uring->rings;
+    uring->rings = ring->next;
+    ring_destroy(ring);
+  }
+  int result = close(uring->fd);
+  pthread_mutex_destroy(&uring->lock);
+  free(uring);
+  return result;
+}
+
+const io_engine_t io_engine_uring = {
+    .name = "io_uring",
+    .open = uring_open,
+    .advise = uring_advise,
+    .read = uring_read,
+    .write = uring_write,
+    .close = uring_close,
+    .sync = uring_sync,
+    .queue_open = uring_queue_open,
+    .submit = uring_submit,
+    .reap = uring_reap,
+    .queue_close = uring_queue_close,
+};
+
+#else
+
+static void* uring_open(const options_t* opts) {
+  (void)opts;
+  fprintf(stderr, "io_uring is not supported on this platform\n");
+  return NULL;
+}
+
+const io_engine_t io_engine_uring = {
+    .name = "io_uring",
+    .open = uring_open,
+};
+
+#endif
@@ -0,0 +1,351 @@
+#include "io_load.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define VERIFY_HW_X86 1
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define VERIFY_HW_ARM 1
+#endif
+
+#define VERIFY_MAGIC 0x56545056U  // "VPTV"
+#define VERIFY_MAX_REPORTS 10
+// state[] packs the generation last handed out above the writes in flight.
+#define VERIFY_PENDING_BITS 24
+#define VERIFY_PENDING_MASK ((1ULL << VERIFY_PENDING_BITS) - 1)
+// Marks a write issued with no older one to its block still in flight, or a
+// read issued while one was.
+#define VERIFY_BARRIER (1ULL << 63)
+#define VERIFY_OVERLAP (1ULL << 63)
+// A read's token holds the floor above the generation started at its issue.
+#define VERIFY_FLOOR_SHIFT 32
+
+#define CRC_POLY 0x82F63B78U
+// The hardware path splits longer buffers into three stripes of at least
+// this many bytes, so the instruction's latency overlaps across them.
+#define CRC_STRIPE_MIN 128
+
+// Leads every verified block. crc covers the whole block with crc itself
+// read as 0; the rest of the block is filled from offset and generation.
+typedef struct {
+  uint32_t magic;
+  uint32_t crc;
+  uint64_t offset;
+  uint64_t epoch;
+  uint64_t generation;
+} verify_header_t;
+
+typedef struct {
+  size_t stripe;
+  uint32_t one;
+  uint32_t two;
+} crc_shift_t;
+
+static uint32_t crc_table[8][256];
+// x^(2^k) modulo the polynomial.
+static uint32_t crc_x2n[32];
+static _Thread_local crc_shift_t crc_shift;
+
+static void crc_init_table(void) {
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t crc = i;
+    for (int k = 0; k < 8; ++k)
+      crc = (crc >> 1) ^ (CRC_POLY & (0U - (crc & 1)));
+    crc_table[0][i] = crc;
+  }
+  for (uint32_t i = 0; i < 256; ++i) {
+    for (int t = 1; t < 8; ++t)
+      crc_table[t][i] = (crc_table[t - 1][i] >> 8) ^ crc_table[0][crc_table[t - 1][i] & 0xFF];
+  }
+}
+
+// a * b modulo the polynomial, in the CRC's reflected bit order; a != 0.
+static uint32_t multmodp(uint32_t a, uint32_t b) {
+  uint32_t m = 1U << 31;
+  uint32_t p = 0;
+  for (;;) {
+    if (a & m) {
+      p ^= b;
+      if ((a & (m - 1)) == 0)
+        break;
+    }
+    m >>= 1;
+    b = (b & 1) ? (b >> 1) ^ CRC_POLY : b >> 1;
+  }
+  return p;
+}
+
+static void crc_init_shift(void) {
+  crc_x2n[0] = 1U << 30;
+  for (int k = 1; k < 32; ++k)
+    crc_x2n[k] = multmodp(crc_x2n[k - 1], crc_x2n[k - 1]);
+}
+
+// x^(8 * n): multiplying a CRC register by it runs it over n zero bytes.
+static uint32_t shift_bytes(size_t n) {
+  uint32_t p = 1U << 31;
+  for (unsigned k = 3; n != 0; n >>= 1, ++k) {
+    if (n & 1)
+      p = multmodp(crc_x2n[k & 31], p);
+  }
+  return p;
+}
+
+// Joins the registers of three consecutive stripes, the later two started
+// from 0. Runs use one block size, so the factors are kept per thread.
+static uint32_t crc_join(uint32_t c0, uint32_t c1, uint32_t c2, size_t stripe) {
+  if (crc_shift.stripe != stripe) {
+    crc_shift.stripe = stripe;
+    crc_shift.one = shift_bytes(stripe);
+    crc_shift.two = shift_bytes(2 * stripe);
+  }
+  return multmodp(crc_shift.two, c0) ^ multmodp(crc_shift.one, c1) ^ c2;
+}
+
+// Slicing-by-8 for CPUs without a CRC32C instruction.
+static uint32_t crc32c_sw(uint32_t crc, const unsigned char* data, size_t len) {
+  for (; len >= 8; data += 8, len -= 8) {
+    uint64_t word;
+    memcpy(&word, data, sizeof(word));
+    word ^= crc;
+    crc = crc_table[7][word & 0xFF] ^ crc_table[6][(word >> 8) & 0xFF] ^ crc_table[5][(word >> 16) & 0xFF] ^
+          crc_table[4][(word >> 24) & 0xFF] ^ crc_table[3][(word >> 32) & 0xFF] ^
+          crc_table[2][(word >> 40) & 0xFF] ^ crc_table[1][(word >> 48) & 0xFF] ^ crc_table[0][word >> 56];
+  }
+  for (; len > 0; ++data, --len)
+    crc = (crc >> 8) ^ crc_table[0][(crc ^ *data) & 0xFF];
+  return crc;
+}
+
+#if defined(VERIFY_HW_X86)
+__attribute__((target("sse4.2"))) static uint32_t crc32c_hw(uint32_t crc, const unsigned char* data, size_t len) {
+  if (len >= 3 * CRC_STRIPE_MIN) {
+    size_t stripe = len / 24 * 8;
+    uint64_t c0 = crc;
+    uint64_t c1 = 0;
+    uint64_t c2 = 0;
+    for (const unsigned char* end = data + stripe; data < end; data += 8) {
+      uint64_t w[3];
+      memcpy(&w[0], data, 8);
+      memcpy(&w[1], data + stripe, 8);
+      memcpy(&w[2], data + 2 * stripe, 8);
+      c0 = _mm_crc32_u64(c0, w[0]);
+      c1 = _mm_crc32_u64(c1, w[1]);
+      c2 = _mm_crc32_u64(c2, w[2]);
+    }
+    crc = crc_join((uint32_t)c0, (uint32_t)c1, (uint32_t)c2, stripe);
+    data += 2 * stripe;
+    len -= 3 * stripe;
+  }
+  uint64_t crc64 = crc;
+  for (; len >= 8; data += 8, len -= 8) {
+    uint64_t word;
+    memcpy(&word, data, sizeof(word));
+    crc64 = _mm_crc32_u64(crc64, word);
+  }
+  crc = (uint32_t)crc64;
+  for (; len > 0; ++data, --len)
+    crc = _mm_crc32_u8(crc, *data);
+  return crc;
+}
+#elif defined(VERIFY_HW_ARM)
+static uint32_t crc32c_hw(uint32_t crc, const unsigned char* data, size_t len) {
+  if (len >= 3 * CRC_STRIPE_MIN) {
+    size_t stripe = len / 24 * 8;
+    uint32_t c[3] = {crc, 0, 0};
+    for (size_t i = 0; i < stripe; i += 8) {
+      for (int s = 0; s < 3; ++s) {
+        uint64_t word;
+        memcpy(&word, data + s * stripe + i, sizeof(word));
+        c[s] = __crc32cd(c[s], word);
+      }
+    }
+    crc = crc_join(c[0], c[1], c[2], stripe);
+    data += 3 * stripe;
+    len -= 3 * stripe;
+  }
+  for (; len >= 8; data += 8, len -= 8) {
+    uint64_t word;
+    memcpy(&word, data, sizeof(word));
+    crc = __crc32cd(crc, word);
+  }
+  for (; len > 0; ++data, --len)
+    crc = __crc32cb(crc, *data);
+  return crc;
+}
+#endif
+
+static uint32_t (*crc32c_impl)(uint32_t, const unsigned char*, size_t);
+
+static void crc32c_select(void) {
+  crc_init_shift();
+#if defined(VERIFY_HW_X86)
+  if (__builtin_cpu_supports("sse4.2")) {
+    crc32c_impl = crc32c_hw;
+    return;
+  }
+#elif defined(VERIFY_HW_ARM)
+  crc32c_impl = crc32c_hw;
+  return;
+#endif
+  crc_init_table();
+  crc32c_impl = crc32c_sw;
+}
+
+uint32_t crc32c(uint32_t crc, const void* data, size_t len) {
+  return ~crc32c_impl(~crc, data, len);
+}
+
+bool verify_hardware(void) {
+  return crc32c_impl != crc32c_sw;
+}
+
+int verify_init(io_verify_t* verify, const options_t* opts) {
+  memset(verify, 0, sizeof(*verify));
+  if (opts->block_size < sizeof(verify_header_t)) {
+    fprintf(stderr, "--verify needs blocks of at least %zu bytes\n", sizeof(verify_header_t));
+    return -1;
+  }
+  crc32c_select();
+
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  verify->epoch = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+  verify->range_start = opts->range_start;
+  verify->block_size = opts->block_size;
+  verify->slots = (size_t)((opts->range_end - opts->range_start) / (off_t)opts->block_size);
+  verify->state = calloc(verify->slots, sizeof(*verify->state));
+  verify->committed = calloc(verify->slots, sizeof(*verify->committed));
+  verify->overlapped = calloc(verify->slots, sizeof(*verify->overlapped));
+  if (verify->state == NULL || verify->committed == NULL || verify->overlapped == NULL) {
+    fprintf(stderr, "calloc failed\n");
+    verify_free(verify);
+    return -1;
+  }
+  return 0;
+}
+
+void verify_free(io_verify_t* verify) {
+  free(verify->state);
+  free(verify->committed);
+  free(verify->overlapped);
+  verify->state = NULL;
+  verify->committed = NULL;
+  verify->overlapped = NULL;
+}
+
+static size_t slot_of(const io_verify_t* verify, off_t offset) {
+  return (size_t)((offset - verify->range_start) / (off_t)verify->block_size);
+}
+
+static void atomic_max(uint64_t* target, uint64_t value) {
+  uint64_t seen = __atomic_load_n(target, __ATOMIC_ACQUIRE);
+  while (seen < value &&
+         !__atomic_compare_exchange_n(target, &seen, value, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+  }
+}
+
+// The header with crc 0, then the payload, in one pass.
+static uint32_t block_crc(const unsigned char* block, size_t count) {
+  verify_header_t header;
+  memcpy(&header, block, sizeof(header));
+  header.crc = 0;
+  uint32_t crc = crc32c(0, &header, sizeof(header));
+  return crc32c(crc, block + sizeof(header), count - sizeof(header));
+}
+
+uint64_t verify_fill(io_verify_t* verify, void* buffer, size_t count, off_t offset) {
+  size_t slot = slot_of(verify, offset);
+  uint64_t old = __atomic_fetch_add(&verify->state[slot], (1ULL << VERIFY_PENDING_BITS) + 1, __ATOMIC_ACQ_REL);
+  uint64_t generation = (old >> VERIFY_PENDING_BITS) + 1;
+  bool barrier = (old & VERIFY_PENDING_MASK) == 0;
+  if (!barrier)
+    atomic_max(&verify->overlapped[slot], generation);
+  verify_header_t header = {
+      .magic = VERIFY_MAGIC,
+      .crc = 0,
+      .offset = (uint64_t)offset,
+      .epoch = verify->epoch,
+      .generation = generation,
+  };
+  unsigned char* block = buffer;
+  memcpy(block, &header, sizeof(header));
+
+  uint64_t seed = (uint64_t)offset * 0x9E3779B97F4A7C15ULL ^ generation;
+  size_t i = sizeof(header);
+  uint64_t word = seed + i * 0xBF58476D1CE4E5B9ULL;
+  for (; i + sizeof(uint64_t) <= count; i += sizeof(uint64_t)) {
+    memcpy(block + i, &word, sizeof(word));
+    word += sizeof(uint64_t) * 0xBF58476D1CE4E5B9ULL;
+  }
+  for (; i < count; ++i)
+    block[i] = (unsigned char)(seed >> (i % 8 * 8));
+
+  header.crc = block_crc(block, count);
+  memcpy(block, &header, sizeof(header));
+  return barrier ? generation | VERIFY_BARRIER : generation;
+}
+
+// Writes to a block that overlap may land in any order, so only one issued
+// after all older ones completed sets the oldest generation reads may see.
+void verify_written(io_verify_t* verify, off_t offset, uint64_t token) {
+  size_t slot = slot_of(verify, offset);
+  __atomic_fetch_sub(&verify->state[slot], 1, __ATOMIC_ACQ_REL);
+  if ((token & VERIFY_BARRIER) == 0)
+    return;
+  atomic_max(&verify->committed[slot], token & ~VERIFY_BARRIER);
+}
+
+uint64_t verify_reading(io_verify_t* verify, off_t offset) {
+  size_t slot = slot_of(verify, offset);
+  uint64_t floor = __atomic_load_n(&verify->committed[slot], __ATOMIC_ACQUIRE);
+  uint64_t state = __atomic_load_n(&verify->state[slot], __ATOMIC_ACQUIRE);
+  uint64_t token = floor << VERIFY_FLOOR_SHIFT | (uint32_t)(state >> VERIFY_PENDING_BITS);
+  // Overlapping writes may also have left a mix of both behind.
+  bool overlap = (state & VERIFY_PENDING_MASK) != 0 ||
+                 __atomic_load_n(&verify->overlapped[slot], __ATOMIC_ACQUIRE) > floor;
+  return overlap ? token | VERIFY_OVERLAP : token;
+}
+
+static bool report_mismatch(io_verify_t* verify, off_t offset, const char* what, uint64_t got, uint64_t want) {
+  __atomic_fetch_add(&verify->failed, 1, __ATOMIC_RELAXED);
+  if (__atomic_fetch_add(&verify->reports, 1, __ATOMIC_RELAXED) < VERIFY_MAX_REPORTS)
+    fprintf(stderr, "verify: block at %lld: %s %" PRIu64 ", expected %" PRIu64 "\n", (long long)offset, what, got,
+            want);
+  return false;
+}
+
+// A block this run wrote must be no older than the floor when the read was
+// issued, nor newer than the last write started by its completion. Other
+// blocks only need to be intact. A read that overlapped a write to its block
+// may see parts of both, as through mmap, and so may one after overlapping
+// writes, so their checksum goes unchecked.
+bool verify_check(io_verify_t* verify, const void* buffer, size_t count, off_t offset, uint64_t token) {
+  uint64_t state = __atomic_load_n(&verify->state[slot_of(verify, offset)], __ATOMIC_ACQUIRE);
+  uint64_t started = state >> VERIFY_PENDING_BITS;
+  uint64_t committed = (token & ~VERIFY_OVERLAP) >> VERIFY_FLOOR_SHIFT;
+  bool overlap = (token & VERIFY_OVERLAP) != 0 || (uint32_t)started != (uint32_t)token;
+
+  verify_header_t header;
+  memcpy(&header, buffer, sizeof(header));
+  if (header.magic != VERIFY_MAGIC)
+    return report_mismatch(verify, offset, "bad magic", header.magic, VERIFY_MAGIC);
+  uint32_t crc = block_crc(buffer, count);
+  if (header.crc != crc && !overlap)
+    return report_mismatch(verify, offset, "checksum", header.crc, crc);
+  if (header.offset != (uint64_t)offset)
+    return report_mismatch(verify, offset, "holds offset", header.offset, (uint64_t)offset);
+  if (committed == 0)
+    return true;
+  if (header.epoch != verify->epoch)
+    return report_mismatch(verify, offset, "is from run", header.epoch, verify->epoch);
+  if (header.generation < committed || header.generation > started)
+    return report_mismatch(verify, offset, "is generation", header.generation, committed);
+  return true;
+}
@@ -5,190 +5,109 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/stat.h>
-#include <sys/types.h>
-#include <time.h>
-#include <unistd.h>
 
 #include "vtpc.h"
 
-static void* allocate_buffer(size_t size) {
-  void* buffer = malloc(size);
-  if (buffer == NULL)
-    fprintf(stderr, "malloc failed\n");
-  return buffer;
-}
-
-static double seconds_between(const struct timespec* start,
-                              const struct timespec* end) {
-  time_t sec = end->tv_sec - start->tv_sec;
-  long nsec = end->tv_nsec - start->tv_nsec;
-  if (nsec < 0) {
-    sec -= 1;
-    nsec += 1000000000L;
-  }
-  return (double)sec + (double)nsec / 1e9;
-}
+typedef struct {
+  int fd;
+  // Where the cache counters go, kept off stdout in machine formats.
+  FILE* out;
+} cache_t;
 
-static int check_range(const options_t* opts, const struct stat* st) {
-  off_t range_start = opts->range_start;
-  off_t range_end = opts->range_end;
-
-  if (!opts->range_set) {
-    range_start = 0;
-    if (opts->mode == MODE_READ) {
-      range_end = st->st_size;
-    } else {
-      range_end = range_start + (off_t)(opts->block_size * opts->block_count);
-    }
+static void* cache_open(const options_t* opts) {
+  cache_t* ctx = malloc(sizeof(*ctx));
+  if (ctx == NULL) {
+    fprintf(stderr, "malloc failed\n");
+    return NULL;
   }
 
-  if (opts->mode == MODE_READ && range_end > st->st_size) {
-    fprintf(stderr, "Range exceeds file size for read mode\n");
-    return -1;
+  static const int policies[] = {
+      [POLICY_MRU] = VTPC_POLICY_MRU,
+      [POLICY_LRU] = VTPC_POLICY_LRU,
+      [POLICY_FIFO] = VTPC_POLICY_FIFO,
+      [POLICY_CLOCK] = VTPC_POLICY_CLOCK,
+  };
+
+  // vtpc aligns its own page I/O, so any block size works either way.
+  struct vtpc_options options;
+  vtpc_options_init(&options);
+  options.capacity = opts->cache_pages;
+  options.policy = policies[opts->policy];
+  options.direct = opts->use_direct ? VTPC_DIRECT_ON : VTPC_DIRECT_OFF;
+  ctx->fd = vtpc_open_ex(opts->path, open_flags(opts), 0666, &options);
+  if (ctx->fd < 0) {
+    if (opts->use_direct && errno == EINVAL)
+      fprintf(stderr, "Failed to open %s via vtpc: the file system does not support O_DIRECT\n", opts->path);
+    else
+      fprintf(stderr, "Failed to open %s via vtpc: %s\n", opts->path, strerror(errno));
+    free(ctx);
+    return NULL;
   }
 
-  if (range_end <= range_start) {
-    fprintf(stderr, "Invalid range\n");
-    return -1;
-  }
+  ctx->out = (opts->output == OUTPUT_TEXT) ? stdout : stderr;
 
-  off_t span = range_end - range_start;
-  if (opts->order == ORDER_SEQUENCE &&
-      span < (off_t)(opts->block_size * opts->block_count)) {
-    fprintf(stderr, "Range is too small for sequential access\n");
-    return -1;
-  }
-
-  return 0;
+  return ctx;
 }
 
-static off_t pick_offset(const options_t* opts, off_t range_start, size_t index) {
-  if (opts->order == ORDER_RANDOM) {
-    off_t range_bytes = opts->range_end - opts->range_start;
-    if (range_bytes < (off_t)opts->block_size)
-      return opts->range_start;
-
-    off_t slots = range_bytes / (off_t)opts->block_size;
-    if (slots <= 0)
-      slots = 1;
-    off_t slot = (off_t)(rand() % (int)slots);
-    return opts->range_start + slot * (off_t)opts->block_size;
-  }
-
-  return range_start + (off_t)(index * opts->block_size);
+static void cache_advise(void* ctx, const options_t* opts) {
+  static const int advice[] = {
+      [ADVICE_NORMAL] = VTPC_FADV_NORMAL,
+      [ADVICE_SEQUENTIAL] = VTPC_FADV_SEQUENTIAL,
+      [ADVICE_RANDOM] = VTPC_FADV_RANDOM,
+      [ADVICE_WILLNEED] = VTPC_FADV_WILLNEED,
+      [ADVICE_DONTNEED] = VTPC_FADV_DONTNEED,
+      [ADVICE_NOREUSE] = VTPC_FADV_NOREUSE,
+  };
+
+  int fd = ((cache_t*)ctx)->fd;
+  if (vtpc_fadvise(fd, opts->range_start, opts->range_end - opts->range_start, advice[opts->advice]) != 0)
+    fprintf(stderr, "vtpc_fadvise failed: %s\n", strerror(errno));
 }
 
-static int vtpc_seek(int fd, off_t offset) {
-  if (vtpc_lseek(fd, offset, SEEK_SET) == (off_t)-1) {
-    fprintf(stderr, "vtpc_lseek failed: %s\n", strerror(errno));
-    return -1;
-  }
-  return 0;
+// Workers share one handle, so positioned calls keep their offsets apart.
+static ssize_t cache_read(void* ctx, void* buffer, size_t count, off_t offset) {
+  return vtpc_pread(((cache_t*)ctx)->fd, buffer, count, offset);
 }
 
-int run_io_workload(const options_t* opts) {
-  struct stat st;
-  memset(&st, 0, sizeof(st));
-  if (opts->mode == MODE_READ) {
-    if (stat(opts->path, &st) != 0) {
-      fprintf(stderr, "stat failed: %s\n", strerror(errno));
-      return 1;
-    }
-  }
-
-  int flags = (opts->mode == MODE_READ) ? O_RDONLY : (O_WRONLY | O_CREAT);
-  int fd = vtpc_open(opts->path, flags, 0666);
-  if (fd < 0) {
-    fprintf(stderr, "Failed to open %s via vtpc: %s\n", opts->path, strerror(errno));
-    return 1;
-  }
-
-  if (opts->use_direct) {
-    fprintf(stderr, "Note: --direct is handled inside vtpc_open (O_DIRECT/F_NOCACHE best-effort)\n");
-  }
-
-  options_t local_opts = *opts;
-  if (!local_opts.range_set) {
-    local_opts.range_start = 0;
-    if (local_opts.mode == MODE_READ)
-      local_opts.range_end = st.st_size;
-    else
-      local_opts.range_end = local_opts.range_start + (off_t)(local_opts.block_size * local_opts.block_count);
-  }
-
-  if (check_range(&local_opts, &st) != 0) {
-    vtpc_close(fd);
-    return 1;
-  }
-
-  void* buffer = allocate_buffer(local_opts.block_size);
-  if (buffer == NULL) {
-    vtpc_close(fd);
-    return 1;
-  }
-
-  if (local_opts.mode == MODE_WRITE) {
-    for (size_t i = 0; i < local_opts.block_size; ++i)
-      ((unsigned char*)buffer)[i] = (unsigned char)('A' + (i % 26));
-  }
+static ssize_t cache_write(void* ctx, void* buffer, size_t count, off_t offset) {
+  return vtpc_pwrite(((cache_t*)ctx)->fd, buffer, count, offset);
+}
 
-  srand(0);
-
-  struct timespec total_start = {0}, total_end = {0};
-  clock_gettime(CLOCK_MONOTONIC, &total_start);
-
-  for (int r = 0; r < local_opts.repeat; ++r) {
-    struct timespec start, end;
-    clock_gettime(CLOCK_MONOTONIC, &start);
-
-    for (size_t i = 0; i < local_opts.block_count; ++i) {
-      off_t offset = pick_offset(&local_opts, local_opts.range_start, i);
-      if (vtpc_seek(fd, offset) != 0) {
-        free(buffer);
-        vtpc_close(fd);
-        return 1;
-      }
-
-      ssize_t done;
-      if (local_opts.mode == MODE_READ) {
-        done = vtpc_read(fd, buffer, local_opts.block_size);
-      } else {
-        done = vtpc_write(fd, buffer, local_opts.block_size);
-      }
-
-      if (done < 0) {
-        fprintf(stderr, "I/O error at block %zu: %s\n", i, strerror(errno));
-        free(buffer);
-        vtpc_close(fd);
-        return 1;
-      }
-      if ((size_t)done != local_opts.block_size) {
-        fprintf(stderr, "Short transfer at block %zu\n", i);
-        free(buffer);
-        vtpc_close(fd);
-        return 1;
-      }
-    }
-
-    clock_gettime(CLOCK_MONOTONIC, &end);
-    time_t sec = end.tv_sec - start.tv_sec;
-    long nsec = end.tv_nsec - start.tv_nsec;
-    if (nsec < 0) {
-      sec -= 1;
-      nsec += 1000000000L;
-    }
-    double elapsed = (double)sec + (double)nsec / 1e9;
-    printf("Iteration %d: blocks=%zu size=%zu bytes time=%.6f s\n", r + 1, local_opts.block_count, local_opts.block_size, elapsed);
-  }
+static void print_stats(int fd, FILE* out) {
+  struct vtpc_stats stats;
+  if (vtpc_get_stats(fd, &stats) != 0)
+    return;
+  fprintf(out, "Cache: hits=%llu misses=%llu evictions=%llu readahead=%llu willneed=%llu dropped=%llu\n",
+         (unsigned long long)stats.hits,
+         (unsigned long long)stats.misses,
+         (unsigned long long)stats.evictions,
+         (unsigned long long)stats.readahead_pages,
+         (unsigned long long)stats.willneed_pages,
+         (unsigned long long)stats.dropped_pages);
+}
 
-  clock_gettime(CLOCK_MONOTONIC, &total_end);
-  printf("Total time (vtpc): %.6f s\n", seconds_between(&total_start, &total_end));
+static int cache_sync(void* ctx) {
+  return vtpc_fsync(((cache_t*)ctx)->fd);
+}
 
+static int cache_close(void* ctx) {
+  int fd = ((cache_t*)ctx)->fd;
   if (vtpc_fsync(fd) != 0)
     fprintf(stderr, "vtpc_fsync failed: %s\n", strerror(errno));
 
-  free(buffer);
-  vtpc_close(fd);
-  return 0;
+  print_stats(fd, ((cache_t*)ctx)->out);
+
+  int result = vtpc_close(fd);
+  free(ctx);
+  return result;
 }
+
+const io_engine_t io_engine_vtpc = {
+    .name = "vtpc",
+    .open = cache_open,
+    .advise = cache_advise,
+    .read = cache_read,
+    .write = cache_write,
+    .close = cache_close,
+    .sync = cache_sync,
+};
@@ -0,0 +1,696 @@
+#include "io_load.h"
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/prctl.h>
+#endif
+
+#define WAIT_SPIN_NS 20000
+
+typedef struct {
+  const options_t* opts;
+  void* ctx;
+  int index;
+  off_t range_start;
+  off_t range_end;
+  io_sampler_t sampler;
+  io_rng_t rng;
+  // Next transfer for the synchronous pool behind --iodepth.
+  size_t next;
+  // Schedule under --rate: intended start of the next transfer and the mean
+  // gap between them. Pool threads take turns on it under lock.
+  double due_ns;
+  double gap_ns;
+  pthread_mutex_t lock;
+  // Transfers finishing before measure_ns are warm-up; none start after
+  // end_ns unless it is 0.
+  uint64_t measure_ns;
+  uint64_t end_ns;
+  int finished;
+  // Since the last --interval row, warm-up included, under lock.
+  io_stats_t interval[2];
+  int failed;
+  io_verify_t* verify;
+  // This worker's stream of a --trace, and when a timed replay of it began,
+  // the same for all workers. Syncs count the fsyncs done past warm-up.
+  const io_trace_op_t* trace_ops;
+  size_t trace_count;
+  uint64_t replay_ns;
+  size_t syncs;
+  uint64_t sync_ns;
+  // Reads, then writes.
+  io_stats_t stats[2];
+} worker_t;
+
+typedef struct {
+  worker_t* worker;
+  io_rng_t rng;
+  io_stats_t stats[2];
+} helper_t;
+
+static uint64_t now_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+// Intended start of the next transfer under --rate, 0 when unthrottled.
+static uint64_t next_due(worker_t* worker) {
+  if (worker->gap_ns == 0)
+    return 0;
+  uint64_t due = (uint64_t)worker->due_ns;
+  double gap = worker->gap_ns;
+  if (worker->opts->arrival == ARRIVAL_POISSON)
+    gap *= -log(1 - rng_double(&worker->rng));
+  worker->due_ns += gap;
+  return due;
+}
+
+// Sleeps to just short of ns and spins the rest, since the time the wakeup
+// is late counts as latency of the transfer.
+static void wait_until(uint64_t ns) {
+  uint64_t wake = ns - WAIT_SPIN_NS;
+  if (ns > WAIT_SPIN_NS && now_ns() < wake) {
+    struct timespec when = {.tv_sec = (time_t)(wake / 1000000000ULL), .tv_nsec = (long)(wake % 1000000000ULL)};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &when, NULL) == EINTR) {
+    }
+  }
+  while (now_ns() < ns) {
+  }
+}
+
+off_t workload_span(const options_t* opts) {
+  off_t span = (off_t)(opts->block_size * opts->block_count);
+  return opts->shared ? span : span * opts->threads;
+}
+
+static off_t pick_offset(const worker_t* worker, io_rng_t* rng, size_t index) {
+  const options_t* opts = worker->opts;
+  if (opts->order == ORDER_RANDOM) {
+    if (worker->sampler.slots == 0)
+      return worker->range_start;
+    return worker->range_start + (off_t)(sampler_next(&worker->sampler, rng) * opts->block_size);
+  }
+
+  return worker->range_start + (off_t)(index * opts->block_size);
+}
+
+// Mixed runs pick the direction of each transfer by --rwmixread.
+static bool pick_write(const options_t* opts, io_rng_t* rng) {
+  if (opts->mode != MODE_MIXED)
+    return opts->mode == MODE_WRITE;
+  return rng_next(rng) % 100 >= opts->rwmixread;
+}
+
+static size_t transfer_size(const options_t* opts, bool write) {
+  return write ? opts->write_size : opts->read_size;
+}
+
+// count pairs of block_size halves: reads land in the first, the second holds
+// the pattern that is written. They are allocated once per worker and
+// page-aligned, as --direct transfers need.
+static unsigned char* alloc_buffers(const options_t* opts, size_t count) {
+  void* memory = NULL;
+  int err = posix_memalign(&memory, (size_t)sysconf(_SC_PAGESIZE), count * 2 * opts->block_size);
+  if (err != 0) {
+    fprintf(stderr, "posix_memalign failed: %s\n", strerror(err));
+    return NULL;
+  }
+  unsigned char* buffers = memory;
+  for (size_t b = 0; b < count; ++b) {
+    unsigned char* pattern = buffers + (2 * b + 1) * opts->block_size;
+    for (size_t i = 0; i < opts->block_size; ++i)
+      pattern[i] = (unsigned char)('A' + (i % 26));
+  }
+  return buffers;
+}
+
+static void* half(const options_t* opts, unsigned char* pair, bool write) {
+  return write ? pair + opts->block_size : pair;
+}
+
+static void init_stats(io_stats_t* stats, size_t count) {
+  memset(stats, 0, count * sizeof(*stats));
+  for (size_t i = 0; i < count; ++i)
+    stats[i].latency_min_ns = UINT64_MAX;
+}
+
+static void record(io_stats_t* stats, uint64_t bytes, uint64_t latency, uint64_t submit) {
+  stats->ops++;
+  stats->bytes += bytes;
+  stats->latency_sum_ns += latency;
+  if (latency < stats->latency_min_ns)
+    stats->latency_min_ns = latency;
+  if (latency > stats->latency_max_ns)
+    stats->latency_max_ns = latency;
+  stats->submit_sum_ns += submit;
+  if (submit > stats->submit_max_ns)
+    stats->submit_max_ns = submit;
+  hist_record(&stats->latency, latency);
+}
+
+static void merge_stats(io_stats_t* into, const io_stats_t* from) {
+  into->ops += from->ops;
+  into->bytes += from->bytes;
+  into->latency_sum_ns += from->latency_sum_ns;
+  if (from->latency_min_ns < into->latency_min_ns)
+    into->latency_min_ns = from->latency_min_ns;
+  if (from->latency_max_ns > into->latency_max_ns)
+    into->latency_max_ns = from->latency_max_ns;
+  into->submit_sum_ns += from->submit_sum_ns;
+  if (from->submit_max_ns > into->submit_max_ns)
+    into->submit_max_ns = from->submit_max_ns;
+  for (unsigned i = 0; i < IO_HIST_BUCKETS; ++i)
+    into->latency.counts[i] += from->latency.counts[i];
+}
+
+static bool expired(const worker_t* worker) {
+  return worker->end_ns != 0 && now_ns() >= worker->end_ns;
+}
+
+// Counts a transfer that ran from start to end into stats once past the
+// warm-up, and into the interval totals from the beginning.
+static void account(worker_t* worker, io_stats_t stats[2], bool write, uint64_t bytes, uint64_t start,
+                    uint64_t submit, uint64_t end) {
+  if (end >= worker->measure_ns)
+    record(&stats[write], bytes, end - start, submit);
+  if (worker->opts->interval > 0) {
+    pthread_mutex_lock(&worker->lock);
+    record(&worker->interval[write], bytes, end - start, submit);
+    pthread_mutex_unlock(&worker->lock);
+  }
+}
+
+// Under --verify, stamps a block about to be written or notes what a read of
+// it has to find; the result goes to verify_end() once the transfer is done.
+static uint64_t verify_begin(const worker_t* worker, void* buffer, size_t count, off_t offset, bool write) {
+  if (worker->verify == NULL)
+    return 0;
+  if (write)
+    return verify_fill(worker->verify, buffer, count, offset);
+  return verify_reading(worker->verify, offset);
+}
+
+static void verify_end(const worker_t* worker, const void* buffer, size_t count, off_t offset, bool write,
+                       uint64_t token) {
+  if (worker->verify == NULL)
+    return;
+  if (write)
+    verify_written(worker->verify, offset, token);
+  else
+    verify_check(worker->verify, buffer, count, offset, token);
+}
+
+static int check_transfer(worker_t* worker, ssize_t done, size_t count, size_t index) {
+  if (done < 0) {
+    fprintf(stderr, "Thread %d: I/O error at block %zu: %s\n", worker->index, index, strerror(errno));
+    return -1;
+  }
+  if ((size_t)done != count) {
+    fprintf(stderr, "Thread %d: short transfer at block %zu\n", worker->index, index);
+    return -1;
+  }
+  return 0;
+}
+
+// Reports pass r, which began at start, as an iteration row and adds it up.
+static void end_pass(worker_t* worker, int r, uint64_t start, io_stats_t pass[2]) {
+  uint64_t from = start > worker->measure_ns ? start : worker->measure_ns;
+  uint64_t end = now_ns();
+  pass[0].seconds = pass[1].seconds = end > from ? (double)(end - from) / 1e9 : 0;
+  report_stats(worker->opts, SCOPE_ITERATION, r + 1, pass);
+  merge_stats(&worker->stats[0], &pass[0]);
+  merge_stats(&worker->stats[1], &pass[1]);
+}
+
+static int run_sync(worker_t* worker) {
+  const options_t* opts = worker->opts;
+  const io_engine_t* engine = opts->engine;
+  unsigned char* buffer = alloc_buffers(opts, 1);
+  if (buffer == NULL)
+    return -1;
+
+  // A lone stream also reports each pass; interleaved ones only add up, and
+  // timed runs have intervals instead.
+  bool iterations = opts->threads == 1 && opts->runtime == 0;
+  bool stop = false;
+  io_stats_t pass[2];
+  for (int r = 0; !stop && (opts->runtime > 0 || r < opts->repeat); ++r) {
+    io_stats_t* stats = iterations ? pass : worker->stats;
+    if (iterations)
+      init_stats(pass, 2);
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < opts->block_count; ++i) {
+      if (expired(worker)) {
+        stop = true;
+        break;
+      }
+      off_t offset = pick_offset(worker, &worker->rng, i);
+      bool write = pick_write(opts, &worker->rng);
+      size_t count = transfer_size(opts, write);
+      void* data = half(opts, buffer, write);
+      uint64_t token = verify_begin(worker, data, count, offset, write);
+      uint64_t due = next_due(worker);
+      if (due != 0)
+        wait_until(due);
+      uint64_t issued = now_ns();
+      ssize_t done = (write ? engine->write : engine->read)(worker->ctx, data, count, offset);
+      if (check_transfer(worker, done, count, i) != 0) {
+        free(buffer);
+        return -1;
+      }
+      account(worker, stats, write, (uint64_t)done, due != 0 ? due : issued, 0, now_ns());
+      verify_end(worker, data, count, offset, write, token);
+    }
+
+    if (iterations)
+      end_pass(worker, r, start, pass);
+  }
+  free(buffer);
+  return 0;
+}
+
+// Replays the worker's stream of the trace one operation at a time. A timed
+// replay issues each at its recorded time into the pass, passes following
+// each other by the span of the trace, and as under --rate counts latency
+// from then.
+static int run_trace(worker_t* worker) {
+  const options_t* opts = worker->opts;
+  const io_engine_t* engine = opts->engine;
+  unsigned char* buffer = alloc_buffers(opts, 1);
+  if (buffer == NULL)
+    return -1;
+
+  bool iterations = opts->threads == 1 && opts->runtime == 0;
+  bool stop = false;
+  io_stats_t pass[2];
+  for (int r = 0; !stop && (opts->runtime > 0 || r < opts->repeat); ++r) {
+    io_stats_t* stats = iterations ? pass : worker->stats;
+    if (iterations)
+      init_stats(pass, 2);
+    uint64_t start = now_ns();
+    uint64_t base = worker->replay_ns + (uint64_t)r * opts->trace->span_ns;
+    for (size_t i = 0; i < worker->trace_count; ++i) {
+      if (expired(worker)) {
+        stop = true;
+        break;
+      }
+      const io_trace_op_t* op = &worker->trace_ops[i];
+      uint64_t due = opts->trace_timed ? base + op->time_ns : 0;
+      if (due != 0)
+        wait_until(due);
+      uint64_t issued = now_ns();
+      if (op->kind == TRACE_SYNC) {
+        if (engine->sync != NULL && engine->sync(worker->ctx) != 0) {
+          fprintf(stderr, "Thread %d: fsync failed at operation %zu: %s\n", worker->index, i, strerror(errno));
+          free(buffer);
+          return -1;
+        }
+        uint64_t end = now_ns();
+        if (end >= worker->measure_ns) {
+          worker->syncs++;
+          worker->sync_ns += end - (due != 0 ? due : issued);
+        }
+        continue;
+      }
+
+      bool write = op->kind == TRACE_WRITE;
+      void* data = half(opts, buffer, write);
+      ssize_t done = (write ? engine->write : engine->read)(worker->ctx, data, op->length, (off_t)op->offset);
+      if (check_transfer(worker, done, op->length, i) != 0) {
+        free(buffer);
+        return -1;
+      }
+      account(worker, stats, write, (uint64_t)done, due != 0 ? due : issued, 0, now_ns());
+    }
+
+    if (iterations)
+      end_pass(worker, r, start, pass);
+  }
+  free(buffer);
+  return 0;
+}
+
+// Fallback for engines without a queue: iodepth threads share the worker's
+// sequence of transfers, each keeping one in flight.
+static void* run_helper(void* arg) {
+  helper_t* helper = arg;
+  worker_t* worker = helper->worker;
+  const options_t* opts = worker->opts;
+  const io_engine_t* engine = opts->engine;
+  size_t total = opts->runtime > 0 ? SIZE_MAX : opts->block_count * (size_t)opts->repeat;
+  unsigned char* buffer = alloc_buffers(opts, 1);
+  if (buffer == NULL) {
+    __atomic_store_n(&worker->failed, 1, __ATOMIC_RELAXED);
+    return NULL;
+  }
+
+  for (;;) {
+    size_t i = __atomic_fetch_add(&worker->next, 1, __ATOMIC_RELAXED);
+    if (i >= total || __atomic_load_n(&worker->failed, __ATOMIC_RELAXED) || expired(worker))
+      break;
+    off_t offset = pick_offset(worker, &helper->rng, i % opts->block_count);
+    bool write = pick_write(opts, &helper->rng);
+    size_t count = transfer_size(opts, write);
+    void* data = half(opts, buffer, write);
+    uint64_t token = verify_begin(worker, data, count, offset, write);
+    uint64_t due = 0;
+    if (worker->gap_ns != 0) {
+      pthread_mutex_lock(&worker->lock);
+      due = next_due(worker);
+      pthread_mutex_unlock(&worker->lock);
+      wait_until(due);
+    }
+    uint64_t issued = now_ns();
+    ssize_t done = (write ? engine->write : engine->read)(worker->ctx, data, count, offset);
+    if (check_transfer(worker, done, count, i % opts->block_count) != 0) {
+      __atomic_store_n(&worker->failed, 1, __ATOMIC_RELAXED);
+      break;
+    }
+    account(worker, helper->stats, write, (uint64_t)done, due != 0 ? due : issued, 0, now_ns());
+    verify_end(worker, data, count, offset, write, token);
+  }
+  free(buffer);
+  return NULL;
+}
+
+static int run_pool(worker_t* worker) {
+  unsigned depth = worker->opts->iodepth;
+  helper_t* helpers = calloc(depth, sizeof(*helpers));
+  pthread_t* ids = calloc(depth, sizeof(*ids));
+  if (helpers == NULL || ids == NULL) {
+    fprintf(stderr, "calloc failed\n");
+    free(helpers);
+    free(ids);
+    return -1;
+  }
+
+  unsigned started = 0;
+  for (; started < depth; ++started) {
+    helper_t* helper = &helpers[started];
+    helper->worker = worker;
+    rng_seed(&helper->rng, rng_next(&worker->rng));
+    init_stats(helper->stats, 2);
+    int err = pthread_create(&ids[started], NULL, run_helper, helper);
+    if (err != 0) {
+      fprintf(stderr, "pthread_create failed: %s\n", strerror(err));
+      worker->failed = 1;
+      break;
+    }
+  }
+  for (unsigned i = 0; i < started; ++i) {
+    pthread_join(ids[i], NULL);
+    merge_stats(&worker->stats[0], &helpers[i].stats[0]);
+    merge_stats(&worker->stats[1], &helpers[i].stats[1]);
+  }
+
+  free(helpers);
+  free(ids);
+  return worker->failed ? -1 : 0;
+}
+
+// Keeps iodepth requests queued: every free slot is refilled and submitted
+// in one batch, then all completions that are ready are reaped at once.
+// Under --rate only due requests are queued, and completions are polled
+// while the next one is not due yet.
+static int run_queue(worker_t* worker) {
+  const options_t* opts = worker->opts;
+  const io_engine_t* engine = opts->engine;
+  unsigned depth = opts->iodepth;
+  void* queue = engine->queue_open(worker->ctx, depth);
+  io_request_t* requests = calloc(depth, sizeof(*requests));
+  io_request_t** free_list = calloc(depth, sizeof(*free_list));
+  io_request_t** batch = calloc(depth, sizeof(*batch));
+  unsigned char* buffers = alloc_buffers(opts, depth);
+  int result = (queue != NULL && requests != NULL && free_list != NULL && batch != NULL && buffers != NULL) ? 0 : -1;
+  if (queue == NULL)
+    fprintf(stderr, "Thread %d: failed to set up a queue: %s\n", worker->index, strerror(errno));
+
+  unsigned free_count = 0;
+  for (unsigned i = 0; result == 0 && i < depth; ++i)
+    free_list[free_count++] = &requests[i];
+
+  size_t total = opts->runtime > 0 ? SIZE_MAX : opts->block_count * (size_t)opts->repeat;
+  size_t issued = 0;
+  unsigned in_flight = 0;
+  uint64_t due = next_due(worker);
+  bool more = true;
+  while (result == 0 && (more || in_flight > 0)) {
+    unsigned count = 0;
+    uint64_t now = now_ns();
+    more = issued < total && !expired(worker);
+    while (more && free_count > 0 && issued < total && due <= now) {
+      io_request_t* request = free_list[--free_count];
+      unsigned char* pair = buffers + (size_t)(request - requests) * 2 * opts->block_size;
+      request->offset = pick_offset(worker, &worker->rng, issued++ % opts->block_count);
+      request->write = pick_write(opts, &worker->rng);
+      request->count = transfer_size(opts, request->write);
+      request->buffer = half(opts, pair, request->write);
+      request->token = verify_begin(worker, request->buffer, request->count, request->offset, request->write);
+      request->queued_ns = (due != 0) ? due : now;
+      batch[count++] = request;
+      if (due != 0)
+        due = next_due(worker);
+    }
+    if (count > 0) {
+      if (engine->submit(queue, batch, count) != 0) {
+        fprintf(stderr, "Thread %d: submit failed: %s\n", worker->index, strerror(errno));
+        result = -1;
+        break;
+      }
+      in_flight += count;
+      uint64_t submitted = now_ns();
+      for (unsigned i = 0; i < count; ++i)
+        batch[i]->submitted_ns = submitted;
+    }
+
+    bool waiting = more && free_count > 0 && issued < total && due > now;
+    if (in_flight == 0) {
+      if (waiting)
+        wait_until(due);
+      continue;
+    }
+    int done = engine->reap(queue, batch, depth, waiting ? 0 : 1);
+    if (done < 0) {
+      fprintf(stderr, "Thread %d: reap failed: %s\n", worker->index, strerror(errno));
+      result = -1;
+      break;
+    }
+    if (waiting && done == 0) {
+      // Completions are noticed at most this late.
+      uint64_t poll = now_ns() + 10000;
+      wait_until(due < poll ? due : poll);
+    }
+    in_flight -= (unsigned)done;
+    uint64_t reaped = now_ns();
+    for (int i = 0; i < done; ++i) {
+      io_request_t* request = batch[i];
+      errno = request->error;
+      size_t index = (size_t)((request->offset - worker->range_start) / (off_t)opts->block_size);
+      if (check_transfer(worker, request->result, request->count, index) != 0) {
+        result = -1;
+        break;
+      }
+      account(worker, worker->stats, request->write, (uint64_t)request->result, request->queued_ns,
+              request->submitted_ns - request->queued_ns, reaped);
+      verify_end(worker, request->buffer, request->count, request->offset, request->write, request->token);
+      free_list[free_count++] = request;
+    }
+  }
+
+  // Drain what is still in flight before the buffers go away.
+  while (result != 0 && in_flight > 0) {
+    int done = engine->reap(queue, batch, depth, 1);
+    if (done <= 0)
+      break;
+    in_flight -= (unsigned)done;
+  }
+  if (queue != NULL)
+    engine->queue_close(queue);
+  free(buffers);
+  free(requests);
+  free(free_list);
+  free(batch);
+  return result;
+}
+
+static void* run_worker(void* arg) {
+  worker_t* worker = arg;
+  const options_t* opts = worker->opts;
+  init_stats(worker->stats, 2);
+#if defined(PR_SET_TIMERSLACK)
+  // The default 50 us slack would outlast the spin in wait_until().
+  if (worker->gap_ns != 0 || opts->trace_timed)
+    prctl(PR_SET_TIMERSLACK, 1UL);
+#endif
+
+  worker->due_ns = (double)now_ns();
+  int result;
+  if (opts->trace != NULL)
+    result = run_trace(worker);
+  else if (opts->iodepth <= 1)
+    result = run_sync(worker);
+  else if (opts->engine->queue_open != NULL)
+    result = run_queue(worker);
+  else
+    result = run_pool(worker);
+  uint64_t end = now_ns();
+  double seconds = end > worker->measure_ns ? (double)(end - worker->measure_ns) / 1e9 : 0;
+  worker->stats[0].seconds = worker->stats[1].seconds = seconds;
+  if (result != 0)
+    worker->failed = 1;
+  __atomic_store_n(&worker->finished, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+// Prints a row for every --interval from the main thread while the workers
+// run; the last partial interval is left to the totals.
+static void report_intervals(const options_t* opts, worker_t* workers, int count, uint64_t start) {
+  uint64_t step = (uint64_t)(opts->interval * 1e9);
+  uint64_t last = start;
+  for (int n = 1;; ++n) {
+    uint64_t tick = start + (uint64_t)n * step;
+    for (;;) {
+      int running = 0;
+      for (int t = 0; t < count; ++t)
+        running += !__atomic_load_n(&workers[t].finished, __ATOMIC_ACQUIRE);
+      if (running == 0)
+        return;
+      uint64_t now = now_ns();
+      if (now >= tick)
+        break;
+      uint64_t poll = now + 10000000;
+      wait_until(tick < poll ? tick : poll);
+    }
+
+    io_stats_t total[2];
+    init_stats(total, 2);
+    for (int t = 0; t < count; ++t) {
+      pthread_mutex_lock(&workers[t].lock);
+      merge_stats(&total[0], &workers[t].interval[0]);
+      merge_stats(&total[1], &workers[t].interval[1]);
+      init_stats(workers[t].interval, 2);
+      pthread_mutex_unlock(&workers[t].lock);
+    }
+    uint64_t now = now_ns();
+    total[0].seconds = total[1].seconds = (double)(now - last) / 1e9;
+    last = now;
+    report_stats(opts, SCOPE_INTERVAL, n, total);
+  }
+}
+
+int run_workers(const options_t* opts, void* ctx, double* seconds) {
+  int threads = opts->threads;
+  worker_t* workers = calloc((size_t)threads, sizeof(*workers));
+  pthread_t* ids = calloc((size_t)threads, sizeof(*ids));
+  if (workers == NULL || ids == NULL) {
+    fprintf(stderr, "calloc failed\n");
+    free(workers);
+    free(ids);
+    return 1;
+  }
+
+  io_verify_t verify;
+  if (opts->verify && verify_init(&verify, opts) != 0) {
+    free(workers);
+    free(ids);
+    return 1;
+  }
+
+  uint64_t start = now_ns();
+  uint64_t measure = start + (uint64_t)(opts->ramp * 1e9);
+
+  // Disjoint workers get equal block-aligned slices of the range.
+  off_t range = opts->range_end - opts->range_start;
+  off_t slice = range / threads / (off_t)opts->block_size * (off_t)opts->block_size;
+  for (int t = 0; t < threads; ++t) {
+    worker_t* worker = &workers[t];
+    worker->opts = opts;
+    worker->ctx = ctx;
+    worker->index = t;
+    worker->verify = opts->verify ? &verify : NULL;
+    if (opts->trace != NULL) {
+      worker->trace_ops = &opts->trace->ops[opts->trace->starts[t]];
+      worker->trace_count = opts->trace->starts[t + 1] - opts->trace->starts[t];
+      worker->replay_ns = start;
+    }
+    rng_seed(&worker->rng, (uint64_t)t);
+    worker->gap_ns = (opts->rate > 0) ? 1e9 * threads / opts->rate : 0;
+    pthread_mutex_init(&worker->lock, NULL);
+    worker->measure_ns = measure;
+    worker->end_ns = opts->runtime > 0 ? measure + (uint64_t)(opts->runtime * 1e9) : 0;
+    init_stats(worker->interval, 2);
+    worker->range_start = opts->range_start;
+    worker->range_end = opts->range_end;
+    if (!opts->shared && threads > 1) {
+      worker->range_start = opts->range_start + slice * t;
+      worker->range_end = (t == threads - 1) ? opts->range_end : worker->range_start + slice;
+    }
+    uint64_t slots = (uint64_t)((worker->range_end - worker->range_start) / (off_t)opts->block_size);
+    sampler_init(&worker->sampler, &opts->dist, slots);
+  }
+
+  int result = 0;
+  int started = 0;
+  for (; started < threads; ++started) {
+    int err = pthread_create(&ids[started], NULL, run_worker, &workers[started]);
+    if (err != 0) {
+      fprintf(stderr, "pthread_create failed: %s\n", strerror(err));
+      result = 1;
+      break;
+    }
+  }
+  if (opts->interval > 0)
+    report_intervals(opts, workers, started, start);
+  for (int t = 0; t < started; ++t)
+    pthread_join(ids[t], NULL);
+  uint64_t end = now_ns();
+  *seconds = (double)(end - start) / 1e9;
+
+  io_stats_t total[2];
+  init_stats(total, 2);
+  total[0].seconds = total[1].seconds = end > measure ? (double)(end - measure) / 1e9 : 0;
+  for (int t = 0; t < started; ++t) {
+    const io_stats_t* stats = workers[t].stats;
+    if (workers[t].failed)
+      result = 1;
+    if (threads > 1)
+      report_stats(opts, SCOPE_THREAD, t, stats);
+    merge_stats(&total[0], &stats[0]);
+    merge_stats(&total[1], &stats[1]);
+  }
+  if (result == 0)
+    report_stats(opts, SCOPE_ALL, -1, total);
+  if (opts->trace != NULL && opts->trace->syncs > 0) {
+    size_t syncs = 0;
+    uint64_t sync_ns = 0;
+    for (int t = 0; t < started; ++t) {
+      syncs += workers[t].syncs;
+      sync_ns += workers[t].sync_ns;
+    }
+    FILE* out = opts->output == OUTPUT_TEXT ? stdout : stderr;
+    fprintf(out, "Syncs: %zu, latency avg=%.2f us\n", syncs, syncs > 0 ? (double)sync_ns / (double)syncs / 1e3 : 0);
+  }
+  if (opts->verify) {
+    FILE* out = opts->output == OUTPUT_TEXT ? stdout : stderr;
+    fprintf(out, "Verify: %llu mismatched blocks, crc32c in %s\n", (unsigned long long)verify.failed,
+            verify_hardware() ? "hardware" : "software");
+    if (verify.failed > 0)
+      result = 1;
+    verify_free(&verify);
+  }
+
+  for (int t = 0; t < threads; ++t)
+    pthread_mutex_destroy(&workers[t].lock);
+  free(workers);
+  free(ids);
+  return result;
+}
@@ -1,40 +1,194 @@
+#define _GNU_SOURCE
+
 #include "vtpc.h"
 
+#include <aio.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <time.h>
 #include <unistd.h>
 
+#include "vtpc_buddy.h"
+#include "vtpc_lz.h"
+#include "vtpc_spill.h"
+#include "vtpc_trace.h"
+
 #define VTPC_MAX_FILES 128
 #define VTPC_PAGE_CAPACITY 64
-
+#define VTPC_ZCACHE_MIN_BUCKETS 64
+#define VTPC_BATCH_PAGES 64
+#define VTPC_READAHEAD_PAGES 4
+#define VTPC_SEQ_READAHEAD_PAGES 32
+#define VTPC_HOTSET_MAGIC 0x32544f4850435456ULL  // "VTPCHOT2"
+#define VTPC_TRACE_BATCH 256
+#define VTPC_MONITOR_INTERVAL_NS 100000000ULL
+#define VTPC_MONITOR_MIN_PAGES 16
+#define VTPC_EXTENT_BYTES (1U << 20U)
+#define VTPC_RECENT_PAGES 64
+
+// A resident unit: one page, or an extent of 2^order pages filled and
+// evicted as a whole.
 struct vtpc_page {
   off_t base;
+  size_t len;
+  unsigned order;
   size_t valid;
   int dirty;
   int in_use;
+  int noreuse;
+  int pinned;
+  int referenced;
   uint64_t last_access;
+  uint64_t loaded;
+  struct aiocb* aio;
   char* data;
 };
 
+struct vtpc_zentry {
+  off_t base;
+  size_t valid;
+  size_t size;
+  struct vtpc_zentry* hash_next;
+  struct vtpc_zentry* newer;
+  struct vtpc_zentry* older;
+  unsigned char data[];
+};
+
+struct vtpc_zcache {
+  size_t limit;
+  size_t used;
+  size_t bucket_mask;
+  struct vtpc_zentry** buckets;
+  struct vtpc_zentry* newest;
+  struct vtpc_zentry* oldest;
+  unsigned char* scratch;
+};
+
+// A vtpc_map() window. Its pages stay pinned until it is unmapped.
+struct vtpc_mapping {
+  struct vtpc_mapping* next;
+  char* window;
+  size_t window_len;
+  int writable;
+  size_t count;
+  struct vtpc_page* pages[];
+};
+
+// The file as it was when the snapshot was taken, any change makes it stale.
+struct vtpc_hotset_header {
+  uint64_t magic;
+  uint64_t page_size;
+  uint64_t count;
+  uint64_t dev;
+  uint64_t ino;
+  int64_t size;
+  int64_t mtime_sec;
+  int64_t mtime_nsec;
+};
+
 struct vtpc_file {
   int fd;
   int can_read;
   int can_write;
   int direct_io;
+  int tail_fd;
+  int tail_checked;
+  int size_pending;
   off_t position;
   off_t file_size;
   size_t page_size;
+  unsigned page_shift;
   size_t capacity;
+  unsigned max_order;
   uint64_t access_clock;
+  int policy;
+  size_t clock_hand;
+  int pattern;
+  off_t last_miss;
+  off_t noreuse_start;
+  off_t noreuse_end;
   struct vtpc_page* pages;
+  // Last page used by read or write, and a direct-mapped table of recent
+  // lookups. Entries are checked against the slot on use, never invalidated.
+  struct vtpc_page* memo;
+  struct vtpc_page* recent[VTPC_RECENT_PAGES];
+  struct vtpc_buddy* arena;
+  struct aiocb* aiocbs;
+  struct vtpc_zcache zcache;
+  struct vtpc_spill* spill;
+  dev_t dev;
+  ino_t ino;
+  char* bounce;
+  char* hotset_path;
+  int handle;
+  int trace_fd;
+  size_t trace_len;
+  struct vtpc_trace_record* trace;
+  int syncing;
+  struct vtpc_mapping* mappings;
+  size_t mapped;
+  struct vtpc_stats stats;
 };
 
 static struct vtpc_file* g_files[VTPC_MAX_FILES];
 
+// Page buffers of all handles count against one budget: the limit set by
+// vtpc_set_memory_limit() and, with the monitor on, a lower one it derives
+// from cgroup or PSI pressure. 0 means unlimited.
+static size_t g_memory_limit;
+static size_t g_pressure_limit;
+static size_t g_memory_used;
+static int g_monitor;
+static uint64_t g_monitor_checked;
+static char g_cgroup_dir[PATH_MAX];
+
+// Every public entry point runs under g_lock. Group commit releases it only
+// while sleeping out the window and while waiting on the device.
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// With group commit on, vtpc_fsync() callers join the open group and the
+// first one to find no leader commits it for all of them: one write-back
+// pass, then one fsync per file, however many handles refer to it.
+static int g_group_commit;
+static unsigned g_group_window_us;
+static int g_group_leader;
+static uint64_t g_group_open = 1;
+static uint64_t g_group_done;
+static unsigned char g_group_members[VTPC_MAX_FILES];
+static pthread_cond_t g_group_cond = PTHREAD_COND_INITIALIZER;
+
+// Each waiting vtpc_fsync() call, on its own stack. The leader of its group
+// stores the result there before the group is marked done, so a later group
+// of the same handle cannot overwrite it.
+struct vtpc_group_waiter {
+  int fd;
+  uint64_t group;
+  int error;
+  struct vtpc_group_waiter* next;
+};
+static struct vtpc_group_waiter* g_group_waiters;
+
+static void vtpc_lock(void) {
+  pthread_mutex_lock(&g_lock);
+}
+
+static void vtpc_unlock(void) {
+  int err = errno;
+  pthread_mutex_unlock(&g_lock);
+  errno = err;
+}
+
 static size_t vtpc_get_page_size(void) {
   long page = sysconf(_SC_PAGESIZE);
   if (page <= 0)
@@ -43,6 +197,8 @@ static size_t vtpc_get_page_size(void) {
 }
 
 static off_t vtpc_align_down(off_t value, size_t align) {
+  if ((align & (align - 1)) == 0)
+    return value & ~(off_t)(align - 1);
   off_t mod = value % (off_t)align;
   if (mod < 0)
     mod += (off_t)align;
@@ -57,6 +213,79 @@ static size_t vtpc_max_size(size_t a, size_t b) {
   return (a > b) ? a : b;
 }
 
+static off_t vtpc_range_end(off_t offset, off_t len) {
+  if (len <= 0 || offset > INT64_MAX - len)
+    return INT64_MAX;
+  return offset + len;
+}
+
+static int vtpc_in_noreuse(const struct vtpc_file* file, off_t base) {
+  return base < file->noreuse_end && base + (off_t)file->page_size > file->noreuse_start;
+}
+
+static void vtpc_touch(struct vtpc_file* file, struct vtpc_page* page) {
+  page->last_access = ++file->access_clock;
+  page->referenced = 1;
+}
+
+static int vtpc_trace_open(struct vtpc_file* file, const char* path) {
+  file->trace = malloc(VTPC_TRACE_BATCH * sizeof(*file->trace));
+  if (file->trace == NULL)
+    return -1;
+
+  int fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd < 0)
+    return -1;
+
+  // Several handles may share one trace, only the first writes the header.
+  struct stat st;
+  int result = 0;
+  (void)flock(fd, LOCK_EX);
+  if (fstat(fd, &st) != 0) {
+    result = -1;
+  } else if (st.st_size == 0) {
+    struct vtpc_trace_header header = {VTPC_TRACE_MAGIC, sizeof(struct vtpc_trace_record), 0};
+    if (write(fd, &header, sizeof(header)) != (ssize_t)sizeof(header))
+      result = -1;
+  }
+  (void)flock(fd, LOCK_UN);
+
+  if (result != 0) {
+    close(fd);
+    return -1;
+  }
+  file->trace_fd = fd;
+  return 0;
+}
+
+static void vtpc_trace_flush(struct vtpc_file* file) {
+  if (file->trace_fd < 0 || file->trace_len == 0)
+    return;
+  // One append per batch keeps records of concurrent writers whole.
+  (void)write(file->trace_fd, file->trace, file->trace_len * sizeof(*file->trace));
+  file->trace_len = 0;
+}
+
+static void vtpc_trace_emit(struct vtpc_file* file, int op, off_t offset, size_t length) {
+  if (file->trace_fd < 0)
+    return;
+
+  struct timespec now;
+  (void)clock_gettime(CLOCK_MONOTONIC, &now);
+
+  struct vtpc_trace_record* record = &file->trace[file->trace_len++];
+  record->timestamp_ns = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+  record->offset = (uint64_t)offset;
+  record->length = (uint32_t)vtpc_min_size(length, UINT32_MAX);
+  record->op = (uint16_t)op;
+  record->file = (uint16_t)file->handle;
+  record->tid = (uint32_t)syscall(SYS_gettid);
+  record->reserved = 0;
+
+  if (file->trace_len == VTPC_TRACE_BATCH)
+    vtpc_trace_flush(file);
+}
+
 static struct vtpc_file* vtpc_lookup(int handle) {
   if (handle < 0 || handle >= VTPC_MAX_FILES)
     return NULL;
@@ -80,9 +309,11 @@ static void vtpc_drop(int fd) {
   g_files[fd] = NULL;
 }
 
-static int vtpc_open_raw(const char* path, int mode, int access, int* direct_io) {
+static int vtpc_open_raw(const char* path, int mode, int access, int direct, int* direct_io) {
   int fd = -1;
   *direct_io = 0;
+  if (direct == VTPC_DIRECT_OFF)
+    return open(path, mode, access);
 
 #ifdef O_DIRECT
   fd = open(path, mode | O_DIRECT, access);
@@ -103,35 +334,108 @@ static int vtpc_open_raw(const char* path, int mode, int access, int* direct_io)
     *direct_io = 1;
 #endif
 
+  if (direct == VTPC_DIRECT_ON && !*direct_io) {
+    close(fd);
+    errno = EINVAL;
+    return -1;
+  }
   return fd;
 }
 
+// Buffers come from a buddy arena of capacity pages. It is only committed on
+// first use and returned under memory pressure, so capacity is an upper bound
+// rather than a reservation.
 static int vtpc_alloc_pages(struct vtpc_file* file) {
   file->pages = calloc(file->capacity, sizeof(*file->pages));
   if (file->pages == NULL)
     return -1;
+  file->arena = vtpc_buddy_create(file->capacity, file->page_size, file->max_order);
+  return (file->arena != NULL) ? 0 : -1;
+}
 
-  for (size_t i = 0; i < file->capacity; ++i) {
-    if (posix_memalign((void**)&file->pages[i].data, file->page_size, file->page_size) != 0) {
-      for (size_t j = 0; j < i; ++j)
-        free(file->pages[j].data);
-      free(file->pages);
-      file->pages = NULL;
-      return -1;
-    }
-    memset(file->pages[i].data, 0, file->page_size);
-  }
+static int vtpc_page_alloc(struct vtpc_file* file, struct vtpc_page* page, unsigned order) {
+  page->data = vtpc_buddy_alloc(file->arena, order);
+  if (page->data == NULL)
+    return -1;
+  page->order = order;
+  page->len = file->page_size << order;
+  g_memory_used += page->len;
   return 0;
 }
 
+static void vtpc_page_release(struct vtpc_file* file, struct vtpc_page* page) {
+  if (page->data == NULL)
+    return;
+  vtpc_buddy_free(file->arena, page->data, page->order);
+  page->data = NULL;
+  page->in_use = 0;
+  g_memory_used -= page->len;
+}
+
+// Stores through a writable window are not seen by vtpc, so its pages count
+// as dirty whenever the handle writes back and when it is unmapped.
+static void vtpc_mappings_dirty(struct vtpc_file* file) {
+  for (struct vtpc_mapping* map = file->mappings; map != NULL; map = map->next) {
+    for (size_t i = 0; map->writable && i < map->count; ++i)
+      map->pages[i]->dirty = 1;
+  }
+}
+
+static void vtpc_mapping_release(struct vtpc_file* file, struct vtpc_mapping* map) {
+  for (size_t i = 0; i < map->count; ++i) {
+    if (map->writable)
+      map->pages[i]->dirty = 1;
+    map->pages[i]->pinned--;
+  }
+  file->mapped -= map->count;
+  (void)munmap(map->window, map->window_len);
+  free(map);
+}
+
+static size_t vtpc_memory_budget(void) {
+  if (g_memory_limit == 0 || (g_pressure_limit != 0 && g_pressure_limit < g_memory_limit))
+    return g_pressure_limit;
+  return g_memory_limit;
+}
+
+static int vtpc_page_covers(const struct vtpc_page* page, off_t base) {
+  return page->in_use && base >= page->base && base < page->base + (off_t)page->len;
+}
+
 static struct vtpc_page* vtpc_find_page(struct vtpc_file* file, off_t base) {
+  struct vtpc_page** recent = &file->recent[(size_t)(base >> file->page_shift) & (VTPC_RECENT_PAGES - 1)];
+  if (*recent != NULL && vtpc_page_covers(*recent, base))
+    return *recent;
+
   for (size_t i = 0; i < file->capacity; ++i) {
-    if (file->pages[i].in_use && file->pages[i].base == base)
-      return &file->pages[i];
+    struct vtpc_page* page = &file->pages[i];
+    if (vtpc_page_covers(page, base)) {
+      *recent = page;
+      return page;
+    }
   }
   return NULL;
 }
 
+static int vtpc_range_cached(const struct vtpc_file* file, off_t start, off_t end) {
+  for (size_t i = 0; i < file->capacity; ++i) {
+    const struct vtpc_page* page = &file->pages[i];
+    if (page->in_use && page->base < end && page->base + (off_t)page->len > start)
+      return 1;
+  }
+  return 0;
+}
+
+static int vtpc_tail_fd(struct vtpc_file* file) {
+  if (!file->tail_checked) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", file->fd);
+    file->tail_fd = open(path, O_WRONLY | O_CLOEXEC);
+    file->tail_checked = 1;
+  }
+  return file->tail_fd;
+}
+
 static int vtpc_flush_page(struct vtpc_file* file, struct vtpc_page* page) {
   if (!page->in_use || !page->dirty)
     return 0;
@@ -141,232 +445,1157 @@ static int vtpc_flush_page(struct vtpc_file* file, struct vtpc_page* page) {
     return 0;
   }
 
-  size_t len = (size_t)vtpc_min_size((size_t)(file->file_size - page->base), file->page_size);
+  size_t len = (size_t)vtpc_min_size((size_t)(file->file_size - page->base), page->len);
   if (len == 0) {
     page->dirty = 0;
     return 0;
   }
 
-  size_t write_len = len;
-  if (file->direct_io)
-    write_len = file->page_size;
-
-  ssize_t written = pwrite(file->fd, page->data, write_len, page->base);
-  if (written < 0 || (size_t)written != write_len)
-    return -1;
-
+  // A partial tail can't go through O_DIRECT, write it exactly through a
+  // buffered descriptor. Without one the whole page is written and the size
+  // is fixed once on the next fsync or close.
+  size_t direct_len = len;
+  size_t tail_len = 0;
+  int tail_fd = -1;
+  size_t partial = len % file->page_size;
+  if (file->direct_io && partial != 0) {
+    tail_fd = vtpc_tail_fd(file);
+    direct_len = len - partial;
+    if (tail_fd >= 0) {
+      tail_len = partial;
+    } else {
+      direct_len += file->page_size;
+      file->size_pending = 1;
+    }
+  }
 
-  if (write_len > len && ftruncate(file->fd, file->file_size) != 0)
-    return -1;
+  if (direct_len > 0) {
+    ssize_t written = pwrite(file->fd, page->data, direct_len, page->base);
+    if (written < 0 || (size_t)written != direct_len)
+      return -1;
+  }
+  if (tail_len > 0) {
+    ssize_t written = pwrite(tail_fd, page->data + direct_len, tail_len, page->base + (off_t)direct_len);
+    if (written < 0 || (size_t)written != tail_len)
+      return -1;
+  }
 
   page->dirty = 0;
   return 0;
 }
 
-static struct vtpc_page* vtpc_pick_victim(struct vtpc_file* file) {
-  struct vtpc_page* victim = NULL;
-  for (size_t i = 0; i < file->capacity; ++i) {
-    if (!file->pages[i].in_use)
-      continue;
-    if (victim == NULL || file->pages[i].last_access > victim->last_access)
-      victim = &file->pages[i];
+// Frees page buffers of all handles until at most target bytes are in use:
+// idle buffers first, then clean pages, then dirty ones after writeback.
+// skip is left alone, it evicts into its own buffers instead.
+static int vtpc_reclaim(size_t target, const struct vtpc_file* skip, int dirty) {
+  for (int phase = 0; phase < (dirty ? 3 : 2); ++phase) {
+    for (int f = 0; f < VTPC_MAX_FILES; ++f) {
+      struct vtpc_file* file = g_files[f];
+      if (file == NULL || file == skip)
+        continue;
+      for (size_t i = 0; i < file->capacity; ++i) {
+        if (g_memory_used <= target)
+          return 0;
+        struct vtpc_page* page = &file->pages[i];
+        if (page->data == NULL || page->pinned || (phase == 0 && page->in_use))
+          continue;
+        if (page->dirty && page->in_use) {
+          if (phase < 2)
+            continue;
+          if (vtpc_flush_page(file, page) != 0)
+            return -1;
+        }
+        if (page->in_use)
+          file->stats.reclaimed_pages += page->len / file->page_size;
+        vtpc_page_release(file, page);
+      }
+    }
   }
-  return victim;
+  return 0;
 }
 
-static struct vtpc_page* vtpc_prepare_page(struct vtpc_file* file, off_t base) {
-  struct vtpc_page* page = vtpc_find_page(file, base);
-  if (page != NULL)
-    return page;
+static int vtpc_read_text(const char* path, char* buf, size_t size) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return -1;
+  ssize_t len = read(fd, buf, size - 1);
+  close(fd);
+  if (len <= 0)
+    return -1;
+  buf[len] = '\0';
+  return 0;
+}
 
-  for (size_t i = 0; i < file->capacity; ++i) {
-    if (!file->pages[i].in_use) {
-      page = &file->pages[i];
-      break;
+// 1 under pressure, 0 when there is room to grow, -1 in between or unknown.
+// cgroup v2 limits are used when set, PSI otherwise.
+static int vtpc_memory_pressure(void) {
+  char path[PATH_MAX + 32];
+  char text[256];
+  if (g_cgroup_dir[0] != '\0') {
+    snprintf(path, sizeof(path), "%s/memory.max", g_cgroup_dir);
+    if (vtpc_read_text(path, text, sizeof(text)) == 0 && strncmp(text, "max", 3) != 0) {
+      unsigned long long max = strtoull(text, NULL, 10);
+      snprintf(path, sizeof(path), "%s/memory.current", g_cgroup_dir);
+      if (max != 0 && vtpc_read_text(path, text, sizeof(text)) == 0) {
+        unsigned long long current = strtoull(text, NULL, 10);
+        unsigned long long headroom = (current < max) ? max - current : 0;
+        if (headroom < max / 10)
+          return 1;
+        return (headroom > max / 4) ? 0 : -1;
+      }
     }
   }
 
-  if (page == NULL) {
-    page = vtpc_pick_victim(file);
-    if (page == NULL) {
-      errno = ENOMEM;
-      return NULL;
-    }
-    if (vtpc_flush_page(file, page) != 0)
-      return NULL;
-  }
+  if (vtpc_read_text("/proc/pressure/memory", text, sizeof(text)) != 0)
+    return -1;
+  const char* avg = strstr(text, "avg10=");
+  if (avg == NULL)
+    return -1;
+  double stall = strtod(avg + 6, NULL);
+  if (stall >= 10.0)
+    return 1;
+  return (stall < 1.0) ? 0 : -1;
+}
 
-  page->in_use = 1;
-  page->base = base;
-  page->valid = 0;
-  page->dirty = 0;
-  page->last_access = 0;
+static void vtpc_monitor_poll(size_t page_size) {
+  if (!g_monitor)
+    return;
 
-  ssize_t done = pread(file->fd, page->data, file->page_size, page->base);
-  if (done < 0) {
-    page->in_use = 0;
-    return NULL;
+  struct timespec now;
+  (void)clock_gettime(CLOCK_MONOTONIC, &now);
+  uint64_t ns = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+  if (ns - g_monitor_checked < VTPC_MONITOR_INTERVAL_NS)
+    return;
+  g_monitor_checked = ns;
+
+  int pressure = vtpc_memory_pressure();
+  size_t floor = VTPC_MONITOR_MIN_PAGES * page_size;
+  if (pressure == 1) {
+    g_pressure_limit = vtpc_max_size(g_memory_used / 2, floor);
+    (void)vtpc_reclaim(g_pressure_limit, NULL, 1);
+  } else if (pressure == 0 && g_pressure_limit != 0) {
+    // Grow back in steps, and lift the cap once it no longer binds.
+    g_pressure_limit *= 2;
+    if (g_memory_used < g_pressure_limit / 4)
+      g_pressure_limit = 0;
   }
-#if defined(POSIX_FADV_DONTNEED)
-  (void)posix_fadvise(file->fd, page->base, (off_t)file->page_size, POSIX_FADV_DONTNEED);
-#endif
-
-  page->valid = (size_t)done;
-  if (page->valid < file->page_size)
-    memset(page->data + page->valid, 0, file->page_size - page->valid);
+}
 
-  return page;
+// Makes room for a buffer of len bytes for file, taking idle and clean pages
+// of other handles if needed.
+static int vtpc_memory_reserve(struct vtpc_file* file, size_t len) {
+  size_t budget = vtpc_memory_budget();
+  if (budget == 0 || g_memory_used + len <= budget)
+    return 1;
+  if (budget < len)
+    return 0;
+  (void)vtpc_reclaim(budget - len, file, 0);
+  return g_memory_used + len <= budget;
 }
 
-static int vtpc_flush_all(struct vtpc_file* file) {
-  int has_dirty = 0;
-  for (size_t i = 0; i < file->capacity; ++i) {
-    if (file->pages[i].in_use && file->pages[i].dirty) {
-      has_dirty = 1;
-      if (vtpc_flush_page(file, &file->pages[i]) != 0)
-        return -1;
-    }
-  }
+static void vtpc_spill_init(struct vtpc_file* file, const struct vtpc_options* opts, const struct stat* st) {
+  if (opts->spill_path == NULL || opts->spill_bytes == 0)
+    return;
 
-  if (has_dirty && file->can_write) {
-    if (ftruncate(file->fd, file->file_size) != 0)
-      return -1;
-  }
+  file->spill = vtpc_spill_acquire(opts->spill_path, file->page_size, opts->spill_bytes);
+  if (file->spill == NULL)
+    return;
 
-  if (fsync(file->fd) != 0)
-    return -1;
+  if (vtpc_spill_page_size(file->spill) != file->page_size ||
+      posix_memalign((void**)&file->bounce, file->page_size, file->page_size) != 0) {
+    vtpc_spill_release(file->spill);
+    file->spill = NULL;
+    file->bounce = NULL;
+    return;
+  }
 
-  return 0;
+  vtpc_spill_validate(file->spill, st);
 }
 
-int vtpc_open(const char* path, int mode, int access) {
-  size_t page_size = vtpc_get_page_size();
+static void vtpc_spill_put(struct vtpc_file* file, off_t base, const char* data, size_t valid) {
+  if (file->spill == NULL || valid == 0)
+    return;
 
-  struct vtpc_file* file = calloc(1, sizeof(*file));
-  if (file == NULL)
-    return -1;
+  uint64_t page_no = (uint64_t)(base / (off_t)file->page_size);
+  if (vtpc_spill_store(file->spill, file->dev, file->ino, page_no, data, valid) == 0)
+    file->stats.spill_stores++;
+}
 
-  file->page_size = page_size;
-  file->capacity = VTPC_PAGE_CAPACITY;
+static int vtpc_spill_get(struct vtpc_file* file, struct vtpc_page* page) {
+  if (file->spill == NULL)
+    return 0;
 
-  int accmode = mode & O_ACCMODE;
+  uint64_t page_no = (uint64_t)(page->base / (off_t)file->page_size);
+  if (!vtpc_spill_load(file->spill, file->dev, file->ino, page_no, page->data, &page->valid))
+    return 0;
 
-  int direct_io = 0;
-  int fd = -1;
+  file->stats.spill_hits++;
+  return 1;
+}
 
-  if (accmode == O_WRONLY) {
-    int rw_mode = (mode & ~O_ACCMODE) | O_RDWR;
-    fd = vtpc_open_raw(path, rw_mode, access, &direct_io);
-  }
+static void vtpc_spill_close(struct vtpc_file* file) {
+  if (file->spill == NULL)
+    return;
 
-  if (fd < 0)
-    fd = vtpc_open_raw(path, mode, access, &direct_io);
+  struct stat st;
+  if (fstat(file->fd, &st) == 0)
+    vtpc_spill_commit(file->spill, &st);
+  vtpc_spill_release(file->spill);
+  file->spill = NULL;
+}
 
-  if (fd < 0) {
-    free(file);
-    return -1;
-  }
+static int vtpc_zcache_init(struct vtpc_file* file, size_t limit) {
+  struct vtpc_zcache* zc = &file->zcache;
+  if (limit == 0)
+    return 0;
 
-  struct stat st;
-  if (fstat(fd, &st) != 0) {
-    close(fd);
-    free(file);
+  size_t buckets = VTPC_ZCACHE_MIN_BUCKETS;
+  while (buckets < limit / (file->page_size / 4))
+    buckets <<= 1;
+
+  zc->buckets = calloc(buckets, sizeof(*zc->buckets));
+  zc->scratch = malloc(file->page_size);
+  if (zc->buckets == NULL || zc->scratch == NULL) {
+    free(zc->buckets);
+    free(zc->scratch);
+    zc->buckets = NULL;
+    zc->scratch = NULL;
     return -1;
   }
 
-  file->fd = fd;
-  file->file_size = st.st_size;
-  file->position = 0;
-  file->direct_io = direct_io;
-  file->access_clock = 0;
+  zc->limit = limit;
+  zc->bucket_mask = buckets - 1;
+  return 0;
+}
 
-  file->can_read = (accmode == O_RDONLY || accmode == O_RDWR);
-  file->can_write = (accmode == O_WRONLY || accmode == O_RDWR);
+static struct vtpc_zentry** vtpc_zcache_slot(struct vtpc_file* file, off_t base) {
+  struct vtpc_zcache* zc = &file->zcache;
+  size_t bucket = (size_t)(base / (off_t)file->page_size) & zc->bucket_mask;
+  struct vtpc_zentry** slot = &zc->buckets[bucket];
+  while (*slot != NULL && (*slot)->base != base)
+    slot = &(*slot)->hash_next;
+  return slot;
+}
 
-  if (vtpc_alloc_pages(file) != 0) {
-    close(fd);
-    free(file);
-    errno = ENOMEM;
-    return -1;
-  }
+static void vtpc_zcache_remove(struct vtpc_file* file, struct vtpc_zentry** slot) {
+  struct vtpc_zcache* zc = &file->zcache;
+  struct vtpc_zentry* entry = *slot;
+  *slot = entry->hash_next;
+
+  if (entry->newer != NULL)
+    entry->newer->older = entry->older;
+  else
+    zc->newest = entry->older;
+  if (entry->older != NULL)
+    entry->older->newer = entry->newer;
+  else
+    zc->oldest = entry->newer;
+
+  zc->used -= sizeof(*entry) + entry->size;
+  free(entry);
+}
 
-  int handle = vtpc_store(file);
-  if (handle < 0) {
-    for (size_t i = 0; i < file->capacity; ++i)
-      free(file->pages[i].data);
-    free(file->pages);
-    close(fd);
-    free(file);
-    return -1;
+static void vtpc_zcache_demote(struct vtpc_file* file) {
+  struct vtpc_zentry* oldest = file->zcache.oldest;
+  if (file->spill != NULL &&
+      vtpc_lz_decompress(oldest->data, oldest->size, file->bounce, oldest->valid) == 0) {
+    memset(file->bounce + oldest->valid, 0, file->page_size - oldest->valid);
+    vtpc_spill_put(file, oldest->base, file->bounce, oldest->valid);
   }
-
-  return handle;
+  vtpc_zcache_remove(file, vtpc_zcache_slot(file, oldest->base));
 }
 
-int vtpc_close(int fd) {
-  struct vtpc_file* file = vtpc_lookup(fd);
-  if (file == NULL) {
-    errno = EBADF;
-    return -1;
+static int vtpc_zcache_store(struct vtpc_file* file, const struct vtpc_page* page) {
+  struct vtpc_zcache* zc = &file->zcache;
+  if (zc->limit == 0 || page->valid == 0)
+    return 0;
+
+  size_t budget = page->valid - page->valid / 8;
+  size_t size = vtpc_lz_compress(page->data, page->valid, zc->scratch, budget);
+  if (size == 0 || sizeof(struct vtpc_zentry) + size > zc->limit) {
+    file->stats.zcache_rejects++;
+    return 0;
   }
 
-  int result = 0;
-  if (vtpc_flush_all(file) != 0)
-    result = -1;
+  struct vtpc_zentry** slot = vtpc_zcache_slot(file, page->base);
+  if (*slot != NULL)
+    vtpc_zcache_remove(file, slot);
 
-  if (close(file->fd) != 0)
-    result = -1;
+  while (zc->used + sizeof(struct vtpc_zentry) + size > zc->limit)
+    vtpc_zcache_demote(file);
 
-  for (size_t i = 0; i < file->capacity; ++i)
-    free(file->pages[i].data);
-  free(file->pages);
-  free(file);
-  vtpc_drop(fd);
-  return result;
+  struct vtpc_zentry* entry = malloc(sizeof(*entry) + size);
+  if (entry == NULL)
+    return 0;
+
+  entry->base = page->base;
+  entry->valid = page->valid;
+  entry->size = size;
+  memcpy(entry->data, zc->scratch, size);
+
+  slot = vtpc_zcache_slot(file, page->base);
+  entry->hash_next = NULL;
+  *slot = entry;
+
+  entry->newer = NULL;
+  entry->older = zc->newest;
+  if (zc->newest != NULL)
+    zc->newest->newer = entry;
+  else
+    zc->oldest = entry;
+  zc->newest = entry;
+
+  zc->used += sizeof(*entry) + size;
+  file->stats.zcache_stores++;
+  return 1;
 }
 
-ssize_t vtpc_read(int fd, void* buf, size_t count) {
-  struct vtpc_file* file = vtpc_lookup(fd);
-  if (file == NULL) {
-    errno = EBADF;
-    return -1;
-  }
-  if (!file->can_read) {
-    errno = EBADF;
-    return -1;
-  }
-  if (count == 0)
+static int vtpc_zcache_load(struct vtpc_file* file, struct vtpc_page* page) {
+  if (file->zcache.limit == 0)
     return 0;
 
-  size_t total = 0;
-  while (total < count) {
-    if (file->position >= file->file_size)
-      break;
+  struct vtpc_zentry** slot = vtpc_zcache_slot(file, page->base);
+  struct vtpc_zentry* entry = *slot;
+  if (entry == NULL)
+    return 0;
 
-    off_t base = vtpc_align_down(file->position, file->page_size);
-    size_t page_off = (size_t)(file->position - base);
-    size_t max_in_page = file->page_size - page_off;
+  int loaded = (vtpc_lz_decompress(entry->data, entry->size, page->data, entry->valid) == 0);
+  if (loaded) {
+    page->valid = entry->valid;
+    file->stats.zcache_hits++;
+  }
+  vtpc_zcache_remove(file, slot);
+  return loaded;
+}
 
-    size_t remaining = count - total;
-    size_t available = vtpc_min_size((size_t)(file->file_size - file->position), max_in_page);
-    size_t chunk = vtpc_min_size(remaining, available);
+static void vtpc_zcache_free(struct vtpc_file* file) {
+  struct vtpc_zcache* zc = &file->zcache;
+  while (zc->oldest != NULL)
+    vtpc_zcache_remove(file, vtpc_zcache_slot(file, zc->oldest->base));
+  free(zc->buckets);
+  free(zc->scratch);
+  memset(zc, 0, sizeof(*zc));
+}
 
-    if (chunk == 0)
-      break;
+static void vtpc_tier_forget(struct vtpc_file* file, off_t base, size_t len) {
+  if (file->zcache.limit == 0 && file->spill == NULL)
+    return;
+  for (off_t at = base; at < base + (off_t)len; at += (off_t)file->page_size) {
+    if (file->zcache.limit != 0) {
+      struct vtpc_zentry** slot = vtpc_zcache_slot(file, at);
+      if (*slot != NULL)
+        vtpc_zcache_remove(file, slot);
+    }
+    if (file->spill != NULL)
+      vtpc_spill_forget(file->spill, file->dev, file->ino, (uint64_t)(at / (off_t)file->page_size));
+  }
+}
 
-    struct vtpc_page* page = vtpc_prepare_page(file, base);
-    if (page == NULL)
-      return -1;
+static int vtpc_fill_run(struct vtpc_file* file, struct vtpc_page** run, size_t count) {
+  struct iovec iov[VTPC_BATCH_PAGES];
+  size_t total = 0;
+  for (size_t i = 0; i < count; ++i) {
+    iov[i].iov_base = run[i]->data;
+    iov[i].iov_len = run[i]->len;
+    total += run[i]->len;
+  }
+
+  ssize_t done = preadv(file->fd, iov, (int)count, run[0]->base);
+  if (done < 0)
+    return -1;
+#if defined(POSIX_FADV_DONTNEED)
+  if (!file->direct_io)
+    (void)posix_fadvise(file->fd, run[0]->base, (off_t)total, POSIX_FADV_DONTNEED);
+#endif
+
+  size_t skip = 0;
+  for (size_t i = 0; i < count; ++i) {
+    struct vtpc_page* page = run[i];
+    page->valid = ((size_t)done > skip) ? vtpc_min_size((size_t)done - skip, page->len) : 0;
+    if (page->valid < page->len)
+      memset(page->data + page->valid, 0, page->len - page->valid);
+    page->in_use = 1;
+    page->dirty = 0;
+    page->referenced = 0;
+    page->loaded = ++file->access_clock;
+    page->noreuse = vtpc_in_noreuse(file, page->base);
+    vtpc_tier_forget(file, page->base, page->len);
+    skip += page->len;
+  }
+  return 0;
+}
+
+static int vtpc_page_settle(struct vtpc_page* page) {
+  if (page->aio == NULL)
+    return 0;
+
+  const struct aiocb* list[1] = {page->aio};
+  while (aio_error(page->aio) == EINPROGRESS)
+    (void)aio_suspend(list, 1, NULL);
+  ssize_t done = aio_return(page->aio);
+  page->aio = NULL;
+  page->pinned--;
+
+  if (done < 0) {
+    page->in_use = 0;
+    return -1;
+  }
+  page->valid = (size_t)done;
+  if (page->valid < page->len)
+    memset(page->data + page->valid, 0, page->len - page->valid);
+  return 0;
+}
+
+static int vtpc_policy_prefers(int policy, const struct vtpc_page* page, const struct vtpc_page* victim) {
+  switch (policy) {
+    case VTPC_POLICY_LRU:
+    case VTPC_POLICY_CLOCK:
+      return page->last_access < victim->last_access;
+    case VTPC_POLICY_FIFO:
+      return page->loaded < victim->loaded;
+    default:
+      return page->last_access > victim->last_access;
+  }
+}
+
+static struct vtpc_page* vtpc_clock_sweep(struct vtpc_file* file) {
+  // Two turns of the hand are enough: the first clears every reference bit.
+  for (size_t step = 0; step < 2 * file->capacity; ++step) {
+    struct vtpc_page* page = &file->pages[file->clock_hand];
+    file->clock_hand = (file->clock_hand + 1) % file->capacity;
+    if (!page->in_use || page->pinned)
+      continue;
+    if (!page->referenced)
+      return page;
+    page->referenced = 0;
+  }
+  return NULL;
+}
+
+static struct vtpc_page* vtpc_pick_victim(struct vtpc_file* file) {
+  struct vtpc_page* victim = NULL;
+  off_t behind = vtpc_align_down(file->position, file->page_size);
+  for (size_t i = 0; i < file->capacity; ++i) {
+    struct vtpc_page* page = &file->pages[i];
+    if (!page->in_use || page->pinned)
+      continue;
+    if (victim == NULL) {
+      victim = page;
+      continue;
+    }
+
+    // Pages the caller asked not to keep go first, then for sequential
+    // handles the page furthest behind the cursor, then the policy's pick.
+    if (page->noreuse != victim->noreuse) {
+      if (page->noreuse)
+        victim = page;
+      continue;
+    }
+    if (file->pattern == VTPC_FADV_SEQUENTIAL) {
+      int page_behind = page->base < behind;
+      int victim_behind = victim->base < behind;
+      if (page_behind != victim_behind) {
+        if (page_behind)
+          victim = page;
+        continue;
+      }
+      if (page_behind) {
+        if (page->base < victim->base)
+          victim = page;
+        continue;
+      }
+    }
+    if (vtpc_policy_prefers(file->policy, page, victim))
+      victim = page;
+  }
+
+  if (victim != NULL && file->policy == VTPC_POLICY_CLOCK && !victim->noreuse &&
+      !(file->pattern == VTPC_FADV_SEQUENTIAL && victim->base < behind)) {
+    struct vtpc_page* hand = vtpc_clock_sweep(file);
+    if (hand != NULL)
+      victim = hand;
+  }
+  return victim;
+}
+
+static int vtpc_evict(struct vtpc_file* file, struct vtpc_page* page) {
+  if (vtpc_flush_page(file, page) != 0)
+    return -1;
+
+  // Extents are large sequential data, not worth a secondary tier.
+  file->stats.evictions++;
+  if (page->order == 0 && !page->noreuse && !vtpc_zcache_store(file, page))
+    vtpc_spill_put(file, page->base, page->data, page->valid);
+  page->in_use = 0;
+  return 0;
+}
+
+// Returns a slot with a free buffer of 2^order pages. Idle buffers of
+// another size go back to the arena, then victims are evicted until a block
+// fits. Over budget the handle recycles its own pages; one that has none
+// left still gets a buffer so it can make progress.
+static struct vtpc_page* vtpc_claim_page(struct vtpc_file* file, unsigned order) {
+  vtpc_monitor_poll(file->page_size);
+  size_t len = file->page_size << order;
+
+  struct vtpc_page* empty = NULL;
+  for (size_t i = 0; i < file->capacity; ++i) {
+    struct vtpc_page* page = &file->pages[i];
+    if (page->in_use || page->pinned)
+      continue;
+    if (page->data != NULL && page->order == order)
+      return page;
+    vtpc_page_release(file, page);
+    if (empty == NULL)
+      empty = page;
+  }
+
+  for (;;) {
+    if (empty != NULL && vtpc_memory_reserve(file, len) && vtpc_page_alloc(file, empty, order) == 0)
+      return empty;
+
+    struct vtpc_page* page = vtpc_pick_victim(file);
+    if (page == NULL)
+      break;
+    if (vtpc_evict(file, page) != 0)
+      return NULL;
+    if (page->order == order)
+      return page;
+    vtpc_page_release(file, page);
+    if (empty == NULL)
+      empty = page;
+  }
+
+  if (empty != NULL && vtpc_page_alloc(file, empty, order) == 0)
+    return empty;
+  errno = ENOMEM;
+  return NULL;
+}
+
+static size_t vtpc_readahead_window(const struct vtpc_file* file, off_t base) {
+  int streak = (base == file->last_miss + (off_t)file->page_size);
+  if (file->pattern == VTPC_FADV_SEQUENTIAL)
+    return vtpc_min_size(VTPC_SEQ_READAHEAD_PAGES, vtpc_max_size(file->capacity / 2, 1));
+  if (file->pattern == VTPC_FADV_NORMAL && streak)
+    return vtpc_min_size(VTPC_READAHEAD_PAGES, vtpc_max_size(file->capacity / 4, 1));
+  return 1;
+}
+
+// Reads covering whole aligned extents are cached as one unit, as long as
+// no part of the extent is resident already.
+static unsigned vtpc_extent_order(const struct vtpc_file* file, off_t base, size_t want) {
+  unsigned order = 0;
+  while (order < file->max_order) {
+    size_t len = file->page_size << (order + 1);
+    if (want < len || base % (off_t)len != 0)
+      break;
+    ++order;
+  }
+
+  size_t budget = vtpc_memory_budget();
+  while (order > 0 && ((budget != 0 && (file->page_size << order) > budget / 4) ||
+                       vtpc_range_cached(file, base, base + (off_t)(file->page_size << order))))
+    --order;
+  return order;
+}
+
+static struct vtpc_page* vtpc_fill_extent(struct vtpc_file* file, off_t base, unsigned order) {
+  struct vtpc_page* page = vtpc_claim_page(file, order);
+  if (page == NULL)
+    return NULL;
+
+  page->base = base;
+  page->valid = 0;
+  page->dirty = 0;
+  page->last_access = 0;
+  page->pinned++;
+  int result = vtpc_fill_run(file, &page, 1);
+  page->pinned--;
+  if (result != 0)
+    return NULL;
+
+  file->last_miss = base + (off_t)(page->len - file->page_size);
+  file->stats.extent_fills++;
+  return page;
+}
+
+// want is how many bytes from base the caller is about to read, 0 for writes.
+static struct vtpc_page* vtpc_prepare_page(struct vtpc_file* file, off_t base, size_t want) {
+  struct vtpc_page* page = vtpc_find_page(file, base);
+  if (page != NULL && vtpc_page_settle(page) == 0) {
+    file->stats.hits++;
+    return page;
+  }
+  file->stats.misses++;
+
+  unsigned order = vtpc_extent_order(file, base, want);
+  if (order > 0 && (page = vtpc_fill_extent(file, base, order)) != NULL)
+    return page;
+
+  page = vtpc_claim_page(file, 0);
+  if (page == NULL)
+    return NULL;
+
+  page->base = base;
+  page->valid = 0;
+  page->dirty = 0;
+  page->last_access = 0;
+  page->noreuse = vtpc_in_noreuse(file, base);
+
+  if (vtpc_zcache_load(file, page) || vtpc_spill_get(file, page)) {
+    page->in_use = 1;
+    page->referenced = 0;
+    page->loaded = ++file->access_clock;
+    if (page->valid < page->len)
+      memset(page->data + page->valid, 0, page->len - page->valid);
+    return page;
+  }
+
+  struct vtpc_page* run[VTPC_BATCH_PAGES];
+  size_t window = vtpc_readahead_window(file, base);
+  size_t count = 1;
+  run[0] = page;
+  page->pinned++;
+  while (count < window) {
+    off_t next = base + (off_t)(count * file->page_size);
+    if (next >= file->file_size || vtpc_find_page(file, next) != NULL)
+      break;
+    struct vtpc_page* ahead = vtpc_claim_page(file, 0);
+    if (ahead == NULL)
+      break;
+    ahead->base = next;
+    ahead->last_access = 0;
+    ahead->pinned++;
+    run[count++] = ahead;
+  }
+
+  int result = vtpc_fill_run(file, run, count);
+  for (size_t i = 0; i < count; ++i)
+    run[i]->pinned--;
+  if (result != 0)
+    return NULL;
+
+  file->last_miss = run[count - 1]->base;
+  file->stats.readahead_pages += count - 1;
+  return page;
+}
+
+static int vtpc_write_back(struct vtpc_file* file) {
+  vtpc_mappings_dirty(file);
+  for (size_t i = 0; i < file->capacity; ++i) {
+    if (file->pages[i].in_use && file->pages[i].dirty) {
+      if (vtpc_flush_page(file, &file->pages[i]) != 0)
+        return -1;
+    }
+  }
+
+  if (file->size_pending) {
+    if (ftruncate(file->fd, file->file_size) != 0)
+      return -1;
+    file->size_pending = 0;
+  }
+  return 0;
+}
+
+static int vtpc_flush_all(struct vtpc_file* file) {
+  if (vtpc_write_back(file) != 0)
+    return -1;
+
+  file->stats.device_syncs++;
+  if (fsync(file->fd) != 0)
+    return -1;
+
+  return 0;
+}
+
+// Commits the open group, called with g_lock held by a member that found no
+// leader.
+static void vtpc_group_commit(void) {
+  g_group_leader = 1;
+  if (g_group_window_us != 0) {
+    struct timespec window = {
+        .tv_sec = g_group_window_us / 1000000,
+        .tv_nsec = (long)(g_group_window_us % 1000000) * 1000,
+    };
+    pthread_mutex_unlock(&g_lock);
+    (void)nanosleep(&window, NULL);
+    pthread_mutex_lock(&g_lock);
+  }
+
+  uint64_t group = g_group_open++;
+  struct vtpc_file* files[VTPC_MAX_FILES];
+  int written[VTPC_MAX_FILES];
+  int errors[VTPC_MAX_FILES];
+  unsigned char synced[VTPC_MAX_FILES];
+  size_t count = 0;
+  for (int i = 0; i < VTPC_MAX_FILES; ++i) {
+    if (!g_group_members[i])
+      continue;
+    g_group_members[i] = 0;
+    written[count] = (vtpc_write_back(g_files[i]) == 0) ? 0 : errno;
+    g_files[i]->syncing = 1;
+    files[count++] = g_files[i];
+  }
+
+  // Handles of one file share its fsync. Other threads may use the cache
+  // meanwhile, vtpc_close() waits for syncing handles.
+  pthread_mutex_unlock(&g_lock);
+  for (size_t i = 0; i < count; ++i) {
+    size_t first = 0;
+    while (files[first]->dev != files[i]->dev || files[first]->ino != files[i]->ino)
+      ++first;
+    synced[i] = (first == i);
+    if (first < i)
+      errors[i] = errors[first];
+    else
+      errors[i] = (fsync(files[i]->fd) == 0) ? 0 : errno;
+  }
+  pthread_mutex_lock(&g_lock);
+
+  for (size_t i = 0; i < count; ++i) {
+    if (synced[i])
+      files[i]->stats.device_syncs++;
+    files[i]->syncing = 0;
+  }
+
+  // Waiters whose handle was closed meanwhile already hold EBADF.
+  struct vtpc_group_waiter** link = &g_group_waiters;
+  while (*link != NULL) {
+    struct vtpc_group_waiter* waiter = *link;
+    if (waiter->group != group) {
+      link = &waiter->next;
+      continue;
+    }
+    for (size_t i = 0; i < count && waiter->error == 0; ++i) {
+      if (files[i]->handle == waiter->fd)
+        waiter->error = (written[i] != 0) ? written[i] : errors[i];
+    }
+    *link = waiter->next;
+  }
+
+  g_group_done = group;
+  g_group_leader = 0;
+  pthread_cond_broadcast(&g_group_cond);
+}
+
+static int vtpc_cmp_recency(const void* lhs, const void* rhs) {
+  const struct vtpc_page* a = *(struct vtpc_page* const*)lhs;
+  const struct vtpc_page* b = *(struct vtpc_page* const*)rhs;
+  return (a->last_access < b->last_access) - (a->last_access > b->last_access);
+}
+
+struct vtpc_hotset_entry {
+  uint64_t page_no;
+  uint64_t rank;
+};
+
+static int vtpc_cmp_hotset(const void* lhs, const void* rhs) {
+  const struct vtpc_hotset_entry* a = lhs;
+  const struct vtpc_hotset_entry* b = rhs;
+  if (a->page_no != b->page_no)
+    return (a->page_no > b->page_no) - (a->page_no < b->page_no);
+  return (a->rank > b->rank) - (a->rank < b->rank);
+}
+
+static int vtpc_write_all(int fd, const void* buf, size_t len) {
+  size_t done = 0;
+  while (done < len) {
+    ssize_t put = write(fd, (const char*)buf + done, len - done);
+    if (put <= 0)
+      return -1;
+    done += (size_t)put;
+  }
+  return 0;
+}
+
+static int vtpc_save_hotset_file(struct vtpc_file* file, const char* path) {
+  struct stat st;
+  if (fstat(file->fd, &st) != 0)
+    return -1;
+
+  struct vtpc_page** resident = malloc(file->capacity * sizeof(*resident));
+  uint64_t* pages = malloc(file->capacity * sizeof(*pages));
+  size_t tmp_len = strlen(path) + sizeof(".tmp");
+  char* tmp = malloc(tmp_len);
+  if (resident == NULL || pages == NULL || tmp == NULL) {
+    free(resident);
+    free(pages);
+    free(tmp);
+    errno = ENOMEM;
+    return -1;
+  }
+
+  size_t slots = 0;
+  for (size_t i = 0; i < file->capacity; ++i) {
+    if (file->pages[i].in_use)
+      resident[slots++] = &file->pages[i];
+  }
+  qsort(resident, slots, sizeof(*resident), vtpc_cmp_recency);
+
+  // The arena holds at most capacity pages, extents included.
+  size_t count = 0;
+  for (size_t i = 0; i < slots; ++i) {
+    for (size_t off = 0; off < resident[i]->len && count < file->capacity; off += file->page_size)
+      pages[count++] = (uint64_t)((resident[i]->base + (off_t)off) / (off_t)file->page_size);
+  }
+
+  struct vtpc_hotset_header header = {
+      .magic = VTPC_HOTSET_MAGIC,
+      .page_size = file->page_size,
+      .count = count,
+      .dev = (uint64_t)st.st_dev,
+      .ino = (uint64_t)st.st_ino,
+      .size = (int64_t)st.st_size,
+      .mtime_sec = (int64_t)st.st_mtim.tv_sec,
+      .mtime_nsec = (int64_t)st.st_mtim.tv_nsec,
+  };
+
+  snprintf(tmp, tmp_len, "%s.tmp", path);
+  int result = -1;
+  int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd >= 0) {
+    if (vtpc_write_all(fd, &header, sizeof(header)) == 0 &&
+        vtpc_write_all(fd, pages, count * sizeof(*pages)) == 0 && close(fd) == 0)
+      result = rename(tmp, path);
+    else
+      close(fd);
+    if (result != 0)
+      (void)unlink(tmp);
+  }
+
+  free(resident);
+  free(pages);
+  free(tmp);
+  return result;
+}
+
+static void vtpc_load_hotset(struct vtpc_file* file, const char* path, const struct stat* st) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return;
+
+  struct vtpc_hotset_header header;
+  if (read(fd, &header, sizeof(header)) != (ssize_t)sizeof(header) || header.magic != VTPC_HOTSET_MAGIC ||
+      header.page_size != file->page_size || header.dev != (uint64_t)st->st_dev ||
+      header.ino != (uint64_t)st->st_ino || header.size != (int64_t)st->st_size ||
+      header.mtime_sec != (int64_t)st->st_mtim.tv_sec || header.mtime_nsec != (int64_t)st->st_mtim.tv_nsec) {
+    close(fd);
+    return;
+  }
+
+  size_t count = vtpc_min_size(header.count, file->capacity);
+  uint64_t* pages = malloc(count * sizeof(*pages));
+  struct vtpc_hotset_entry* entries = malloc(count * sizeof(*entries));
+  ssize_t bytes = (ssize_t)(count * sizeof(*pages));
+  if (pages == NULL || entries == NULL || read(fd, pages, (size_t)bytes) != bytes) {
+    free(pages);
+    free(entries);
+    close(fd);
+    return;
+  }
+  close(fd);
+
+  // The file lists pages most recent first, prefetch them in offset order.
+  for (size_t i = 0; i < count; ++i) {
+    entries[i].page_no = pages[i];
+    entries[i].rank = i;
+  }
+  qsort(entries, count, sizeof(*entries), vtpc_cmp_hotset);
+
+  size_t slots = 0;
+  for (size_t i = 0; i < count; ++i) {
+    off_t base = (off_t)(entries[i].page_no * file->page_size);
+    if (base >= file->file_size || (i > 0 && entries[i].page_no == entries[i - 1].page_no))
+      continue;
+    if (!vtpc_memory_reserve(file, file->page_size) || vtpc_page_alloc(file, &file->pages[slots], 0) != 0)
+      break;
+    file->pages[slots].base = base;
+    file->pages[slots].last_access = count - entries[i].rank;
+    ++slots;
+  }
+  file->access_clock = count;
+
+  size_t start = 0;
+  while (start < slots) {
+    struct vtpc_page* run[VTPC_BATCH_PAGES];
+    size_t len = 0;
+    while (start + len < slots && len < VTPC_BATCH_PAGES &&
+           file->pages[start + len].base == file->pages[start].base + (off_t)(len * file->page_size)) {
+      run[len] = &file->pages[start + len];
+      ++len;
+    }
+    if (vtpc_fill_run(file, run, len) == 0)
+      file->stats.hotset_pages += len;
+    start += len;
+  }
+
+  free(pages);
+  free(entries);
+}
+
+static void vtpc_free_file(struct vtpc_file* file) {
+  if (file->pages != NULL) {
+    for (size_t i = 0; i < file->capacity; ++i) {
+      (void)vtpc_page_settle(&file->pages[i]);
+      vtpc_page_release(file, &file->pages[i]);
+    }
+    free(file->pages);
+  }
+  vtpc_buddy_destroy(file->arena);
+  free(file->aiocbs);
+  vtpc_zcache_free(file);
+  vtpc_spill_close(file);
+  free(file->bounce);
+  free(file->hotset_path);
+  if (file->trace_fd >= 0)
+    close(file->trace_fd);
+  if (file->tail_fd >= 0)
+    close(file->tail_fd);
+  free(file->trace);
+  free(file);
+}
+
+void vtpc_options_init(struct vtpc_options* opts) {
+  memset(opts, 0, sizeof(*opts));
+  opts->capacity = VTPC_PAGE_CAPACITY;
+}
+
+int vtpc_open(const char* path, int mode, int access) {
+  return vtpc_open_ex(path, mode, access, NULL);
+}
+
+static int vtpc_do_open_ex(const char* path, int mode, int access, const struct vtpc_options* opts) {
+  struct vtpc_options defaults;
+  if (opts == NULL) {
+    vtpc_options_init(&defaults);
+    opts = &defaults;
+  }
+
+  size_t page_size = vtpc_get_page_size();
+  if (opts->page_size != 0) {
+    if (opts->page_size < page_size || (opts->page_size & (opts->page_size - 1)) != 0) {
+      errno = EINVAL;
+      return -1;
+    }
+    page_size = opts->page_size;
+  }
+
+  struct vtpc_file* file = calloc(1, sizeof(*file));
+  if (file == NULL)
+    return -1;
+
+  file->page_size = page_size;
+  while (((size_t)1 << file->page_shift) < page_size)
+    file->page_shift++;
+  file->capacity = (opts->capacity != 0) ? opts->capacity : VTPC_PAGE_CAPACITY;
+  file->policy = opts->policy;
+
+  // Extents stay below a quarter of the cache so one can't flush it all.
+  size_t extent = (opts->extent_bytes != 0) ? opts->extent_bytes : VTPC_EXTENT_BYTES;
+  while (file->max_order < VTPC_BUDDY_MAX_ORDER && (page_size << (file->max_order + 1)) <= extent &&
+         ((size_t)2 << file->max_order) <= file->capacity / 4)
+    file->max_order++;
+  file->trace_fd = -1;
+  file->tail_fd = -1;
+
+  int accmode = mode & O_ACCMODE;
+
+  int direct_io = 0;
+  int fd = -1;
+
+  if (accmode == O_WRONLY) {
+    int rw_mode = (mode & ~O_ACCMODE) | O_RDWR;
+    fd = vtpc_open_raw(path, rw_mode, access, opts->direct, &direct_io);
+  }
+
+  if (fd < 0)
+    fd = vtpc_open_raw(path, mode, access, opts->direct, &direct_io);
+
+  if (fd < 0) {
+    free(file);
+    return -1;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    free(file);
+    return -1;
+  }
+
+  file->fd = fd;
+  file->dev = st.st_dev;
+  file->ino = st.st_ino;
+  file->file_size = st.st_size;
+  file->position = 0;
+  file->direct_io = direct_io;
+  file->access_clock = 0;
+  file->pattern = VTPC_FADV_NORMAL;
+  file->last_miss = -1;
+
+  file->can_read = (accmode == O_RDONLY || accmode == O_RDWR);
+  file->can_write = (accmode == O_WRONLY || accmode == O_RDWR);
+
+  vtpc_spill_init(file, opts, &st);
+
+  if (vtpc_alloc_pages(file) != 0 || vtpc_zcache_init(file, opts->zcache_bytes) != 0) {
+    close(fd);
+    vtpc_free_file(file);
+    errno = ENOMEM;
+    return -1;
+  }
+
+  if (opts->trace_path != NULL && vtpc_trace_open(file, opts->trace_path) != 0) {
+    int saved = errno;
+    close(fd);
+    vtpc_free_file(file);
+    errno = saved;
+    return -1;
+  }
+
+  if (opts->hotset_path != NULL) {
+    if (opts->hotset_autosave && (file->hotset_path = strdup(opts->hotset_path)) == NULL) {
+      close(fd);
+      vtpc_free_file(file);
+      errno = ENOMEM;
+      return -1;
+    }
+    vtpc_load_hotset(file, opts->hotset_path, &st);
+  }
+
+  int handle = vtpc_store(file);
+  if (handle < 0) {
+    close(fd);
+    vtpc_free_file(file);
+    return -1;
+  }
+  file->handle = handle;
+
+  return handle;
+}
+
+int vtpc_open_ex(const char* path, int mode, int access, const struct vtpc_options* opts) {
+  vtpc_lock();
+  int result = vtpc_do_open_ex(path, mode, access, opts);
+  vtpc_unlock();
+  return result;
+}
+
+static int vtpc_do_close(int fd) {
+  struct vtpc_file* file = vtpc_lookup(fd);
+  while (file != NULL && file->syncing) {
+    pthread_cond_wait(&g_group_cond, &g_lock);
+    file = vtpc_lookup(fd);
+  }
+  if (file == NULL) {
+    errno = EBADF;
+    return -1;
+  }
+
+  while (file->mappings != NULL) {
+    struct vtpc_mapping* map = file->mappings;
+    file->mappings = map->next;
+    vtpc_mapping_release(file, map);
+  }
+
+  // A member still waiting for its group gets EBADF.
+  if (g_group_members[fd]) {
+    g_group_members[fd] = 0;
+    for (struct vtpc_group_waiter* waiter = g_group_waiters; waiter != NULL; waiter = waiter->next) {
+      if (waiter->fd == fd && waiter->group == g_group_open)
+        waiter->error = EBADF;
+    }
+  }
+
+  for (size_t i = 0; i < file->capacity; ++i)
+    (void)vtpc_page_settle(&file->pages[i]);
+
+  int result = 0;
+  if (vtpc_flush_all(file) != 0)
+    result = -1;
+
+  if (file->hotset_path != NULL && vtpc_save_hotset_file(file, file->hotset_path) != 0)
+    result = -1;
+
+  if (file->spill != NULL) {
+    while (file->zcache.oldest != NULL)
+      vtpc_zcache_demote(file);
+    vtpc_spill_close(file);
+  }
+
+  if (close(file->fd) != 0)
+    result = -1;
+
+  vtpc_trace_flush(file);
+  vtpc_free_file(file);
+  vtpc_drop(fd);
+  return result;
+}
+
+int vtpc_close(int fd) {
+  vtpc_lock();
+  int result = vtpc_do_close(fd);
+  vtpc_unlock();
+  return result;
+}
+
+static ssize_t vtpc_do_read(int fd, void* buf, size_t count) {
+  struct vtpc_file* file = vtpc_lookup(fd);
+  if (file == NULL) {
+    errno = EBADF;
+    return -1;
+  }
+  if (!file->can_read) {
+    errno = EBADF;
+    return -1;
+  }
+  if (count == 0)
+    return 0;
+
+  vtpc_trace_emit(file, VTPC_TRACE_READ, file->position, count);
+
+  // Fast path: the whole read is inside the valid part of the last page.
+  struct vtpc_page* memo = file->memo;
+  if (memo != NULL && memo->in_use && memo->aio == NULL && file->position >= memo->base &&
+      (size_t)(file->position - memo->base) + count <= memo->valid) {
+    memcpy(buf, memo->data + (file->position - memo->base), count);
+    file->position += (off_t)count;
+    file->stats.hits++;
+    vtpc_touch(file, memo);
+    return (ssize_t)count;
+  }
+
+  size_t total = 0;
+  while (total < count) {
+    if (file->position >= file->file_size)
+      break;
+
+    off_t base = vtpc_align_down(file->position, file->page_size);
+    size_t remaining = count - total;
+    size_t want = vtpc_min_size(remaining + (size_t)(file->position - base), (size_t)(file->file_size - base));
+
+    struct vtpc_page* page = vtpc_prepare_page(file, base, want);
+    if (page == NULL)
+      return -1;
 
-    page->last_access = ++file->access_clock;
+    vtpc_touch(file, page);
+    file->memo = page;
+
+    size_t page_off = (size_t)(file->position - page->base);
+    size_t available = vtpc_min_size((size_t)(file->file_size - file->position), page->len - page_off);
+    size_t chunk = vtpc_min_size(remaining, available);
 
+    // Bytes past what the file held when the page was filled, but below a
+    // size grown by cached writes further on, are a hole and read as zeros.
+    size_t copied = chunk;
     if (page->valid < page_off + chunk)
-      chunk = (page->valid > page_off) ? (page->valid - page_off) : 0;
+      copied = (page->valid > page_off) ? (page->valid - page_off) : 0;
 
     if (chunk == 0)
       break;
 
-    memcpy((char*)buf + total, page->data + page_off, chunk);
+    memcpy((char*)buf + total, page->data + page_off, copied);
+    memset((char*)buf + total + copied, 0, chunk - copied);
     total += chunk;
     file->position += (off_t)chunk;
   }
@@ -374,7 +1603,14 @@ ssize_t vtpc_read(int fd, void* buf, size_t count) {
   return (ssize_t)total;
 }
 
-ssize_t vtpc_write(int fd, const void* buf, size_t count) {
+ssize_t vtpc_read(int fd, void* buf, size_t count) {
+  vtpc_lock();
+  ssize_t result = vtpc_do_read(fd, buf, count);
+  vtpc_unlock();
+  return result;
+}
+
+static ssize_t vtpc_do_write(int fd, const void* buf, size_t count) {
   struct vtpc_file* file = vtpc_lookup(fd);
   if (file == NULL) {
     errno = EBADF;
@@ -387,26 +1623,28 @@ ssize_t vtpc_write(int fd, const void* buf, size_t count) {
   if (count == 0)
     return 0;
 
+  vtpc_trace_emit(file, VTPC_TRACE_WRITE, file->position, count);
+
   size_t total = 0;
   while (total < count) {
     off_t base = vtpc_align_down(file->position, file->page_size);
-    size_t page_off = (size_t)(file->position - base);
-    size_t remaining = count - total;
-    size_t chunk = vtpc_min_size(remaining, file->page_size - page_off);
-
-    struct vtpc_page* page = vtpc_prepare_page(file, base);
+    struct vtpc_page* page = vtpc_prepare_page(file, base, 0);
     if (page == NULL)
       return -1;
+    file->memo = page;
+
+    size_t page_off = (size_t)(file->position - page->base);
+    size_t chunk = vtpc_min_size(count - total, page->len - page_off);
 
     memcpy(page->data + page_off, (const char*)buf + total, chunk);
-    page->valid = vtpc_min_size(file->page_size, vtpc_max_size(page->valid, page_off + chunk));
+    page->valid = vtpc_min_size(page->len, vtpc_max_size(page->valid, page_off + chunk));
     page->dirty = 1;
-    page->last_access = ++file->access_clock;
+    vtpc_touch(file, page);
 
     total += chunk;
     file->position += (off_t)chunk;
 
-    off_t new_end = base + (off_t)vtpc_max_size(page->valid, page_off + chunk);
+    off_t new_end = page->base + (off_t)vtpc_max_size(page->valid, page_off + chunk);
     if (new_end > file->file_size)
       file->file_size = new_end;
   }
@@ -414,7 +1652,64 @@ ssize_t vtpc_write(int fd, const void* buf, size_t count) {
   return (ssize_t)total;
 }
 
-off_t vtpc_lseek(int fd, off_t offset, int whence) {
+ssize_t vtpc_write(int fd, const void* buf, size_t count) {
+  vtpc_lock();
+  ssize_t result = vtpc_do_write(fd, buf, count);
+  vtpc_unlock();
+  return result;
+}
+
+static ssize_t vtpc_do_pread(int fd, void* buf, size_t count, off_t offset) {
+  struct vtpc_file* file = vtpc_lookup(fd);
+  if (file == NULL) {
+    errno = EBADF;
+    return -1;
+  }
+  if (offset < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  off_t position = file->position;
+  file->position = offset;
+  ssize_t done = vtpc_do_read(fd, buf, count);
+  file->position = position;
+  return done;
+}
+
+ssize_t vtpc_pread(int fd, void* buf, size_t count, off_t offset) {
+  vtpc_lock();
+  ssize_t result = vtpc_do_pread(fd, buf, count, offset);
+  vtpc_unlock();
+  return result;
+}
+
+static ssize_t vtpc_do_pwrite(int fd, const void* buf, size_t count, off_t offset) {
+  struct vtpc_file* file = vtpc_lookup(fd);
+  if (file == NULL) {
+    errno = EBADF;
+    return -1;
+  }
+  if (offset < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  off_t position = file->position;
+  file->position = offset;
+  ssize_t done = vtpc_do_write(fd, buf, count);
+  file->position = position;
+  return done;
+}
+
+ssize_t vtpc_pwrite(int fd, const void* buf, size_t count, off_t offset) {
+  vtpc_lock();
+  ssize_t result = vtpc_do_pwrite(fd, buf, count, offset);
+  vtpc_unlock();
+  return result;
+}
+
+static off_t vtpc_do_lseek(int fd, off_t offset, int whence) {
   struct vtpc_file* file = vtpc_lookup(fd);
   if (file == NULL) {
     errno = EBADF;
@@ -442,12 +1737,384 @@ off_t vtpc_lseek(int fd, off_t offset, int whence) {
   return base;
 }
 
+off_t vtpc_lseek(int fd, off_t offset, int whence) {
+  vtpc_lock();
+  off_t result = vtpc_do_lseek(fd, offset, whence);
+  vtpc_unlock();
+  return result;
+}
+
+static int vtpc_do_fsync(int fd) {
+  struct vtpc_file* file = vtpc_lookup(fd);
+  if (file == NULL) {
+    errno = EBADF;
+    return -1;
+  }
+
+  vtpc_trace_emit(file, VTPC_TRACE_FSYNC, 0, 0);
+  vtpc_trace_flush(file);
+  if (!g_group_commit)
+    return vtpc_flush_all(file);
+
+  struct vtpc_group_waiter self = {
+      .fd = fd,
+      .group = g_group_open,
+      .error = 0,
+      .next = g_group_waiters,
+  };
+  g_group_waiters = &self;
+  g_group_members[fd] = 1;
+  while (g_group_done < self.group) {
+    if (g_group_leader)
+      pthread_cond_wait(&g_group_cond, &g_lock);
+    else
+      vtpc_group_commit();
+  }
+
+  if (self.error != 0) {
+    errno = self.error;
+    return -1;
+  }
+  return 0;
+}
+
 int vtpc_fsync(int fd) {
+  vtpc_lock();
+  int result = vtpc_do_fsync(fd);
+  vtpc_unlock();
+  return result;
+}
+
+static void vtpc_prefetch_async(struct vtpc_file* file, off_t start, off_t end) {
+  if (file->aiocbs == NULL) {
+    file->aiocbs = calloc(file->capacity, sizeof(*file->aiocbs));
+    if (file->aiocbs == NULL)
+      return;
+  }
+
+  size_t budget = vtpc_max_size(file->capacity / 2, 1);
+  if (end > file->file_size)
+    end = file->file_size;
+
+  for (off_t base = vtpc_align_down(start, file->page_size); base < end && budget > 0;
+       base += (off_t)file->page_size) {
+    if (vtpc_find_page(file, base) != NULL)
+      continue;
+
+    struct vtpc_page* page = vtpc_claim_page(file, 0);
+    if (page == NULL)
+      break;
+
+    page->base = base;
+    page->valid = 0;
+    page->dirty = 0;
+    page->last_access = 0;
+    page->noreuse = vtpc_in_noreuse(file, base);
+    vtpc_tier_forget(file, base, page->len);
+
+    struct aiocb* cb = &file->aiocbs[page - file->pages];
+    memset(cb, 0, sizeof(*cb));
+    cb->aio_fildes = file->fd;
+    cb->aio_offset = base;
+    cb->aio_buf = page->data;
+    cb->aio_nbytes = file->page_size;
+    cb->aio_sigevent.sigev_notify = SIGEV_NONE;
+
+    if (aio_read(cb) != 0) {
+      (void)vtpc_fill_run(file, &page, 1);
+      continue;
+    }
+
+    page->in_use = 1;
+    page->referenced = 0;
+    page->loaded = ++file->access_clock;
+    page->pinned++;
+    page->aio = cb;
+    file->stats.willneed_pages++;
+    --budget;
+  }
+}
+
+static int vtpc_drop_range(struct vtpc_file* file, off_t start, off_t end) {
+  for (size_t i = 0; i < file->capacity; ++i) {
+    struct vtpc_page* page = &file->pages[i];
+    if (!page->in_use || page->base + (off_t)page->len <= start || page->base >= end)
+      continue;
+    (void)vtpc_page_settle(page);
+    if (!page->in_use || page->pinned)
+      continue;
+    if (vtpc_flush_page(file, page) != 0)
+      return -1;
+    vtpc_page_release(file, page);
+    file->stats.dropped_pages++;
+  }
+
+  struct vtpc_zentry* entry = file->zcache.oldest;
+  while (entry != NULL) {
+    struct vtpc_zentry* newer = entry->newer;
+    if (entry->base + (off_t)file->page_size > start && entry->base < end)
+      vtpc_zcache_remove(file, vtpc_zcache_slot(file, entry->base));
+    entry = newer;
+  }
+
+  if (file->spill != NULL) {
+    off_t last = (end < file->file_size) ? end : file->file_size;
+    for (off_t at = vtpc_align_down(start, file->page_size); at < last; at += (off_t)file->page_size)
+      vtpc_spill_forget(file->spill, file->dev, file->ino, (uint64_t)(at / (off_t)file->page_size));
+  }
+
+#if defined(POSIX_FADV_DONTNEED)
+  if (!file->direct_io)
+    (void)posix_fadvise(file->fd, start, (end == INT64_MAX) ? 0 : end - start, POSIX_FADV_DONTNEED);
+#endif
+  return 0;
+}
+
+static int vtpc_do_fadvise(int fd, off_t offset, off_t len, int advice) {
+  struct vtpc_file* file = vtpc_lookup(fd);
+  if (file == NULL) {
+    errno = EBADF;
+    return -1;
+  }
+  if (offset < 0 || len < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  off_t end = vtpc_range_end(offset, len);
+  if (advice == VTPC_FADV_NORMAL || advice == VTPC_FADV_SEQUENTIAL || advice == VTPC_FADV_RANDOM) {
+    file->pattern = advice;
+    if (advice == VTPC_FADV_NORMAL)
+      file->noreuse_start = file->noreuse_end = 0;
+  } else if (advice == VTPC_FADV_WILLNEED) {
+    vtpc_prefetch_async(file, offset, end);
+  } else if (advice == VTPC_FADV_DONTNEED) {
+    return vtpc_drop_range(file, offset, end);
+  } else if (advice == VTPC_FADV_NOREUSE) {
+    file->noreuse_start = offset;
+    file->noreuse_end = end;
+    for (size_t i = 0; i < file->capacity; ++i) {
+      if (file->pages[i].in_use)
+        file->pages[i].noreuse = vtpc_in_noreuse(file, file->pages[i].base);
+    }
+  } else {
+    errno = EINVAL;
+    return -1;
+  }
+  return 0;
+}
+
+int vtpc_fadvise(int fd, off_t offset, off_t len, int advice) {
+  vtpc_lock();
+  int result = vtpc_do_fadvise(fd, offset, len, advice);
+  vtpc_unlock();
+  return result;
+}
+
+static int vtpc_do_save_hotset(int fd, const char* path) {
+  struct vtpc_file* file = vtpc_lookup(fd);
+  if (file == NULL) {
+    errno = EBADF;
+    return -1;
+  }
+
+  // Pages written back after the snapshot would make it stale.
+  if (vtpc_flush_all(file) != 0)
+    return -1;
+  return vtpc_save_hotset_file(file, path);
+}
+
+int vtpc_save_hotset(int fd, const char* path) {
+  vtpc_lock();
+  int result = vtpc_do_save_hotset(fd, path);
+  vtpc_unlock();
+  return result;
+}
+
+static int vtpc_do_get_stats(int fd, struct vtpc_stats* stats) {
+  struct vtpc_file* file = vtpc_lookup(fd);
+  if (file == NULL) {
+    errno = EBADF;
+    return -1;
+  }
+
+  *stats = file->stats;
+  stats->zcache_used = file->zcache.used;
+  return 0;
+}
+
+int vtpc_get_stats(int fd, struct vtpc_stats* stats) {
+  vtpc_lock();
+  int result = vtpc_do_get_stats(fd, stats);
+  vtpc_unlock();
+  return result;
+}
+
+// Fills the window page by page from the cache, pinning each page and
+// mapping its memfd range in place of the reservation.
+static int vtpc_map_pages(struct vtpc_file* file, struct vtpc_mapping* map, off_t first, int prot) {
+  off_t end = first + (off_t)map->window_len;
+  for (off_t at = first; at < end;) {
+    struct vtpc_page* page = vtpc_prepare_page(file, at, (size_t)(end - at));
+    if (page == NULL)
+      return -1;
+    page->pinned++;
+    map->pages[map->count++] = page;
+    file->mapped++;
+    vtpc_touch(file, page);
+
+    off_t stop = page->base + (off_t)page->len;
+    if (stop > end)
+      stop = end;
+    off_t source = vtpc_buddy_offset(file->arena, page->data) + (at - page->base);
+    if (mmap(map->window + (at - first), (size_t)(stop - at), prot, MAP_SHARED | MAP_FIXED,
+             vtpc_buddy_fd(file->arena), source) == MAP_FAILED)
+      return -1;
+    at = stop;
+  }
+  return 0;
+}
+
+static void* vtpc_do_map(int fd, off_t offset, size_t len, int prot) {
+  struct vtpc_file* file = vtpc_lookup(fd);
+  if (file == NULL) {
+    errno = EBADF;
+    return NULL;
+  }
+  int writable = (prot & PROT_WRITE) != 0;
+  if (!file->can_read || (writable && !file->can_write)) {
+    errno = EACCES;
+    return NULL;
+  }
+  if (len == 0 || offset < 0 || offset > file->file_size || (off_t)len > file->file_size - offset) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if (vtpc_buddy_fd(file->arena) < 0) {
+    errno = ENODEV;
+    return NULL;
+  }
+
+  // Leave at least one slot unpinned for ordinary I/O.
+  off_t first = vtpc_align_down(offset, file->page_size);
+  off_t end = vtpc_align_down(offset + (off_t)len + (off_t)file->page_size - 1, file->page_size);
+  size_t slots = (size_t)(end - first) >> file->page_shift;
+  if (file->mapped + slots >= file->capacity) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  struct vtpc_mapping* map = calloc(1, sizeof(*map) + slots * sizeof(map->pages[0]));
+  if (map == NULL)
+    return NULL;
+  map->window_len = (size_t)(end - first);
+  map->window = mmap(NULL, map->window_len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (map->window == MAP_FAILED) {
+    free(map);
+    return NULL;
+  }
+
+  if (vtpc_map_pages(file, map, first, prot & (PROT_READ | PROT_WRITE)) != 0) {
+    vtpc_mapping_release(file, map);
+    return NULL;
+  }
+
+  map->writable = writable;
+  map->next = file->mappings;
+  file->mappings = map;
+  return map->window + (offset - first);
+}
+
+void* vtpc_map(int fd, off_t offset, size_t len, int prot) {
+  vtpc_lock();
+  void* result = vtpc_do_map(fd, offset, len, prot);
+  vtpc_unlock();
+  return result;
+}
+
+static int vtpc_do_unmap(int fd, void* addr) {
   struct vtpc_file* file = vtpc_lookup(fd);
   if (file == NULL) {
     errno = EBADF;
     return -1;
   }
 
-  return vtpc_flush_all(file);
+  for (struct vtpc_mapping** link = &file->mappings; *link != NULL; link = &(*link)->next) {
+    struct vtpc_mapping* map = *link;
+    if ((char*)addr >= map->window && (char*)addr < map->window + map->window_len) {
+      *link = map->next;
+      vtpc_mapping_release(file, map);
+      return 0;
+    }
+  }
+  errno = EINVAL;
+  return -1;
+}
+
+int vtpc_unmap(int fd, void* addr) {
+  vtpc_lock();
+  int result = vtpc_do_unmap(fd, addr);
+  vtpc_unlock();
+  return result;
+}
+
+static int vtpc_do_set_memory_limit(size_t bytes) {
+  g_memory_limit = bytes;
+  size_t budget = vtpc_memory_budget();
+  if (budget == 0 || g_memory_used <= budget)
+    return 0;
+  return vtpc_reclaim(budget, NULL, 1);
+}
+
+int vtpc_set_memory_limit(size_t bytes) {
+  vtpc_lock();
+  int result = vtpc_do_set_memory_limit(bytes);
+  vtpc_unlock();
+  return result;
+}
+
+static int vtpc_do_set_memory_monitor(int enabled) {
+  g_monitor = enabled;
+  g_pressure_limit = 0;
+  g_cgroup_dir[0] = '\0';
+  if (!enabled)
+    return 0;
+
+  // cgroup v2 has a single "0::<path>" line.
+  char text[PATH_MAX];
+  if (vtpc_read_text("/proc/self/cgroup", text, sizeof(text)) == 0) {
+    char* line = strstr(text, "0::");
+    if (line != NULL && (line == text || line[-1] == '\n')) {
+      line += 3;
+      line[strcspn(line, "\n")] = '\0';
+      snprintf(g_cgroup_dir, sizeof(g_cgroup_dir), "/sys/fs/cgroup%s", line);
+    }
+  }
+  return 0;
+}
+
+int vtpc_set_memory_monitor(int enabled) {
+  vtpc_lock();
+  int result = vtpc_do_set_memory_monitor(enabled);
+  vtpc_unlock();
+  return result;
+}
+
+static size_t vtpc_do_get_memory_usage(void) {
+  return g_memory_used;
+}
+
+size_t vtpc_get_memory_usage(void) {
+  vtpc_lock();
+  size_t result = vtpc_do_get_memory_usage();
+  vtpc_unlock();
+  return result;
+}
+
+int vtpc_set_group_commit(int enabled, unsigned window_us) {
+  vtpc_lock();
+  g_group_commit = enabled;
+  g_group_window_us = window_us;
+  vtpc_unlock();
+  return 0;
 }
@@ -1,10 +1,124 @@
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
 #include <sys/types.h>
 
+// Access-pattern hints for vtpc_fadvise(). NORMAL, SEQUENTIAL and RANDOM
+// apply to the whole handle, the rest to the given range (len 0 is to EOF).
+enum {
+  VTPC_FADV_NORMAL,
+  VTPC_FADV_SEQUENTIAL,
+  VTPC_FADV_RANDOM,
+  VTPC_FADV_WILLNEED,
+  VTPC_FADV_DONTNEED,
+  VTPC_FADV_NOREUSE,
+};
+
+// Replacement policy for resident pages. Hints from vtpc_fadvise() still take
+// precedence: NOREUSE pages go first, SEQUENTIAL handles drop pages behind
+// the cursor.
+enum {
+  VTPC_POLICY_MRU,
+  VTPC_POLICY_LRU,
+  VTPC_POLICY_FIFO,
+  VTPC_POLICY_CLOCK,
+};
+
+// How the file itself is opened. AUTO uses O_DIRECT (F_NOCACHE on macOS)
+// where the file system allows it and the kernel page cache otherwise, ON
+// fails with EINVAL instead of falling back, OFF always goes through the
+// kernel page cache.
+enum {
+  VTPC_DIRECT_AUTO,
+  VTPC_DIRECT_ON,
+  VTPC_DIRECT_OFF,
+};
+
+struct vtpc_options {
+  // Number of resident pages, 0 selects the default.
+  size_t capacity;
+  // Cache page size, a power of two no smaller than the system page. 0 uses
+  // the system page size.
+  size_t page_size;
+  // Memory budget of the compressed tier for evicted pages, 0 disables it.
+  size_t zcache_bytes;
+  // Cache file on fast local storage for evicted pages, NULL disables it.
+  // The index is kept next to it in "<spill_path>.idx".
+  const char* spill_path;
+  size_t spill_bytes;
+  // Hot-set snapshot prefetched on open when it exists and the file has not
+  // changed since it was taken, and rewritten on close when hotset_autosave
+  // is set.
+  const char* hotset_path;
+  int hotset_autosave;
+  // One of VTPC_POLICY_*, MRU by default.
+  int policy;
+  // Access trace appended to this file (see vtpc_trace.h), NULL disables it.
+  const char* trace_path;
+  // Largest unit for reads spanning several aligned pages, 0 selects 1 MiB
+  // and the page size disables extents.
+  size_t extent_bytes;
+  // One of VTPC_DIRECT_*, AUTO by default.
+  int direct;
+};
+
+struct vtpc_stats {
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+  uint64_t zcache_hits;
+  uint64_t zcache_stores;
+  uint64_t zcache_rejects;
+  size_t zcache_used;
+  uint64_t spill_hits;
+  uint64_t spill_stores;
+  uint64_t hotset_pages;
+  uint64_t readahead_pages;
+  uint64_t willneed_pages;
+  uint64_t dropped_pages;
+  uint64_t reclaimed_pages;
+  uint64_t extent_fills;
+  uint64_t device_syncs;
+};
+
+// Calls are serialized by one process-wide lock, handles may be shared
+// between threads.
+void vtpc_options_init(struct vtpc_options* opts);
+
 int vtpc_open(const char* path, int mode, int access);
+int vtpc_open_ex(const char* path, int mode, int access, const struct vtpc_options* opts);
 int vtpc_close(int fd);
 ssize_t vtpc_read(int fd, void* buf, size_t count);
 ssize_t vtpc_write(int fd, const void* buf, size_t count);
+ssize_t vtpc_pread(int fd, void* buf, size_t count, off_t offset);
+ssize_t vtpc_pwrite(int fd, const void* buf, size_t count, off_t offset);
 off_t vtpc_lseek(int fd, off_t offset, int whence);
 int vtpc_fsync(int fd);
+int vtpc_fadvise(int fd, off_t offset, off_t len, int advice);
+int vtpc_save_hotset(int fd, const char* path);
+int vtpc_get_stats(int fd, struct vtpc_stats* stats);
+
+// Maps [offset, offset + len) of the file, which must lie within its size, as
+// one contiguous window over the cached pages. prot is PROT_READ, optionally
+// with PROT_WRITE. The pages stay resident until vtpc_unmap() or close.
+// Stores through a writable window count as dirty data from the next
+// vtpc_fsync(), vtpc_unmap() or close on. Returns NULL and sets errno on
+// failure.
+void* vtpc_map(int fd, off_t offset, size_t len, int prot);
+int vtpc_unmap(int fd, void* addr);
+
+// Page buffers are allocated on demand and shared one budget across all
+// handles, 0 lifts the limit. Lowering it writes back and frees pages right
+// away, clean ones first.
+int vtpc_set_memory_limit(size_t bytes);
+// Shrinks the budget while the cgroup nears memory.max or memory PSI stalls
+// are high, and grows it back once they subside. Checked from the I/O path
+// at most every 100 ms.
+int vtpc_set_memory_monitor(int enabled);
+size_t vtpc_get_memory_usage(void);
+
+// Batches concurrent vtpc_fsync() calls across threads and handles. The
+// first caller waits window_us for others to join, then writes back every
+// member and issues one fsync per file for the whole group.
+int vtpc_set_group_commit(int enabled, unsigned window_us);
@@ -0,0 +1,149 @@
+#define _GNU_SOURCE
+
+#include "vtpc_buddy.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define VTPC_BUDDY_USED UINT8_MAX
+#define VTPC_BUDDY_NONE (-1)
+
+struct vtpc_buddy {
+  char* arena;
+  int memfd;
+  size_t page_size;
+  size_t pages;
+  unsigned max_order;
+  int32_t heads[VTPC_BUDDY_MAX_ORDER + 1];
+  // Free lists are threaded through per-page arrays; order[] is only set on
+  // the first page of a free block.
+  int32_t* next;
+  int32_t* prev;
+  uint8_t* order;
+};
+
+static void vtpc_buddy_push(struct vtpc_buddy* buddy, int32_t at, unsigned order) {
+  buddy->order[at] = (uint8_t)order;
+  buddy->prev[at] = VTPC_BUDDY_NONE;
+  buddy->next[at] = buddy->heads[order];
+  if (buddy->heads[order] != VTPC_BUDDY_NONE)
+    buddy->prev[buddy->heads[order]] = at;
+  buddy->heads[order] = at;
+}
+
+static void vtpc_buddy_unlink(struct vtpc_buddy* buddy, int32_t at) {
+  unsigned order = buddy->order[at];
+  if (buddy->prev[at] != VTPC_BUDDY_NONE)
+    buddy->next[buddy->prev[at]] = buddy->next[at];
+  else
+    buddy->heads[order] = buddy->next[at];
+  if (buddy->next[at] != VTPC_BUDDY_NONE)
+    buddy->prev[buddy->next[at]] = buddy->prev[at];
+  buddy->order[at] = VTPC_BUDDY_USED;
+}
+
+struct vtpc_buddy* vtpc_buddy_create(size_t pages, size_t page_size, unsigned max_order) {
+  if (pages == 0 || pages > INT32_MAX || max_order > VTPC_BUDDY_MAX_ORDER)
+    return NULL;
+
+  struct vtpc_buddy* buddy = calloc(1, sizeof(*buddy));
+  if (buddy == NULL)
+    return NULL;
+
+  buddy->page_size = page_size;
+  buddy->pages = pages;
+  buddy->max_order = max_order;
+  buddy->next = malloc(pages * sizeof(*buddy->next));
+  buddy->prev = malloc(pages * sizeof(*buddy->prev));
+  buddy->order = malloc(pages);
+
+  // A memfd lets blocks be mapped a second time elsewhere; fall back to
+  // anonymous memory where there is none.
+  buddy->memfd = memfd_create("vtpc", MFD_CLOEXEC);
+  if (buddy->memfd >= 0 && ftruncate(buddy->memfd, (off_t)(pages * page_size)) != 0) {
+    (void)close(buddy->memfd);
+    buddy->memfd = -1;
+  }
+  if (buddy->memfd >= 0)
+    buddy->arena = mmap(NULL, pages * page_size, PROT_READ | PROT_WRITE, MAP_SHARED, buddy->memfd, 0);
+  else
+    buddy->arena = mmap(NULL, pages * page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (buddy->arena == MAP_FAILED)
+    buddy->arena = NULL;
+  if (buddy->next == NULL || buddy->prev == NULL || buddy->order == NULL || buddy->arena == NULL) {
+    vtpc_buddy_destroy(buddy);
+    return NULL;
+  }
+
+  for (unsigned i = 0; i <= VTPC_BUDDY_MAX_ORDER; ++i)
+    buddy->heads[i] = VTPC_BUDDY_NONE;
+  for (size_t i = 0; i < pages; ++i)
+    buddy->order[i] = VTPC_BUDDY_USED;
+
+  // Tile the arena with the largest aligned blocks that fit.
+  size_t at = 0;
+  while (at < pages) {
+    unsigned order = max_order;
+    while (order > 0 && ((at & ((1U << order) - 1)) != 0 || at + (1U << order) > pages))
+      --order;
+    vtpc_buddy_push(buddy, (int32_t)at, order);
+    at += (size_t)1 << order;
+  }
+  return buddy;
+}
+
+void vtpc_buddy_destroy(struct vtpc_buddy* buddy) {
+  if (buddy == NULL)
+    return;
+  if (buddy->arena != NULL)
+    (void)munmap(buddy->arena, buddy->pages * buddy->page_size);
+  if (buddy->memfd >= 0)
+    (void)close(buddy->memfd);
+  free(buddy->next);
+  free(buddy->prev);
+  free(buddy->order);
+  free(buddy);
+}
+
+void* vtpc_buddy_alloc(struct vtpc_buddy* buddy, unsigned order) {
+  unsigned found = order;
+  while (found <= buddy->max_order && buddy->heads[found] == VTPC_BUDDY_NONE)
+    ++found;
+  if (found > buddy->max_order)
+    return NULL;
+
+  int32_t at = buddy->heads[found];
+  vtpc_buddy_unlink(buddy, at);
+  while (found > order) {
+    --found;
+    vtpc_buddy_push(buddy, at + (int32_t)(1U << found), found);
+  }
+  return buddy->arena + (size_t)at * buddy->page_size;
+}
+
+void vtpc_buddy_free(struct vtpc_buddy* buddy, void* block, unsigned order) {
+  size_t bytes = buddy->page_size << order;
+  (void)madvise(block, bytes, (buddy->memfd >= 0) ? MADV_REMOVE : MADV_DONTNEED);
+
+  int32_t at = (int32_t)(((char*)block - buddy->arena) / (ptrdiff_t)buddy->page_size);
+  while (order < buddy->max_order) {
+    int32_t mate = at ^ (int32_t)(1U << order);
+    if ((size_t)mate + (1U << order) > buddy->pages || buddy->order[mate] != order)
+      break;
+    vtpc_buddy_unlink(buddy, mate);
+    if (mate < at)
+      at = mate;
+    ++order;
+  }
+  vtpc_buddy_push(buddy, at, order);
+}
+
+int vtpc_buddy_fd(const struct vtpc_buddy* buddy) {
+  return buddy->memfd;
+}
+
+off_t vtpc_buddy_offset(const struct vtpc_buddy* buddy, const void* block) {
+  return (off_t)((const char*)block - buddy->arena);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#define VTPC_BUDDY_MAX_ORDER 16
+
+// Binary buddy allocator over a shared memfd mapping of whole pages. Blocks
+// of 2^order pages are aligned to their size; freeing a block returns its
+// memory to the kernel.
+struct vtpc_buddy;
+
+struct vtpc_buddy* vtpc_buddy_create(size_t pages, size_t page_size, unsigned max_order);
+void vtpc_buddy_destroy(struct vtpc_buddy* buddy);
+
+void* vtpc_buddy_alloc(struct vtpc_buddy* buddy, unsigned order);
+void vtpc_buddy_free(struct vtpc_buddy* buddy, void* block, unsigned order);
+
+// The memfd backing the arena and a block's offset in it, for mapping the
+// block again elsewhere. -1 when the arena is anonymous memory.
+int vtpc_buddy_fd(const struct vtpc_buddy* buddy);
+off_t vtpc_buddy_offset(const struct vtpc_buddy* buddy, const void* block);
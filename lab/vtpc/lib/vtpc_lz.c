@@ -0,0 +1,169 @@
+#include "vtpc_lz.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// LZ4-like block format: a token (literal length << 4 | match length - 4),
+// extra length bytes, the literals, then a 16-bit little-endian offset.
+// The last sequence carries literals only.
+
+#define VTPC_LZ_HASH_BITS 12
+#define VTPC_LZ_MIN_MATCH 4
+#define VTPC_LZ_MAX_OFFSET 65535
+#define VTPC_LZ_LAST_LITERALS 5
+#define VTPC_LZ_MATCH_LIMIT 12
+
+static uint32_t vtpc_lz_read32(const unsigned char* p) {
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static uint32_t vtpc_lz_hash(uint32_t seq) {
+  return (seq * 2654435761U) >> (32 - VTPC_LZ_HASH_BITS);
+}
+
+static int vtpc_lz_put_length(unsigned char** op, unsigned char* end, size_t len) {
+  while (len >= 255) {
+    if (*op >= end)
+      return -1;
+    *(*op)++ = 255;
+    len -= 255;
+  }
+  if (*op >= end)
+    return -1;
+  *(*op)++ = (unsigned char)len;
+  return 0;
+}
+
+static int vtpc_lz_emit(unsigned char** op,
+                        unsigned char* end,
+                        const unsigned char* literals,
+                        size_t lit_len,
+                        size_t offset,
+                        size_t match_len) {
+  if (*op >= end)
+    return -1;
+
+  unsigned char* token = (*op)++;
+  size_t match_code = (match_len > 0) ? match_len - VTPC_LZ_MIN_MATCH : 0;
+  *token = (unsigned char)(((lit_len < 15 ? lit_len : 15) << 4) | (match_code < 15 ? match_code : 15));
+
+  if (lit_len >= 15 && vtpc_lz_put_length(op, end, lit_len - 15) != 0)
+    return -1;
+  if ((size_t)(end - *op) < lit_len)
+    return -1;
+  memcpy(*op, literals, lit_len);
+  *op += lit_len;
+
+  if (match_len == 0)
+    return 0;
+
+  if (end - *op < 2)
+    return -1;
+  *(*op)++ = (unsigned char)(offset & 0xff);
+  *(*op)++ = (unsigned char)(offset >> 8);
+
+  if (match_code >= 15 && vtpc_lz_put_length(op, end, match_code - 15) != 0)
+    return -1;
+  return 0;
+}
+
+size_t vtpc_lz_compress(const void* src, size_t src_len, void* dst, size_t dst_cap) {
+  const unsigned char* in = src;
+  unsigned char* op = dst;
+  unsigned char* end = op + dst_cap;
+  uint32_t table[1U << VTPC_LZ_HASH_BITS];
+  memset(table, 0, sizeof(table));
+
+  size_t anchor = 0;
+  size_t ip = 0;
+  if (src_len > VTPC_LZ_MATCH_LIMIT) {
+    size_t match_limit = src_len - VTPC_LZ_MATCH_LIMIT;
+    size_t extend_limit = src_len - VTPC_LZ_LAST_LITERALS;
+    while (ip < match_limit) {
+      uint32_t seq = vtpc_lz_read32(in + ip);
+      uint32_t h = vtpc_lz_hash(seq);
+      size_t ref = table[h];
+      table[h] = (uint32_t)(ip + 1);
+
+      if (ref == 0 || ip + 1 - ref > VTPC_LZ_MAX_OFFSET || vtpc_lz_read32(in + ref - 1) != seq) {
+        ++ip;
+        continue;
+      }
+      --ref;
+
+      size_t match_len = VTPC_LZ_MIN_MATCH;
+      while (ip + match_len < extend_limit && in[ref + match_len] == in[ip + match_len])
+        ++match_len;
+
+      if (vtpc_lz_emit(&op, end, in + anchor, ip - anchor, ip - ref, match_len) != 0)
+        return 0;
+      ip += match_len;
+      anchor = ip;
+    }
+  }
+
+  if (vtpc_lz_emit(&op, end, in + anchor, src_len - anchor, 0, 0) != 0)
+    return 0;
+  return (size_t)(op - (unsigned char*)dst);
+}
+
+static int vtpc_lz_get_length(const unsigned char** ip, const unsigned char* end, size_t* len) {
+  unsigned char b;
+  do {
+    if (*ip >= end)
+      return -1;
+    b = *(*ip)++;
+    *len += b;
+  } while (b == 255);
+  return 0;
+}
+
+int vtpc_lz_decompress(const void* src, size_t src_len, void* dst, size_t dst_len) {
+  const unsigned char* ip = src;
+  const unsigned char* end = ip + src_len;
+  unsigned char* out = dst;
+  size_t op = 0;
+
+  while (ip < end) {
+    unsigned char token = *ip++;
+
+    size_t lit_len = token >> 4;
+    if (lit_len == 15 && vtpc_lz_get_length(&ip, end, &lit_len) != 0)
+      return -1;
+    if ((size_t)(end - ip) < lit_len || dst_len - op < lit_len)
+      return -1;
+    memcpy(out + op, ip, lit_len);
+    ip += lit_len;
+    op += lit_len;
+
+    if (ip == end)
+      break;
+
+    if (end - ip < 2)
+      return -1;
+    size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+    ip += 2;
+    if (offset == 0 || offset > op)
+      return -1;
+
+    size_t match_len = token & 15;
+    if (match_len == 15 && vtpc_lz_get_length(&ip, end, &match_len) != 0)
+      return -1;
+    match_len += VTPC_LZ_MIN_MATCH;
+    if (dst_len - op < match_len)
+      return -1;
+
+    const unsigned char* ref = out + op - offset;
+    if (offset >= match_len) {
+      memcpy(out + op, ref, match_len);
+    } else {
+      for (size_t i = 0; i < match_len; ++i)
+        out[op + i] = ref[i];
+    }
+    op += match_len;
+  }
+
+  return (op == dst_len) ? 0 : -1;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stddef.h>
+
+size_t vtpc_lz_compress(const void* src, size_t src_len, void* dst, size_t dst_cap);
+int vtpc_lz_decompress(const void* src, size_t src_len, void* dst, size_t dst_len);
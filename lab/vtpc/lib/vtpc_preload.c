@@ -0,0 +1,508 @@
+// LD_PRELOAD interposer that routes file I/O of unmodified programs through
+// vtpc:
+//
+//   VTPC_PRELOAD_PATTERN='/data/*.tbl' LD_PRELOAD=libvtpc_preload.so cat ...
+//
+// VTPC_PRELOAD_PATTERN is a ':'-separated list of fnmatch(3) patterns matched
+// against the absolute path, VTPC_PRELOAD_CAPACITY overrides the number of
+// cached pages and VTPC_PRELOAD_TRACE names an access trace for vtpc_sim.
+// VTPC_PRELOAD_MEMORY_LIMIT caps the bytes cached by the process and
+// VTPC_PRELOAD_MEMORY_MONITOR=1 lets the cache follow memory pressure.
+// VTPC_PRELOAD_GROUP_COMMIT=<window in us> batches fsyncs of all threads. A
+// matching open() returns an O_PATH descriptor of the same file, so fstat()
+// keeps working, while data calls on it go to vtpc. Calls made from inside
+// vtpc and all other descriptors pass through to libc. Duplicates made with
+// dup(), dup2(), dup3() and fcntl(F_DUPFD) share the vtpc handle. Descriptors
+// inherited across exec(), mmap(), ftruncate() and stdio streams of routed
+// files are not supported.
+
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "vtpc.h"
+
+#define VTPC_PRELOAD_MAX_FDS 4096
+
+struct vtpc_preload_fd {
+  int handle;
+  int refs;
+  int append;
+};
+
+struct vtpc_preload_libc {
+  int (*open)(const char*, int, ...);
+  int (*openat)(int, const char*, int, ...);
+  ssize_t (*read)(int, void*, size_t);
+  ssize_t (*write)(int, const void*, size_t);
+  ssize_t (*pread)(int, void*, size_t, off_t);
+  ssize_t (*pwrite)(int, const void*, size_t, off_t);
+  off_t (*lseek)(int, off_t, int);
+  int (*fsync)(int);
+  int (*fdatasync)(int);
+  int (*close)(int);
+  int (*dup)(int);
+  int (*dup2)(int, int);
+  int (*dup3)(int, int, int);
+  int (*fcntl)(int, int, ...);
+};
+
+static struct vtpc_preload_libc g_libc;
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static int g_fds[VTPC_PRELOAD_MAX_FDS];
+static struct vtpc_preload_fd g_handles[VTPC_PRELOAD_MAX_FDS];
+static char* g_patterns;
+static size_t g_capacity;
+static char* g_trace;
+static __thread int g_inside;
+
+static void vtpc_preload_init(void) {
+  g_libc.open = (int (*)(const char*, int, ...))dlsym(RTLD_NEXT, "open");
+  g_libc.openat = (int (*)(int, const char*, int, ...))dlsym(RTLD_NEXT, "openat");
+  g_libc.read = (ssize_t(*)(int, void*, size_t))dlsym(RTLD_NEXT, "read");
+  g_libc.write = (ssize_t(*)(int, const void*, size_t))dlsym(RTLD_NEXT, "write");
+  g_libc.pread = (ssize_t(*)(int, void*, size_t, off_t))dlsym(RTLD_NEXT, "pread");
+  g_libc.pwrite = (ssize_t(*)(int, const void*, size_t, off_t))dlsym(RTLD_NEXT, "pwrite");
+  g_libc.lseek = (off_t(*)(int, off_t, int))dlsym(RTLD_NEXT, "lseek");
+  g_libc.fsync = (int (*)(int))dlsym(RTLD_NEXT, "fsync");
+  g_libc.fdatasync = (int (*)(int))dlsym(RTLD_NEXT, "fdatasync");
+  g_libc.close = (int (*)(int))dlsym(RTLD_NEXT, "close");
+  g_libc.dup = (int (*)(int))dlsym(RTLD_NEXT, "dup");
+  g_libc.dup2 = (int (*)(int, int))dlsym(RTLD_NEXT, "dup2");
+  g_libc.dup3 = (int (*)(int, int, int))dlsym(RTLD_NEXT, "dup3");
+  g_libc.fcntl = (int (*)(int, int, ...))dlsym(RTLD_NEXT, "fcntl");
+
+  const char* patterns = getenv("VTPC_PRELOAD_PATTERN");
+  if (patterns != NULL && patterns[0] != '\0')
+    g_patterns = strdup(patterns);
+
+  const char* capacity = getenv("VTPC_PRELOAD_CAPACITY");
+  if (capacity != NULL)
+    g_capacity = (size_t)strtoull(capacity, NULL, 10);
+
+  const char* trace = getenv("VTPC_PRELOAD_TRACE");
+  if (trace != NULL && trace[0] != '\0')
+    g_trace = strdup(trace);
+
+  const char* limit = getenv("VTPC_PRELOAD_MEMORY_LIMIT");
+  if (limit != NULL)
+    (void)vtpc_set_memory_limit((size_t)strtoull(limit, NULL, 10));
+
+  const char* group = getenv("VTPC_PRELOAD_GROUP_COMMIT");
+  if (group != NULL && group[0] != '\0')
+    (void)vtpc_set_group_commit(1, (unsigned)strtoul(group, NULL, 10));
+
+  // The monitor reads /proc itself, keep that away from the wrappers.
+  const char* monitor = getenv("VTPC_PRELOAD_MEMORY_MONITOR");
+  if (monitor != NULL && strcmp(monitor, "1") == 0) {
+    g_inside = 1;
+    (void)vtpc_set_memory_monitor(1);
+    g_inside = 0;
+  }
+}
+
+static int vtpc_preload_matches(const char* path) {
+  if (g_patterns == NULL)
+    return 0;
+
+  const char* pattern = g_patterns;
+  while (*pattern != '\0') {
+    const char* end = strchr(pattern, ':');
+    size_t len = (end != NULL) ? (size_t)(end - pattern) : strlen(pattern);
+    char one[PATH_MAX];
+    if (len > 0 && len < sizeof(one)) {
+      memcpy(one, pattern, len);
+      one[len] = '\0';
+      if (fnmatch(one, path, 0) == 0)
+        return 1;
+    }
+    if (end == NULL)
+      break;
+    pattern = end + 1;
+  }
+  return 0;
+}
+
+static int vtpc_preload_absolute(int dirfd, const char* path, char* out, size_t size) {
+  if (path[0] == '/')
+    return (snprintf(out, size, "%s", path) < (int)size) ? 0 : -1;
+
+  char dir[PATH_MAX];
+  if (dirfd == AT_FDCWD) {
+    if (getcwd(dir, sizeof(dir)) == NULL)
+      return -1;
+  } else {
+    char link[64];
+    snprintf(link, sizeof(link), "/proc/self/fd/%d", dirfd);
+    ssize_t len = readlink(link, dir, sizeof(dir) - 1);
+    if (len < 0)
+      return -1;
+    dir[len] = '\0';
+  }
+  return (snprintf(out, size, "%s/%s", dir, path) < (int)size) ? 0 : -1;
+}
+
+static struct vtpc_preload_fd* vtpc_preload_lookup(int fd) {
+  // Checked first: the libc pointers are set, and init itself may call in.
+  if (g_inside)
+    return NULL;
+  pthread_once(&g_once, vtpc_preload_init);
+  if (fd < 0 || fd >= VTPC_PRELOAD_MAX_FDS || g_fds[fd] == 0)
+    return NULL;
+  return &g_handles[g_fds[fd] - 1];
+}
+
+static int vtpc_preload_open(int dirfd, const char* path, int flags, mode_t mode) {
+  char absolute[PATH_MAX];
+  if ((flags & (O_PATH | O_DIRECTORY)) != 0 || vtpc_preload_absolute(dirfd, path, absolute, sizeof(absolute)) != 0 ||
+      !vtpc_preload_matches(absolute))
+    return g_libc.openat(dirfd, path, flags, mode);
+
+  struct vtpc_options opts;
+  vtpc_options_init(&opts);
+  if (g_capacity != 0)
+    opts.capacity = g_capacity;
+  opts.trace_path = g_trace;
+
+  pthread_mutex_lock(&g_lock);
+  g_inside = 1;
+  int handle = vtpc_open_ex(absolute, flags & ~(O_APPEND | O_CLOEXEC), mode, &opts);
+  int fd = -1;
+  if (handle >= 0) {
+    fd = g_libc.open(absolute, O_PATH | (flags & O_CLOEXEC));
+    if (fd < 0 || fd >= VTPC_PRELOAD_MAX_FDS || handle >= VTPC_PRELOAD_MAX_FDS) {
+      int err = (fd < 0) ? errno : EMFILE;
+      if (fd >= 0)
+        g_libc.close(fd);
+      (void)vtpc_close(handle);
+      fd = -1;
+      errno = err;
+    } else {
+      g_fds[fd] = handle + 1;
+      g_handles[handle].handle = handle;
+      g_handles[handle].refs = 1;
+      g_handles[handle].append = (flags & O_APPEND) != 0;
+    }
+  }
+  g_inside = 0;
+  pthread_mutex_unlock(&g_lock);
+  return fd;
+}
+
+static mode_t vtpc_preload_mode(int flags, va_list args) {
+  if ((flags & O_CREAT) != 0 || (flags & O_TMPFILE) == O_TMPFILE)
+    return (mode_t)va_arg(args, int);
+  return 0;
+}
+
+static int vtpc_preload_enter(const struct vtpc_preload_fd* entry) {
+  pthread_mutex_lock(&g_lock);
+  g_inside = 1;
+  return (entry->refs > 0) ? entry->handle : -1;
+}
+
+static void vtpc_preload_leave(void) {
+  int err = errno;
+  g_inside = 0;
+  pthread_mutex_unlock(&g_lock);
+  errno = err;
+}
+
+// Called with the lock held: forgets fd and closes the vtpc handle once no
+// descriptor refers to it.
+static int vtpc_preload_release(int fd) {
+  struct vtpc_preload_fd* entry = &g_handles[g_fds[fd] - 1];
+  g_fds[fd] = 0;
+  if (--entry->refs > 0)
+    return 0;
+  return vtpc_close(entry->handle);
+}
+
+static int vtpc_preload_dup(int oldfd, int newfd) {
+  if (newfd < 0)
+    return newfd;
+
+  pthread_mutex_lock(&g_lock);
+  if (oldfd != newfd && g_fds[oldfd] != 0) {
+    if (newfd >= VTPC_PRELOAD_MAX_FDS) {
+      g_libc.close(newfd);
+      newfd = -1;
+      errno = EMFILE;
+    } else {
+      g_fds[newfd] = g_fds[oldfd];
+      g_handles[g_fds[oldfd] - 1].refs++;
+    }
+  }
+  pthread_mutex_unlock(&g_lock);
+  return newfd;
+}
+
+static void vtpc_preload_forget(int fd) {
+  if (g_inside)
+    return;
+  pthread_once(&g_once, vtpc_preload_init);
+  if (fd < 0 || fd >= VTPC_PRELOAD_MAX_FDS)
+    return;
+
+  pthread_mutex_lock(&g_lock);
+  if (g_fds[fd] != 0) {
+    g_inside = 1;
+    (void)vtpc_preload_release(fd);
+    g_inside = 0;
+  }
+  pthread_mutex_unlock(&g_lock);
+}
+
+int open(const char* path, int flags, ...) {
+  va_list args;
+  va_start(args, flags);
+  mode_t mode = vtpc_preload_mode(flags, args);
+  va_end(args);
+
+  if (g_inside)
+    return g_libc.open(path, flags, mode);
+  pthread_once(&g_once, vtpc_preload_init);
+  return vtpc_preload_open(AT_FDCWD, path, flags, mode);
+}
+
+int openat(int dirfd, const char* path, int flags, ...) {
+  va_list args;
+  va_start(args, flags);
+  mode_t mode = vtpc_preload_mode(flags, args);
+  va_end(args);
+
+  if (g_inside)
+    return g_libc.openat(dirfd, path, flags, mode);
+  pthread_once(&g_once, vtpc_preload_init);
+  return vtpc_preload_open(dirfd, path, flags, mode);
+}
+
+int open64(const char* path, int flags, ...) __attribute__((alias("open")));
+int openat64(int dirfd, const char* path, int flags, ...) __attribute__((alias("openat")));
+
+int __open_2(const char* path, int flags) {
+  return open(path, flags);
+}
+
+int __openat_2(int dirfd, const char* path, int flags) {
+  return openat(dirfd, path, flags);
+}
+
+ssize_t read(int fd, void* buf, size_t count) {
+  struct vtpc_preload_fd* entry = vtpc_preload_lookup(fd);
+  if (entry == NULL)
+    return g_libc.read(fd, buf, count);
+
+  ssize_t done = vtpc_read(vtpc_preload_enter(entry), buf, count);
+  vtpc_preload_leave();
+  return done;
+}
+
+ssize_t write(int fd, const void* buf, size_t count) {
+  struct vtpc_preload_fd* entry = vtpc_preload_lookup(fd);
+  if (entry == NULL)
+    return g_libc.write(fd, buf, count);
+
+  int handle = vtpc_preload_enter(entry);
+  ssize_t done = -1;
+  if (!entry->append || vtpc_lseek(handle, 0, SEEK_END) >= 0)
+    done = vtpc_write(handle, buf, count);
+  vtpc_preload_leave();
+  return done;
+}
+
+ssize_t pread(int fd, void* buf, size_t count, off_t offset) {
+  struct vtpc_preload_fd* entry = vtpc_preload_lookup(fd);
+  if (entry == NULL)
+    return g_libc.pread(fd, buf, count, offset);
+
+  ssize_t done = vtpc_pread(vtpc_preload_enter(entry), buf, count, offset);
+  vtpc_preload_leave();
+  return done;
+}
+
+ssize_t pwrite(int fd, const void* buf, size_t count, off_t offset) {
+  struct vtpc_preload_fd* entry = vtpc_preload_lookup(fd);
+  if (entry == NULL)
+    return g_libc.pwrite(fd, buf, count, offset);
+
+  ssize_t done = vtpc_pwrite(vtpc_preload_enter(entry), buf, count, offset);
+  vtpc_preload_leave();
+  return done;
+}
+
+ssize_t pread64(int fd, void* buf, size_t count, off_t offset) __attribute__((alias("pread")));
+ssize_t pwrite64(int fd, const void* buf, size_t count, off_t offset) __attribute__((alias("pwrite")));
+
+off_t lseek(int fd, off_t offset, int whence) {
+  struct vtpc_preload_fd* entry = vtpc_preload_lookup(fd);
+  if (entry == NULL)
+    return g_libc.lseek(fd, offset, whence);
+
+  off_t done = vtpc_lseek(vtpc_preload_enter(entry), offset, whence);
+  vtpc_preload_leave();
+  return done;
+}
+
+off_t lseek64(int fd, off_t offset, int whence) __attribute__((alias("lseek")));
+
+// Syncs without holding the lock so that concurrent fsyncs can form a
+// commit group; the extra reference keeps the handle open meanwhile.
+static int vtpc_preload_sync(struct vtpc_preload_fd* entry) {
+  int handle = vtpc_preload_enter(entry);
+  if (handle >= 0)
+    entry->refs++;
+  vtpc_preload_leave();
+
+  g_inside = 1;
+  int done = vtpc_fsync(handle);
+  g_inside = 0;
+  if (handle < 0)
+    return done;
+
+  int err = errno;
+  (void)vtpc_preload_enter(entry);
+  if (--entry->refs == 0 && vtpc_close(handle) != 0)
+    done = -1;
+  else
+    errno = err;
+  vtpc_preload_leave();
+  return done;
+}
+
+int fsync(int fd) {
+  struct vtpc_preload_fd* entry = vtpc_preload_lookup(fd);
+  if (entry == NULL)
+    return g_libc.fsync(fd);
+  return vtpc_preload_sync(entry);
+}
+
+int fdatasync(int fd) {
+  struct vtpc_preload_fd* entry = vtpc_preload_lookup(fd);
+  if (entry == NULL)
+    return g_libc.fdatasync(fd);
+  return vtpc_preload_sync(entry);
+}
+
+int close(int fd) {
+  struct vtpc_preload_fd* entry = vtpc_preload_lookup(fd);
+  if (entry == NULL)
+    return g_libc.close(fd);
+
+  (void)vtpc_preload_enter(entry);
+  int done = vtpc_preload_release(fd);
+  vtpc_preload_leave();
+  int closed = g_libc.close(fd);
+  return (done == 0) ? closed : done;
+}
+
+int dup(int oldfd) {
+  if (vtpc_preload_lookup(oldfd) == NULL)
+    return g_libc.dup(oldfd);
+  return vtpc_preload_dup(oldfd, g_libc.dup(oldfd));
+}
+
+int dup2(int oldfd, int newfd) {
+  pthread_once(&g_once, vtpc_preload_init);
+  if (oldfd != newfd && g_libc.fcntl(oldfd, F_GETFD) != -1)
+    vtpc_preload_forget(newfd);
+  if (vtpc_preload_lookup(oldfd) == NULL)
+    return g_libc.dup2(oldfd, newfd);
+  return vtpc_preload_dup(oldfd, g_libc.dup2(oldfd, newfd));
+}
+
+int dup3(int oldfd, int newfd, int flags) {
+  pthread_once(&g_once, vtpc_preload_init);
+  if (oldfd != newfd && g_libc.fcntl(oldfd, F_GETFD) != -1)
+    vtpc_preload_forget(newfd);
+  if (vtpc_preload_lookup(oldfd) == NULL)
+    return g_libc.dup3(oldfd, newfd, flags);
+  return vtpc_preload_dup(oldfd, g_libc.dup3(oldfd, newfd, flags));
+}
+
+enum {
+  VTPC_PRELOAD_ARG_NONE,
+  VTPC_PRELOAD_ARG_INT,
+  VTPC_PRELOAD_ARG_POINTER,
+};
+
+// Like libc, only fetch the argument of commands that take one; unknown
+// commands are assumed to take a pointer.
+static int vtpc_preload_fcntl_arg(int cmd) {
+  switch (cmd) {
+    case F_GETFD:
+    case F_GETFL:
+    case F_GETOWN:
+#ifdef F_GETSIG
+    case F_GETSIG:
+#endif
+#ifdef F_GETLEASE
+    case F_GETLEASE:
+#endif
+#ifdef F_GETPIPE_SZ
+    case F_GETPIPE_SZ:
+#endif
+#ifdef F_GET_SEALS
+    case F_GET_SEALS:
+#endif
+      return VTPC_PRELOAD_ARG_NONE;
+    case F_DUPFD:
+    case F_DUPFD_CLOEXEC:
+    case F_SETFD:
+    case F_SETFL:
+    case F_SETOWN:
+#ifdef F_SETSIG
+    case F_SETSIG:
+#endif
+#ifdef F_SETLEASE
+    case F_SETLEASE:
+#endif
+#ifdef F_NOTIFY
+    case F_NOTIFY:
+#endif
+#ifdef F_SETPIPE_SZ
+    case F_SETPIPE_SZ:
+#endif
+#ifdef F_ADD_SEALS
+    case F_ADD_SEALS:
+#endif
+      return VTPC_PRELOAD_ARG_INT;
+    default:
+      return VTPC_PRELOAD_ARG_POINTER;
+  }
+}
+
+int fcntl(int fd, int cmd, ...) {
+  pthread_once(&g_once, vtpc_preload_init);
+  int kind = vtpc_preload_fcntl_arg(cmd);
+  if (kind == VTPC_PRELOAD_ARG_NONE)
+    return g_libc.fcntl(fd, cmd);
+
+  va_list args;
+  va_start(args, cmd);
+  if (kind == VTPC_PRELOAD_ARG_POINTER) {
+    void* arg = va_arg(args, void*);
+    va_end(args);
+    return g_libc.fcntl(fd, cmd, arg);
+  }
+  int arg = va_arg(args, int);
+  va_end(args);
+
+  if ((cmd == F_DUPFD || cmd == F_DUPFD_CLOEXEC) && vtpc_preload_lookup(fd) != NULL)
+    return vtpc_preload_dup(fd, g_libc.fcntl(fd, cmd, arg));
+  return g_libc.fcntl(fd, cmd, arg);
+}
+
+int fcntl64(int fd, int cmd, ...) __attribute__((alias("fcntl")));
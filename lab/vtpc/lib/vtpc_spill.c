@@ -0,0 +1,438 @@
+#define _GNU_SOURCE
+
+#include "vtpc_spill.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#define VTPC_SPILL_MAGIC 0x31505350435456ULL  // "VTPCSP1"
+#define VTPC_SPILL_NONE UINT32_MAX
+
+struct vtpc_spill_inode {
+  uint64_t dev;
+  uint64_t ino;
+  int64_t mtime_sec;
+  int64_t mtime_nsec;
+  int64_t size;
+};
+
+struct vtpc_spill_entry {
+  uint64_t dev;
+  uint64_t ino;
+  uint64_t page_no;
+  uint64_t valid;
+};
+
+struct vtpc_spill_header {
+  uint64_t magic;
+  uint64_t page_size;
+  uint64_t slot_count;
+  uint64_t inode_count;
+  uint64_t entry_count;
+};
+
+struct vtpc_spill {
+  char* path;
+  int refs;
+  int fd;
+  size_t page_size;
+  uint32_t slot_count;
+  uint32_t bucket_mask;
+  uint32_t free_head;
+  uint32_t cursor;
+  uint32_t* buckets;
+  uint32_t* next;
+  unsigned char* used;
+  struct vtpc_spill_entry* entries;
+  struct vtpc_spill_inode* inodes;
+  size_t inode_count;
+  size_t inode_cap;
+  struct vtpc_spill* link;
+};
+
+static struct vtpc_spill* g_spills;
+
+static uint32_t vtpc_spill_hash(const struct vtpc_spill* spill, uint64_t dev, uint64_t ino, uint64_t page_no) {
+  uint64_t h = (dev * 0x9E3779B97F4A7C15ULL) ^ (ino * 0xC2B2AE3D27D4EB4FULL) ^ page_no;
+  h ^= h >> 29;
+  return (uint32_t)h & spill->bucket_mask;
+}
+
+static uint32_t* vtpc_spill_find(struct vtpc_spill* spill, uint64_t dev, uint64_t ino, uint64_t page_no) {
+  uint32_t* link = &spill->buckets[vtpc_spill_hash(spill, dev, ino, page_no)];
+  while (*link != VTPC_SPILL_NONE) {
+    const struct vtpc_spill_entry* e = &spill->entries[*link];
+    if (e->dev == dev && e->ino == ino && e->page_no == page_no)
+      break;
+    link = &spill->next[*link];
+  }
+  return link;
+}
+
+static void vtpc_spill_unlink(struct vtpc_spill* spill, uint32_t* link) {
+  uint32_t slot = *link;
+  *link = spill->next[slot];
+  spill->used[slot] = 0;
+  spill->next[slot] = spill->free_head;
+  spill->free_head = slot;
+}
+
+static void vtpc_spill_insert(struct vtpc_spill* spill, uint32_t slot, const struct vtpc_spill_entry* e) {
+  uint32_t* bucket = &spill->buckets[vtpc_spill_hash(spill, e->dev, e->ino, e->page_no)];
+  spill->entries[slot] = *e;
+  spill->used[slot] = 1;
+  spill->next[slot] = *bucket;
+  *bucket = slot;
+}
+
+static uint32_t vtpc_spill_alloc(struct vtpc_spill* spill) {
+  if (spill->free_head != VTPC_SPILL_NONE) {
+    uint32_t slot = spill->free_head;
+    spill->free_head = spill->next[slot];
+    return slot;
+  }
+
+  uint32_t slot = spill->cursor;
+  spill->cursor = (spill->cursor + 1) % spill->slot_count;
+  const struct vtpc_spill_entry* e = &spill->entries[slot];
+  vtpc_spill_unlink(spill, vtpc_spill_find(spill, e->dev, e->ino, e->page_no));
+  spill->free_head = spill->next[slot];
+  return slot;
+}
+
+static void vtpc_spill_reset(struct vtpc_spill* spill) {
+  for (uint32_t i = 0; i <= spill->bucket_mask; ++i)
+    spill->buckets[i] = VTPC_SPILL_NONE;
+  for (uint32_t i = 0; i < spill->slot_count; ++i) {
+    spill->used[i] = 0;
+    spill->next[i] = (i + 1 < spill->slot_count) ? i + 1 : VTPC_SPILL_NONE;
+  }
+  spill->free_head = 0;
+  spill->cursor = 0;
+  spill->inode_count = 0;
+}
+
+static char* vtpc_spill_index_path(const char* path, const char* suffix) {
+  size_t len = strlen(path) + strlen(suffix) + 1;
+  char* index = malloc(len);
+  if (index != NULL)
+    snprintf(index, len, "%s%s", path, suffix);
+  return index;
+}
+
+static int vtpc_spill_read_all(int fd, void* buf, size_t len) {
+  size_t done = 0;
+  while (done < len) {
+    ssize_t got = read(fd, (char*)buf + done, len - done);
+    if (got <= 0)
+      return -1;
+    done += (size_t)got;
+  }
+  return 0;
+}
+
+static int vtpc_spill_write_all(int fd, const void* buf, size_t len) {
+  size_t done = 0;
+  while (done < len) {
+    ssize_t put = write(fd, (const char*)buf + done, len - done);
+    if (put <= 0)
+      return -1;
+    done += (size_t)put;
+  }
+  return 0;
+}
+
+static int vtpc_spill_reserve_inodes(struct vtpc_spill* spill, size_t count) {
+  if (count <= spill->inode_cap)
+    return 0;
+  size_t cap = (spill->inode_cap != 0) ? spill->inode_cap * 2 : 16;
+  while (cap < count)
+    cap *= 2;
+  struct vtpc_spill_inode* inodes = realloc(spill->inodes, cap * sizeof(*inodes));
+  if (inodes == NULL)
+    return -1;
+  spill->inodes = inodes;
+  spill->inode_cap = cap;
+  return 0;
+}
+
+static void vtpc_spill_load_index(struct vtpc_spill* spill) {
+  char* index = vtpc_spill_index_path(spill->path, ".idx");
+  if (index == NULL)
+    return;
+
+  int fd = open(index, O_RDONLY);
+  // The index only describes the cache file while nobody writes to it, so
+  // it is removed for the lifetime of the tier and rewritten on release.
+  (void)unlink(index);
+  free(index);
+  if (fd < 0)
+    return;
+
+  struct vtpc_spill_header header;
+  if (vtpc_spill_read_all(fd, &header, sizeof(header)) != 0 || header.magic != VTPC_SPILL_MAGIC ||
+      header.page_size != spill->page_size || header.slot_count != spill->slot_count ||
+      header.entry_count > spill->slot_count) {
+    close(fd);
+    return;
+  }
+
+  if (vtpc_spill_reserve_inodes(spill, header.inode_count) != 0 ||
+      vtpc_spill_read_all(fd, spill->inodes, header.inode_count * sizeof(*spill->inodes)) != 0) {
+    close(fd);
+    return;
+  }
+  spill->inode_count = header.inode_count;
+
+  for (uint64_t i = 0; i < header.entry_count; ++i) {
+    uint32_t slot;
+    struct vtpc_spill_entry e;
+    if (vtpc_spill_read_all(fd, &slot, sizeof(slot)) != 0 || vtpc_spill_read_all(fd, &e, sizeof(e)) != 0 ||
+        slot >= spill->slot_count || spill->used[slot]) {
+      vtpc_spill_reset(spill);
+      break;
+    }
+    vtpc_spill_insert(spill, slot, &e);
+  }
+  close(fd);
+
+  spill->free_head = VTPC_SPILL_NONE;
+  for (uint32_t i = spill->slot_count; i-- > 0;) {
+    if (!spill->used[i]) {
+      spill->next[i] = spill->free_head;
+      spill->free_head = i;
+    }
+  }
+}
+
+static void vtpc_spill_save_index(struct vtpc_spill* spill) {
+  char* tmp = vtpc_spill_index_path(spill->path, ".idx.tmp");
+  char* index = vtpc_spill_index_path(spill->path, ".idx");
+  if (tmp == NULL || index == NULL) {
+    free(tmp);
+    free(index);
+    return;
+  }
+
+  struct vtpc_spill_header header = {
+      .magic = VTPC_SPILL_MAGIC,
+      .page_size = spill->page_size,
+      .slot_count = spill->slot_count,
+      .inode_count = spill->inode_count,
+      .entry_count = 0,
+  };
+  for (uint32_t i = 0; i < spill->slot_count; ++i)
+    header.entry_count += spill->used[i];
+
+  int fd = (fsync(spill->fd) == 0) ? open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644) : -1;
+  int ok = (fd >= 0);
+  ok = ok && vtpc_spill_write_all(fd, &header, sizeof(header)) == 0;
+  ok = ok && vtpc_spill_write_all(fd, spill->inodes, spill->inode_count * sizeof(*spill->inodes)) == 0;
+  for (uint32_t i = 0; ok && i < spill->slot_count; ++i) {
+    if (!spill->used[i])
+      continue;
+    ok = vtpc_spill_write_all(fd, &i, sizeof(i)) == 0 &&
+         vtpc_spill_write_all(fd, &spill->entries[i], sizeof(spill->entries[i])) == 0;
+  }
+  ok = ok && fsync(fd) == 0;
+  if (fd >= 0)
+    close(fd);
+
+  if (ok)
+    (void)rename(tmp, index);
+  else
+    (void)unlink(tmp);
+  free(tmp);
+  free(index);
+}
+
+static void vtpc_spill_destroy(struct vtpc_spill* spill) {
+  if (spill->fd >= 0)
+    close(spill->fd);
+  free(spill->path);
+  free(spill->buckets);
+  free(spill->next);
+  free(spill->used);
+  free(spill->entries);
+  free(spill->inodes);
+  free(spill);
+}
+
+static int vtpc_spill_open_cache(const char* path) {
+#ifdef O_DIRECT
+  int fd = open(path, O_RDWR | O_CREAT | O_DIRECT, 0644);
+  if (fd >= 0 || (errno != EINVAL && errno != EOPNOTSUPP))
+    return fd;
+#endif
+  return open(path, O_RDWR | O_CREAT, 0644);
+}
+
+struct vtpc_spill* vtpc_spill_acquire(const char* path, size_t page_size, size_t capacity) {
+  for (struct vtpc_spill* it = g_spills; it != NULL; it = it->link) {
+    if (strcmp(it->path, path) == 0) {
+      it->refs++;
+      return it;
+    }
+  }
+
+  size_t slots = capacity / page_size;
+  if (slots == 0 || slots >= VTPC_SPILL_NONE) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  struct vtpc_spill* spill = calloc(1, sizeof(*spill));
+  if (spill == NULL)
+    return NULL;
+
+  uint32_t buckets = 64;
+  while (buckets < slots)
+    buckets <<= 1;
+
+  spill->fd = -1;
+  spill->refs = 1;
+  spill->page_size = page_size;
+  spill->slot_count = (uint32_t)slots;
+  spill->bucket_mask = buckets - 1;
+  spill->path = strdup(path);
+  spill->buckets = malloc(buckets * sizeof(*spill->buckets));
+  spill->next = malloc(slots * sizeof(*spill->next));
+  spill->used = malloc(slots);
+  spill->entries = malloc(slots * sizeof(*spill->entries));
+  if (spill->path == NULL || spill->buckets == NULL || spill->next == NULL || spill->used == NULL ||
+      spill->entries == NULL) {
+    vtpc_spill_destroy(spill);
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  spill->fd = vtpc_spill_open_cache(path);
+  if (spill->fd < 0 || flock(spill->fd, LOCK_EX | LOCK_NB) != 0) {
+    vtpc_spill_destroy(spill);
+    return NULL;
+  }
+
+  vtpc_spill_reset(spill);
+  vtpc_spill_load_index(spill);
+
+  spill->link = g_spills;
+  g_spills = spill;
+  return spill;
+}
+
+void vtpc_spill_release(struct vtpc_spill* spill) {
+  if (spill == NULL || --spill->refs > 0)
+    return;
+
+  for (struct vtpc_spill** it = &g_spills; *it != NULL; it = &(*it)->link) {
+    if (*it == spill) {
+      *it = spill->link;
+      break;
+    }
+  }
+
+  vtpc_spill_save_index(spill);
+  vtpc_spill_destroy(spill);
+}
+
+size_t vtpc_spill_page_size(const struct vtpc_spill* spill) {
+  return spill->page_size;
+}
+
+static struct vtpc_spill_inode* vtpc_spill_inode(struct vtpc_spill* spill, const struct stat* st) {
+  for (size_t i = 0; i < spill->inode_count; ++i) {
+    if (spill->inodes[i].dev == (uint64_t)st->st_dev && spill->inodes[i].ino == (uint64_t)st->st_ino)
+      return &spill->inodes[i];
+  }
+  if (vtpc_spill_reserve_inodes(spill, spill->inode_count + 1) != 0)
+    return NULL;
+
+  struct vtpc_spill_inode* inode = &spill->inodes[spill->inode_count++];
+  inode->dev = (uint64_t)st->st_dev;
+  inode->ino = (uint64_t)st->st_ino;
+  inode->mtime_sec = -1;
+  inode->mtime_nsec = -1;
+  inode->size = -1;
+  return inode;
+}
+
+void vtpc_spill_validate(struct vtpc_spill* spill, const struct stat* st) {
+  struct vtpc_spill_inode* inode = vtpc_spill_inode(spill, st);
+  if (inode != NULL && inode->mtime_sec == (int64_t)st->st_mtim.tv_sec &&
+      inode->mtime_nsec == (int64_t)st->st_mtim.tv_nsec && inode->size == (int64_t)st->st_size)
+    return;
+
+  for (uint32_t i = 0; i < spill->slot_count; ++i) {
+    const struct vtpc_spill_entry* e = &spill->entries[i];
+    if (spill->used[i] && e->dev == (uint64_t)st->st_dev && e->ino == (uint64_t)st->st_ino)
+      vtpc_spill_unlink(spill, vtpc_spill_find(spill, e->dev, e->ino, e->page_no));
+  }
+  vtpc_spill_commit(spill, st);
+}
+
+void vtpc_spill_commit(struct vtpc_spill* spill, const struct stat* st) {
+  struct vtpc_spill_inode* inode = vtpc_spill_inode(spill, st);
+  if (inode == NULL)
+    return;
+  inode->mtime_sec = (int64_t)st->st_mtim.tv_sec;
+  inode->mtime_nsec = (int64_t)st->st_mtim.tv_nsec;
+  inode->size = (int64_t)st->st_size;
+}
+
+int vtpc_spill_store(struct vtpc_spill* spill,
+                     dev_t dev,
+                     ino_t ino,
+                     uint64_t page_no,
+                     const void* data,
+                     size_t valid) {
+  vtpc_spill_forget(spill, dev, ino, page_no);
+
+  uint32_t slot = vtpc_spill_alloc(spill);
+  ssize_t written = pwrite(spill->fd, data, spill->page_size, (off_t)slot * (off_t)spill->page_size);
+  if (written < 0 || (size_t)written != spill->page_size) {
+    spill->next[slot] = spill->free_head;
+    spill->free_head = slot;
+    return -1;
+  }
+
+  struct vtpc_spill_entry e = {
+      .dev = (uint64_t)dev,
+      .ino = (uint64_t)ino,
+      .page_no = page_no,
+      .valid = valid,
+  };
+  vtpc_spill_insert(spill, slot, &e);
+  return 0;
+}
+
+int vtpc_spill_load(struct vtpc_spill* spill,
+                    dev_t dev,
+                    ino_t ino,
+                    uint64_t page_no,
+                    void* data,
+                    size_t* valid) {
+  uint32_t* link = vtpc_spill_find(spill, (uint64_t)dev, (uint64_t)ino, page_no);
+  if (*link == VTPC_SPILL_NONE)
+    return 0;
+
+  uint32_t slot = *link;
+  ssize_t done = pread(spill->fd, data, spill->page_size, (off_t)slot * (off_t)spill->page_size);
+  size_t entry_valid = (size_t)spill->entries[slot].valid;
+  vtpc_spill_unlink(spill, link);
+  if (done < 0 || (size_t)done != spill->page_size)
+    return 0;
+
+  *valid = entry_valid;
+  return 1;
+}
+
+void vtpc_spill_forget(struct vtpc_spill* spill, dev_t dev, ino_t ino, uint64_t page_no) {
+  uint32_t* link = vtpc_spill_find(spill, (uint64_t)dev, (uint64_t)ino, page_no);
+  if (*link != VTPC_SPILL_NONE)
+    vtpc_spill_unlink(spill, link);
+}
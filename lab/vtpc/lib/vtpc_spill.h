@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+struct vtpc_spill;
+
+struct vtpc_spill* vtpc_spill_acquire(const char* path, size_t page_size, size_t capacity);
+void vtpc_spill_release(struct vtpc_spill* spill);
+
+size_t vtpc_spill_page_size(const struct vtpc_spill* spill);
+void vtpc_spill_validate(struct vtpc_spill* spill, const struct stat* st);
+void vtpc_spill_commit(struct vtpc_spill* spill, const struct stat* st);
+
+int vtpc_spill_store(struct vtpc_spill* spill,
+                     dev_t dev,
+                     ino_t ino,
+                     uint64_t page_no,
+                     const void* data,
+                     size_t valid);
+int vtpc_spill_load(struct vtpc_spill* spill,
+                    dev_t dev,
+                    ino_t ino,
+                    uint64_t page_no,
+                    void* data,
+                    size_t* valid);
+void vtpc_spill_forget(struct vtpc_spill* spill, dev_t dev, ino_t ino, uint64_t page_no);
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+
+// On-disk trace written by vtpc when vtpc_options.trace_path is set: one
+// header followed by fixed-size records in host byte order. Several handles
+// may append to the same file, records carry the handle number.
+
+#define VTPC_TRACE_MAGIC 0x3145435254435456ULL  // "VTCTRCE1"
+
+enum {
+  VTPC_TRACE_READ,
+  VTPC_TRACE_WRITE,
+  VTPC_TRACE_FSYNC,
+};
+
+struct vtpc_trace_header {
+  uint64_t magic;
+  uint32_t record_size;
+  uint32_t reserved;
+};
+
+struct vtpc_trace_record {
+  uint64_t timestamp_ns;
+  uint64_t offset;
+  uint32_t length;
+  uint16_t op;
+  uint16_t file;
+  uint32_t tid;
+  uint32_t reserved;
+};
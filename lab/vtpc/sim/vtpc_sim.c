@@ -0,0 +1,607 @@
+// Offline replay of vtpc access traces (see vtpc_trace.h) against the page
+// replacement policies at a range of cache sizes. Prints miss-ratio curves
+// as CSV:
+//
+//   vtpc_sim --trace <path> [--page_size <bytes>] [--sizes N,N,...]
+//            [--policy lru,mru,fifo,clock,opt] [--sample <rate>]
+//
+// LRU is exact for every size at once, computed from reuse (stack) distances
+// in a single pass. The other policies are simulated once per size. With
+// --sample only pages whose hash falls under the rate are replayed (SHARDS):
+// every policy, LRU included, runs with the cache scaled down by the rate,
+// to no less than one page.
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vtpc_trace.h"
+
+#define SIM_SAMPLE_BITS 24
+#define SIM_MAX_SIZES 64
+
+enum {
+  SIM_LRU = 1U << 0U,
+  SIM_MRU = 1U << 1U,
+  SIM_FIFO = 1U << 2U,
+  SIM_CLOCK = 1U << 3U,
+  SIM_OPT = 1U << 4U,
+};
+
+struct sim_options {
+  const char* path;
+  size_t page_size;
+  unsigned policies;
+  double rate;
+  size_t sizes[SIM_MAX_SIZES];
+  size_t size_count;
+};
+
+// Page accesses mapped to dense ids, after sampling.
+struct sim_trace {
+  uint32_t* ids;
+  size_t count;
+  size_t capacity;
+  size_t total;
+  size_t pages;
+};
+
+struct sim_map {
+  uint64_t* keys;
+  uint32_t* values;  // id + 1, 0 is an empty slot
+  size_t mask;
+};
+
+static uint64_t sim_hash(uint64_t key) {
+  key ^= key >> 30U;
+  key *= 0xbf58476d1ce4e5b9ULL;
+  key ^= key >> 27U;
+  key *= 0x94d049bb133111ebULL;
+  key ^= key >> 31U;
+  return key;
+}
+
+static int sim_map_grow(struct sim_map* map) {
+  size_t size = (map->keys == NULL) ? 1024 : (map->mask + 1) * 2;
+  uint64_t* keys = malloc(size * sizeof(*keys));
+  uint32_t* values = calloc(size, sizeof(*values));
+  if (keys == NULL || values == NULL) {
+    free(keys);
+    free(values);
+    return -1;
+  }
+
+  for (size_t i = 0; map->keys != NULL && i <= map->mask; ++i) {
+    if (map->values[i] == 0)
+      continue;
+    size_t slot = sim_hash(map->keys[i]) & (size - 1);
+    while (values[slot] != 0)
+      slot = (slot + 1) & (size - 1);
+    keys[slot] = map->keys[i];
+    values[slot] = map->values[i];
+  }
+
+  free(map->keys);
+  free(map->values);
+  map->keys = keys;
+  map->values = values;
+  map->mask = size - 1;
+  return 0;
+}
+
+static int sim_trace_add(struct sim_trace* trace, struct sim_map* map, uint64_t key, uint64_t hash) {
+  if (map->keys == NULL || trace->pages * 2 > map->mask) {
+    if (sim_map_grow(map) != 0)
+      return -1;
+  }
+
+  size_t slot = hash & map->mask;
+  while (map->values[slot] != 0 && map->keys[slot] != key)
+    slot = (slot + 1) & map->mask;
+  if (map->values[slot] == 0) {
+    if (trace->pages >= UINT32_MAX - 1) {
+      errno = EOVERFLOW;
+      return -1;
+    }
+    map->keys[slot] = key;
+    map->values[slot] = (uint32_t)++trace->pages;
+  }
+
+  if (trace->count == trace->capacity) {
+    size_t capacity = (trace->capacity == 0) ? 4096 : trace->capacity * 2;
+    uint32_t* ids = realloc(trace->ids, capacity * sizeof(*ids));
+    if (ids == NULL)
+      return -1;
+    trace->ids = ids;
+    trace->capacity = capacity;
+  }
+  trace->ids[trace->count++] = map->values[slot] - 1;
+  return 0;
+}
+
+static int sim_load(const struct sim_options* opts, struct sim_trace* trace) {
+  FILE* in = fopen(opts->path, "rb");
+  if (in == NULL) {
+    perror(opts->path);
+    return -1;
+  }
+
+  struct vtpc_trace_header header;
+  if (fread(&header, sizeof(header), 1, in) != 1 || header.magic != VTPC_TRACE_MAGIC ||
+      header.record_size != sizeof(struct vtpc_trace_record)) {
+    fprintf(stderr, "%s: not a vtpc trace\n", opts->path);
+    fclose(in);
+    return -1;
+  }
+
+  uint64_t threshold = (uint64_t)(opts->rate * (double)(1ULL << SIM_SAMPLE_BITS));
+  struct sim_map map = {0};
+  struct vtpc_trace_record records[1024];
+  int result = 0;
+  size_t got = 0;
+  while (result == 0 && (got = fread(records, sizeof(records[0]), 1024, in)) > 0) {
+    for (size_t i = 0; i < got && result == 0; ++i) {
+      const struct vtpc_trace_record* record = &records[i];
+      if (record->op == VTPC_TRACE_FSYNC || record->length == 0)
+        continue;
+
+      uint64_t first = record->offset / opts->page_size;
+      uint64_t last = (record->offset + record->length - 1) / opts->page_size;
+      for (uint64_t page = first; page <= last; ++page) {
+        uint64_t key = ((uint64_t)record->file << 48U) ^ page;
+        uint64_t hash = sim_hash(key);
+        trace->total++;
+        if ((hash & ((1ULL << SIM_SAMPLE_BITS) - 1)) >= threshold)
+          continue;
+        if (sim_trace_add(trace, &map, key, hash) != 0) {
+          perror("vtpc_sim");
+          result = -1;
+          break;
+        }
+      }
+    }
+  }
+
+  free(map.keys);
+  free(map.values);
+  fclose(in);
+  if (result == 0 && trace->count == 0) {
+    fprintf(stderr, "%s: no sampled accesses\n", opts->path);
+    result = -1;
+  }
+  return result;
+}
+
+// Number of pages the policy runs with when a size is scaled by the rate.
+static size_t sim_scaled(size_t size, double rate) {
+  size_t scaled = (size_t)((double)size * rate + 0.5);
+  return (scaled == 0) ? 1 : scaled;
+}
+
+static void sim_print(const char* policy, const struct sim_options* opts, const struct sim_trace* trace,
+                      size_t size, size_t misses) {
+  double ratio = (double)misses / (double)trace->count;
+  printf("%s,%zu,%zu,%zu,%.0f,%.6f\n", policy, size, size * opts->page_size, trace->total,
+         ratio * (double)trace->total, ratio);
+}
+
+// Fenwick tree over access times marks the latest access of every page, so
+// the pages touched since the previous access of a page are a range sum.
+static int sim_lru(const struct sim_options* opts, const struct sim_trace* trace) {
+  int32_t* tree = calloc(trace->count + 1, sizeof(*tree));
+  size_t* last = calloc(trace->pages, sizeof(*last));
+  size_t* hist = calloc(trace->pages + 2, sizeof(*hist));
+  if (tree == NULL || last == NULL || hist == NULL) {
+    free(tree);
+    free(last);
+    free(hist);
+    return -1;
+  }
+
+  size_t cold = 0;
+  for (size_t t = 1; t <= trace->count; ++t) {
+    uint32_t id = trace->ids[t - 1];
+    if (last[id] == 0) {
+      ++cold;
+    } else {
+      int64_t distance = 1;
+      for (size_t i = t - 1; i > 0; i -= i & (~i + 1))
+        distance += tree[i];
+      for (size_t i = last[id]; i > 0; i -= i & (~i + 1))
+        distance -= tree[i];
+      hist[distance]++;
+      for (size_t i = last[id]; i <= trace->count; i += i & (~i + 1))
+        tree[i]--;
+    }
+    for (size_t i = t; i <= trace->count; i += i & (~i + 1))
+      tree[i]++;
+    last[id] = t;
+  }
+
+  // hist[d] turns into the number of reuses with distance >= d.
+  for (size_t d = trace->pages; d > 0; --d)
+    hist[d - 1] += hist[d];
+
+  for (size_t i = 0; i < opts->size_count; ++i) {
+    size_t fits = sim_scaled(opts->sizes[i], opts->rate);
+    size_t far = (fits + 1 <= trace->pages) ? hist[fits + 1] : 0;
+    sim_print("lru", opts, trace, opts->sizes[i], cold + far);
+  }
+
+  free(tree);
+  free(last);
+  free(hist);
+  return 0;
+}
+
+// Recency list, head is the most recently used page; MRU evicts the head.
+static size_t sim_mru(const struct sim_trace* trace, size_t size, uint32_t* prev, uint32_t* next,
+                      uint8_t* resident) {
+  const uint32_t none = UINT32_MAX;
+  uint32_t head = none;
+  size_t used = 0;
+  size_t misses = 0;
+  memset(resident, 0, trace->pages);
+
+  for (size_t t = 0; t < trace->count; ++t) {
+    uint32_t id = trace->ids[t];
+    if (resident[id]) {
+      if (head == id)
+        continue;
+      next[prev[id]] = next[id];
+      if (next[id] != none)
+        prev[next[id]] = prev[id];
+    } else {
+      ++misses;
+      if (used == size) {
+        uint32_t victim = head;
+        head = next[victim];
+        if (head != none)
+          prev[head] = none;
+        resident[victim] = 0;
+      } else {
+        ++used;
+      }
+      resident[id] = 1;
+    }
+    prev[id] = none;
+    next[id] = head;
+    if (head != none)
+      prev[head] = id;
+    head = id;
+  }
+  return misses;
+}
+
+static size_t sim_fifo(const struct sim_trace* trace, size_t size, uint32_t* ring, uint8_t* resident) {
+  size_t used = 0;
+  size_t hand = 0;
+  size_t misses = 0;
+  memset(resident, 0, trace->pages);
+
+  for (size_t t = 0; t < trace->count; ++t) {
+    uint32_t id = trace->ids[t];
+    if (resident[id])
+      continue;
+    ++misses;
+    if (used == size) {
+      resident[ring[hand]] = 0;
+      ring[hand] = id;
+      hand = (hand + 1) % size;
+    } else {
+      ring[used++] = id;
+    }
+    resident[id] = 1;
+  }
+  return misses;
+}
+
+// Same sweep as vtpc: pages enter referenced, the hand clears bits until it
+// finds an unreferenced page.
+static size_t sim_clock(const struct sim_trace* trace, size_t size, uint32_t* ring, uint32_t* slot_of,
+                        uint8_t* referenced) {
+  const uint32_t none = UINT32_MAX;
+  size_t used = 0;
+  size_t hand = 0;
+  size_t misses = 0;
+  for (size_t i = 0; i < trace->pages; ++i)
+    slot_of[i] = none;
+
+  for (size_t t = 0; t < trace->count; ++t) {
+    uint32_t id = trace->ids[t];
+    if (slot_of[id] != none) {
+      referenced[slot_of[id]] = 1;
+      continue;
+    }
+    ++misses;
+    size_t slot = used;
+    if (used == size) {
+      while (referenced[hand]) {
+        referenced[hand] = 0;
+        hand = (hand + 1) % size;
+      }
+      slot = hand;
+      slot_of[ring[slot]] = none;
+      hand = (hand + 1) % size;
+    } else {
+      ++used;
+    }
+    ring[slot] = id;
+    referenced[slot] = 1;
+    slot_of[id] = (uint32_t)slot;
+  }
+  return misses;
+}
+
+struct sim_heap_entry {
+  size_t next_use;
+  uint32_t id;
+};
+
+static void sim_heap_push(struct sim_heap_entry* heap, size_t* len, struct sim_heap_entry entry) {
+  size_t i = (*len)++;
+  while (i > 0 && heap[(i - 1) / 2].next_use < entry.next_use) {
+    heap[i] = heap[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  heap[i] = entry;
+}
+
+static struct sim_heap_entry sim_heap_pop(struct sim_heap_entry* heap, size_t* len) {
+  struct sim_heap_entry top = heap[0];
+  struct sim_heap_entry tail = heap[--(*len)];
+  size_t i = 0;
+  for (;;) {
+    size_t child = 2 * i + 1;
+    if (child >= *len)
+      break;
+    if (child + 1 < *len && heap[child + 1].next_use > heap[child].next_use)
+      ++child;
+    if (heap[child].next_use <= tail.next_use)
+      break;
+    heap[i] = heap[child];
+    i = child;
+  }
+  if (*len > 0)
+    heap[i] = tail;
+  return top;
+}
+
+// Belady's OPT: evict the page whose next use is furthest away. Heap entries
+// go stale when a page is reused, they are skipped on pop.
+static size_t sim_opt(const struct sim_trace* trace, size_t size, const size_t* next_use, size_t* current,
+                      struct sim_heap_entry* heap) {
+  const size_t none = SIZE_MAX;
+  size_t len = 0;
+  size_t used = 0;
+  size_t misses = 0;
+  for (size_t i = 0; i < trace->pages; ++i)
+    current[i] = none;
+
+  for (size_t t = 0; t < trace->count; ++t) {
+    uint32_t id = trace->ids[t];
+    if (current[id] == none) {
+      ++misses;
+      if (used == size) {
+        for (;;) {
+          struct sim_heap_entry top = sim_heap_pop(heap, &len);
+          if (current[top.id] == top.next_use) {
+            current[top.id] = none;
+            break;
+          }
+        }
+      } else {
+        ++used;
+      }
+    }
+    current[id] = next_use[t];
+    sim_heap_push(heap, &len, (struct sim_heap_entry){next_use[t], id});
+  }
+  return misses;
+}
+
+static int sim_policies(const struct sim_options* opts, const struct sim_trace* trace) {
+  static const struct {
+    unsigned policy;
+    const char* name;
+  } names[] = {{SIM_MRU, "mru"}, {SIM_FIFO, "fifo"}, {SIM_CLOCK, "clock"}, {SIM_OPT, "opt"}};
+
+  size_t pages = trace->pages;
+  size_t count = trace->count;
+  uint32_t* words_a = malloc(pages * sizeof(uint32_t));
+  uint32_t* words_b = malloc(pages * sizeof(uint32_t));
+  uint8_t* bytes = malloc(pages);
+  size_t* next_use = NULL;
+  size_t* current = NULL;
+  struct sim_heap_entry* heap = NULL;
+  if ((opts->policies & SIM_OPT) != 0) {
+    next_use = malloc(count * sizeof(*next_use));
+    current = malloc(pages * sizeof(*current));
+    heap = malloc(count * sizeof(*heap));
+  }
+
+  int result = 0;
+  if (words_a == NULL || words_b == NULL || bytes == NULL ||
+      ((opts->policies & SIM_OPT) != 0 && (next_use == NULL || current == NULL || heap == NULL))) {
+    result = -1;
+    goto out;
+  }
+
+  if (next_use != NULL) {
+    // A distinct sentinel per page keeps never-reused pages ordered.
+    for (size_t i = 0; i < pages; ++i)
+      current[i] = SIZE_MAX - i - 1;
+    for (size_t t = count; t > 0; --t) {
+      uint32_t id = trace->ids[t - 1];
+      next_use[t - 1] = current[id];
+      current[id] = t - 1;
+    }
+  }
+
+  for (size_t i = 0; i < opts->size_count; ++i) {
+    size_t size = sim_scaled(opts->sizes[i], opts->rate);
+    for (size_t j = 0; j < sizeof(names) / sizeof(names[0]); ++j) {
+      if ((opts->policies & names[j].policy) == 0)
+        continue;
+
+      // Nothing is evicted once the whole working set fits.
+      size_t misses = pages;
+      if (size < pages) {
+        switch (names[j].policy) {
+          case SIM_MRU:
+            misses = sim_mru(trace, size, words_a, words_b, bytes);
+            break;
+          case SIM_FIFO:
+            misses = sim_fifo(trace, size, words_a, bytes);
+            break;
+          case SIM_CLOCK:
+            memset(bytes, 0, size);
+            misses = sim_clock(trace, size, words_a, words_b, bytes);
+            break;
+          default:
+            misses = sim_opt(trace, size, next_use, current, heap);
+            break;
+        }
+      }
+      sim_print(names[j].name, opts, trace, opts->sizes[i], misses);
+    }
+  }
+
+out:
+  free(words_a);
+  free(words_b);
+  free(bytes);
+  free(next_use);
+  free(current);
+  free(heap);
+  return result;
+}
+
+static int parse_policies(const char* text, unsigned* policies) {
+  static const struct {
+    const char* name;
+    unsigned policy;
+  } names[] = {
+      {"lru", SIM_LRU}, {"mru", SIM_MRU}, {"fifo", SIM_FIFO}, {"clock", SIM_CLOCK}, {"opt", SIM_OPT},
+  };
+
+  *policies = 0;
+  while (*text != '\0') {
+    size_t len = strcspn(text, ",");
+    size_t i = 0;
+    while (i < sizeof(names) / sizeof(names[0]) &&
+           (strlen(names[i].name) != len || strncmp(text, names[i].name, len) != 0))
+      ++i;
+    if (i == sizeof(names) / sizeof(names[0]))
+      return -1;
+    *policies |= names[i].policy;
+    text += len;
+    if (*text == ',')
+      ++text;
+  }
+  return (*policies != 0) ? 0 : -1;
+}
+
+static int parse_sizes(const char* text, struct sim_options* opts) {
+  opts->size_count = 0;
+  while (*text != '\0') {
+    char* end = NULL;
+    errno = 0;
+    unsigned long long size = strtoull(text, &end, 10);
+    if (errno != 0 || end == text || size == 0 || opts->size_count == SIM_MAX_SIZES ||
+        (*end != ',' && *end != '\0'))
+      return -1;
+    opts->sizes[opts->size_count++] = (size_t)size;
+    text = (*end == ',') ? end + 1 : end;
+  }
+  return (opts->size_count != 0) ? 0 : -1;
+}
+
+static void print_usage(const char* prog) {
+  fprintf(stderr,
+          "Usage: %s --trace <path> [--page_size <bytes>] [--sizes N,N,...]\n"
+          "          [--policy lru,mru,fifo,clock,opt] [--sample <rate>]\n",
+          prog);
+}
+
+static int parse_args(int argc, char* argv[], struct sim_options* opts) {
+  memset(opts, 0, sizeof(*opts));
+  opts->page_size = 4096;
+  opts->policies = SIM_LRU | SIM_MRU | SIM_FIFO | SIM_CLOCK | SIM_OPT;
+  opts->rate = 1.0;
+
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+      opts->path = argv[++i];
+    } else if (strcmp(argv[i], "--page_size") == 0 && i + 1 < argc) {
+      opts->page_size = (size_t)strtoull(argv[++i], NULL, 10);
+      if (opts->page_size == 0) {
+        fprintf(stderr, "page_size must be > 0\n");
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+      if (parse_sizes(argv[++i], opts) != 0) {
+        fprintf(stderr, "Invalid --sizes value: %s\n", argv[i]);
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--policy") == 0 && i + 1 < argc) {
+      if (parse_policies(argv[++i], &opts->policies) != 0) {
+        fprintf(stderr, "Unknown --policy value: %s\n", argv[i]);
+        return -1;
+      }
+    } else if (strcmp(argv[i], "--sample") == 0 && i + 1 < argc) {
+      opts->rate = strtod(argv[++i], NULL);
+      if (!(opts->rate > 0.0 && opts->rate <= 1.0)) {
+        fprintf(stderr, "sample must be in (0, 1]\n");
+        return -1;
+      }
+    } else {
+      fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+      return -1;
+    }
+  }
+
+  if (opts->path == NULL) {
+    fprintf(stderr, "--trace is required\n");
+    return -1;
+  }
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
+  struct sim_options opts;
+  if (parse_args(argc, argv, &opts) != 0) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  struct sim_trace trace = {0};
+  if (sim_load(&opts, &trace) != 0) {
+    free(trace.ids);
+    return 1;
+  }
+
+  // By default double the cache from one page up to the estimated working set.
+  if (opts.size_count == 0) {
+    size_t working_set = (size_t)((double)trace.pages / opts.rate + 0.5);
+    for (size_t size = 1; opts.size_count < SIM_MAX_SIZES; size *= 2) {
+      opts.sizes[opts.size_count++] = (size < working_set) ? size : working_set;
+      if (size >= working_set)
+        break;
+    }
+  }
+
+  printf("policy,cache_pages,cache_bytes,accesses,misses,miss_ratio\n");
+  int result = 0;
+  if ((opts.policies & SIM_LRU) != 0)
+    result = sim_lru(&opts, &trace);
+  if (result == 0)
+    result = sim_policies(&opts, &trace);
+  if (result != 0)
+    perror("vtpc_sim");
+
+  free(trace.ids);
+  return (result == 0) ? 0 : 1;
+}
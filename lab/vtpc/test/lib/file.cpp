@@ -137,4 +137,21 @@ auto file::open_vtpc(std::string_view path) -> std::unique_ptr<file> {
   return std::make_unique<io_file>(path, std::move(io));
 }
 
+auto file::open_vtpc(std::string_view path, const vtpc_options& options)
+    -> std::unique_ptr<file> {
+  io io = {
+      .open =
+          [options](const char* path, int mode, int access) {
+            return ::vtpc_open_ex(path, mode, access, &options);
+          },
+      .close = ::vtpc_close,
+      .read = ::vtpc_read,
+      .write = ::vtpc_write,
+      .lseek = ::vtpc_lseek,
+      .fsync = ::vtpc_fsync,
+  };
+
+  return std::make_unique<io_file>(path, std::move(io));
+}
+
 }  // namespace vt
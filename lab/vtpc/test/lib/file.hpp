@@ -9,6 +9,8 @@
 
 #include "exception.hpp"
 
+struct vtpc_options;
+
 namespace vt {
 
 class file_exception : public vt::exception {
@@ -41,6 +43,8 @@ public:
 
   static auto open_libc(std::string_view path) -> std::unique_ptr<file>;
   static auto open_vtpc(std::string_view path) -> std::unique_ptr<file>;
+  static auto open_vtpc(std::string_view path, const vtpc_options& options)
+      -> std::unique_ptr<file>;
 };
 
 }  // namespace vt
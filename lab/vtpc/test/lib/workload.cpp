@@ -0,0 +1,71 @@
+#include "workload.hpp"
+
+#include <sys/types.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "exception.hpp"
+#include "file.hpp"
+
+namespace vt {
+
+auto check(bool ok, const char* what) -> void {
+  if (!ok) {
+    throw vt::exception() << what << ": "
+                          << strerror(errno);  // NOLINT(concurrency-mt-unsafe)
+  }
+}
+
+auto random_string(std::default_random_engine& random, size_t size) -> std::string {
+  std::uniform_int_distribution<uint8_t> char_dist(0);
+  std::string string(size, ' ');
+  for (char& c : string) {
+    c = static_cast<char>(char_dist(random));
+  }
+  return string;
+}
+
+auto random_text(std::default_random_engine& random, size_t size) -> std::string {
+  std::uniform_int_distribution<uint8_t> text_dist('a', 'd');
+  std::string string(size, ' ');
+  for (char& c : string) {
+    c = static_cast<char>(text_dist(random));
+  }
+  return string;
+}
+
+auto run_workload(file& file, std::default_random_engine& random, const workload& load)
+    -> void {
+  std::uniform_int_distribution<size_t> action_dist(0, 100);  // NOLINT
+  std::uniform_int_distribution<size_t> text_dist(0, 99);     // NOLINT
+  std::uniform_int_distribution<off_t> offset_dist(0, static_cast<off_t>(load.size));
+  std::uniform_int_distribution<size_t> batch_dist(0, load.batch);
+
+  for (size_t i = 0; i < load.steps; ++i) {
+    try {
+      size_t point = action_dist(random);
+      if (point < load.read) {
+        file.read(batch_dist(random));
+      } else if (point < load.read + load.write) {
+        size_t batch = batch_dist(random);
+        file.write(
+            text_dist(random) < load.text ? random_text(random, batch)
+                                          : random_string(random, batch)
+        );
+      } else if (point < load.read + load.write + load.seek) {
+        file.seek(offset_dist(random));
+      } else {
+        file.sync();
+      }
+    } catch (vt::file_exception& e) {  // NOLINT
+      // Do nothing
+    }
+  }
+}
+
+}  // namespace vt
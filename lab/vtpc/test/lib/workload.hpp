@@ -0,0 +1,39 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <cstddef>
+#include <random>
+#include <string>
+
+#include "file.hpp"
+
+namespace vt {
+
+// Throws with the errno message when a C call failed.
+auto check(bool ok, const char* what) -> void;
+
+auto random_string(std::default_random_engine& random, size_t size) -> std::string;
+
+// Compressible text of a few distinct letters.
+auto random_text(std::default_random_engine& random, size_t size) -> std::string;
+
+// Percentages of a random workload, what is left over syncs.
+struct workload {
+  size_t steps;
+  size_t size;
+  size_t batch;
+  size_t read;
+  size_t write;
+  size_t seek;
+  // Share of writes that use random_text.
+  size_t text = 0;
+};
+
+// Reads, writes, seeks and syncs at random offsets within [0, size].
+// Failures of single operations, such as reads past the end, are ignored:
+// a cmp_file has already compared them.
+auto run_workload(file& file, std::default_random_engine& random, const workload& load)
+    -> void;
+
+}  // namespace vt
@@ -0,0 +1,90 @@
+#include <sys/types.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+
+#include "cmp_file.hpp"
+#include "file.hpp"
+#include "workload.hpp"
+
+extern "C" {
+#include <fcntl.h>
+
+#include "vtpc.h"
+}
+
+auto main() -> int try {
+  constexpr size_t seed = 5;
+  constexpr size_t steps = (1U << 12U);
+  constexpr size_t size = (1U << 18U);
+  constexpr size_t batch = (1U << 13U);
+
+  std::default_random_engine random(seed);  // NOLINT
+
+  std::uniform_int_distribution<off_t> offset_dist(0, size);
+  std::uniform_int_distribution<size_t> batch_dist(1, batch);
+
+
+  // Unaligned offsets and lengths, with a tail that is not a whole page.
+  const auto run = [&](const vtpc_options& options) {
+    {
+      auto libc = vt::file::open_libc("/tmp/a");
+      auto vtpc = vt::file::open_vtpc("/tmp/b", options);
+      vt::cmp_file cmp(std::move(libc), std::move(vtpc));
+      cmp.seek(0);
+      cmp.write(vt::random_string(random, size + 123));
+      for (size_t i = 0; i < steps; ++i) {
+        try {
+          cmp.seek(offset_dist(random));
+          if (i % 3 == 0) {
+            cmp.write(vt::random_string(random, batch_dist(random)));
+          } else {
+            cmp.read(batch_dist(random));
+          }
+        } catch (vt::file_exception& e) {  // NOLINT
+          // Reads past the end fail on both sides alike
+        }
+      }
+      cmp.sync();
+    }
+
+    auto libc = vt::file::open_libc("/tmp/a");
+    auto vtpc = vt::file::open_vtpc("/tmp/b", options);
+    vt::cmp_file cmp(std::move(libc), std::move(vtpc));
+    cmp.seek(0);
+    cmp.read(size);
+  };
+
+  vtpc_options options;
+  vtpc_options_init(&options);
+  options.capacity = 8;
+
+  for (int direct : {VTPC_DIRECT_OFF, VTPC_DIRECT_AUTO, VTPC_DIRECT_ON}) {
+    options.direct = direct;
+    if (direct == VTPC_DIRECT_ON) {
+      // Some file systems refuse O_DIRECT, which ON reports instead of
+      // falling back.
+      int fd = vtpc_open_ex("/tmp/b", O_RDWR | O_CREAT, 0644, &options);
+      if (fd < 0 && errno == EINVAL) {
+        std::cout << "O_DIRECT is not supported on /tmp, skipping\n";
+        continue;
+      }
+      if (fd < 0) {
+        throw vt::exception() << "vtpc_open_ex failed";
+      }
+      vtpc_close(fd);
+    }
+    run(options);
+  }
+
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
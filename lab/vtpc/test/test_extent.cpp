@@ -0,0 +1,111 @@
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+
+#include "cmp_file.hpp"
+#include "exception.hpp"
+#include "file.hpp"
+#include "workload.hpp"
+
+extern "C" {
+#include <fcntl.h>
+
+#include "vtpc.h"
+}
+
+auto main() -> int try {
+  constexpr size_t seed = 6;
+  constexpr size_t steps = (1U << 11U);
+  constexpr size_t size = (1U << 22U);
+  constexpr size_t extent = (1U << 18U);
+
+  vtpc_options options;
+  vtpc_options_init(&options);
+  options.capacity = 256;  // NOLINT
+  options.extent_bytes = extent;
+
+  std::default_random_engine random(seed);  // NOLINT
+
+  std::uniform_int_distribution<size_t> action_dist(0, 100);  // NOLINT
+  std::uniform_int_distribution<size_t> extent_dist(0, size / extent);
+  std::uniform_int_distribution<off_t> offset_dist(0, size);
+  std::uniform_int_distribution<size_t> small_dist(0, 1U << 13U);
+  std::uniform_int_distribution<size_t> large_dist(extent, 2 * extent);
+
+
+  {
+    auto libc = vt::file::open_libc("/tmp/a");
+    auto vtpc = vt::file::open_vtpc("/tmp/b", options);
+    vt::cmp_file file(std::move(libc), std::move(vtpc));
+
+    file.seek(0);
+    file.write(vt::random_string(random, size));
+
+    // Large aligned reads become extents, small writes land inside them or
+    // in single pages next to them.
+    for (size_t i = 0; i < steps; ++i) {
+      try {
+        size_t point = action_dist(random);
+        if (point < 40) {  // NOLINT
+          file.seek(static_cast<off_t>(extent_dist(random) * extent));
+          file.read(large_dist(random));
+        } else if (point < 60) {  // NOLINT
+          file.read(small_dist(random));
+        } else if (point < 80) {  // NOLINT
+          file.write(vt::random_string(random, small_dist(random)));
+        } else if (point < 98) {  // NOLINT
+          file.seek(offset_dist(random));
+        } else {
+          file.sync();
+        }
+      } catch (vt::file_exception& e) {  // NOLINT
+        // Do nothing
+      }
+    }
+  }
+
+  int fd = vtpc_open_ex("/tmp/b", O_RDONLY, 0, &options);
+  vt::check(fd >= 0, "open");
+  std::string block(extent, ' ');
+  for (int pass = 0; pass < 2; ++pass) {
+    for (size_t off = 0; off < size; off += extent) {
+      vt::check(vtpc_pread(fd, block.data(), extent, static_cast<off_t>(off)) == extent, "read");
+    }
+  }
+
+  vtpc_stats stats;
+  vt::check(vtpc_get_stats(fd, &stats) == 0, "stats");
+  if (stats.extent_fills == 0) {
+    throw vt::exception() << "large reads were not cached as extents";
+  }
+  vt::check(vtpc_close(fd) == 0, "close");
+
+  // A write past a short tail grows the file in the cache only, the bytes in
+  // between read as a hole whether or not the read becomes an extent.
+  for (size_t read_size : {static_cast<size_t>(1000), 2 * extent}) {
+    vt::check(truncate("/tmp/a", 100) == 0 && truncate("/tmp/b", 100) == 0, "truncate");  // NOLINT
+    auto libc = vt::file::open_libc("/tmp/a");
+    auto vtpc = vt::file::open_vtpc("/tmp/b", options);
+    vt::cmp_file file(std::move(libc), std::move(vtpc));
+
+    file.seek(0);
+    file.read(100);  // NOLINT
+    file.seek(static_cast<off_t>(2 * extent));
+    file.write(vt::random_string(random, 10));  // NOLINT
+    file.seek(0);
+    file.read(read_size);
+    file.seek(0);
+    file.read(2 * extent + 10);  // NOLINT
+  }
+
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
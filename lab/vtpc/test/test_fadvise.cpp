@@ -0,0 +1,161 @@
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include "exception.hpp"
+#include "workload.hpp"
+
+extern "C" {
+#include <fcntl.h>
+
+#include "vtpc.h"
+}
+
+namespace {
+
+constexpr size_t kBlock = 1000;
+constexpr size_t kBlocks = 512;
+
+auto expected_block(size_t index) -> std::string {
+  std::string text = std::to_string(index);
+  std::string block(kBlock, '.');
+  block.replace(0, text.size(), text);
+  return block;
+}
+
+auto verify(int fd, size_t first, size_t step) -> void {
+  std::string block(kBlock, ' ');
+  for (size_t i = first; i < kBlocks; i += step) {
+    vt::check(vtpc_lseek(fd, static_cast<off_t>(i * kBlock), SEEK_SET) >= 0, "seek");
+    vt::check(vtpc_read(fd, block.data(), kBlock) == kBlock, "read");
+    if (block != expected_block(i)) {
+      throw vt::exception() << "block " << i << " differs";
+    }
+  }
+}
+
+auto stats_of(int fd) -> vtpc_stats {
+  vtpc_stats stats{};
+  vt::check(vtpc_get_stats(fd, &stats) == 0, "stats");
+  return stats;
+}
+
+auto read_pages(int fd, size_t first, size_t count) -> void {
+  const auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  std::string block(page, ' ');
+  for (size_t i = first; i < first + count; ++i) {
+    const auto offset = static_cast<off_t>(i * page);
+    vt::check(vtpc_pread(fd, block.data(), page, offset) == static_cast<ssize_t>(page), "read");
+  }
+}
+
+// A fresh handle per hint, reading whole pages without readahead unless the
+// hint is about readahead itself.
+auto check_hints(const vtpc_options& options) -> void {
+  const auto page = static_cast<off_t>(sysconf(_SC_PAGESIZE));
+  const auto open = [&](int pattern) {
+    int fd = vtpc_open_ex("/tmp/c", O_RDONLY, 0, &options);
+    vt::check(fd >= 0, "open");
+    vt::check(vtpc_fadvise(fd, 0, 0, pattern) == 0, "fadvise");
+    return fd;
+  };
+
+  int fd = open(VTPC_FADV_RANDOM);
+  read_pages(fd, 0, 16);  // NOLINT
+  if (const vtpc_stats stats = stats_of(fd); stats.readahead_pages != 0) {
+    throw vt::exception() << "RANDOM read ahead " << stats.readahead_pages << " pages";
+  }
+  vt::check(vtpc_close(fd) == 0, "close");
+
+  fd = open(VTPC_FADV_RANDOM);
+  vt::check(vtpc_fadvise(fd, 0, 4 * page, VTPC_FADV_WILLNEED) == 0, "fadvise");
+  read_pages(fd, 0, 4);
+  if (const vtpc_stats stats = stats_of(fd); stats.willneed_pages == 0 || stats.misses != 0) {
+    throw vt::exception() << "WILLNEED prefetched " << stats.willneed_pages << " pages, then "
+                          << stats.misses << " reads missed";
+  }
+  vt::check(vtpc_close(fd) == 0, "close");
+
+  fd = open(VTPC_FADV_RANDOM);
+  read_pages(fd, 0, 4);
+  vt::check(vtpc_fadvise(fd, 0, 4 * page, VTPC_FADV_DONTNEED) == 0, "fadvise");
+  const vtpc_stats dropped = stats_of(fd);
+  read_pages(fd, 0, 4);
+  if (const vtpc_stats stats = stats_of(fd);
+      dropped.dropped_pages != 4 || stats.misses != dropped.misses + 4) {
+    throw vt::exception() << "DONTNEED dropped " << dropped.dropped_pages << " pages, then "
+                          << stats.misses - dropped.misses << " of 4 reads missed";
+  }
+  vt::check(vtpc_close(fd) == 0, "close");
+
+  // Pages 20 and 21 evict the NOREUSE pages 0-3 rather than any of 10-13,
+  // which MRU alone would pick.
+  fd = open(VTPC_FADV_RANDOM);
+  vt::check(vtpc_fadvise(fd, 0, 4 * page, VTPC_FADV_NOREUSE) == 0, "fadvise");
+  read_pages(fd, 0, 4);
+  read_pages(fd, 10, 4);  // NOLINT
+  read_pages(fd, 20, 2);  // NOLINT
+  const vtpc_stats before = stats_of(fd);
+  read_pages(fd, 10, 4);  // NOLINT
+  if (const vtpc_stats stats = stats_of(fd); stats.hits != before.hits + 4) {
+    throw vt::exception() << "NOREUSE kept " << stats.hits - before.hits
+                          << " of 4 reused pages";
+  }
+  vt::check(vtpc_close(fd) == 0, "close");
+}
+
+}  // namespace
+
+auto main() -> int try {
+  vtpc_options options;
+  vtpc_options_init(&options);
+  options.capacity = 8;  // NOLINT
+
+  int fd = vtpc_open_ex("/tmp/c", O_RDWR | O_CREAT | O_TRUNC, 0644, &options);
+  vt::check(fd >= 0, "open");
+
+  for (size_t i = 0; i < kBlocks; ++i) {
+    std::string block = expected_block(i);
+    vt::check(vtpc_write(fd, block.data(), kBlock) == kBlock, "write");
+  }
+
+  const off_t size = static_cast<off_t>(kBlocks * kBlock);
+  const int hints[] = {
+      VTPC_FADV_SEQUENTIAL,
+      VTPC_FADV_RANDOM,
+      VTPC_FADV_WILLNEED,
+      VTPC_FADV_DONTNEED,
+      VTPC_FADV_NOREUSE,
+      VTPC_FADV_NORMAL,
+  };
+  for (int hint : hints) {
+    vt::check(vtpc_fadvise(fd, 0, size / 2, hint) == 0, "fadvise");
+    verify(fd, 0, 1);
+    verify(fd, 3, 7);  // NOLINT
+  }
+
+  vt::check(vtpc_fadvise(fd, 0, 0, VTPC_FADV_DONTNEED) == 0, "fadvise");
+  vt::check(vtpc_close(fd) == 0, "close");
+
+  fd = vtpc_open("/tmp/c", O_RDONLY, 0);
+  vt::check(fd >= 0, "reopen");
+  verify(fd, 0, 1);
+
+  vtpc_stats stats;
+  vt::check(vtpc_get_stats(fd, &stats) == 0, "stats");
+  if (stats.readahead_pages == 0) {
+    throw vt::exception() << "sequential scan did not read ahead";
+  }
+  vt::check(vtpc_close(fd) == 0, "close");
+
+  check_hints(options);
+
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
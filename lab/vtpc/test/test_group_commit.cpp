@@ -0,0 +1,171 @@
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <iterator>
+#include <latch>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "exception.hpp"
+#include "file.hpp"
+#include "workload.hpp"
+
+extern "C" {
+#include <fcntl.h>
+
+#include "vtpc.h"
+}
+
+namespace {
+
+auto record(size_t writer, size_t index, size_t size) -> std::string {
+  std::string text(size, static_cast<char>('a' + writer));
+  text[0] = static_cast<char>('0' + index % 10);  // NOLINT
+  return text;
+}
+
+// Writers append small records to their own region of one file through
+// their own handles and fsync after each. The group must sync the file far
+// less often than it is asked to, and the data must all be there.
+auto check_one_file() -> void {
+  constexpr size_t writers = 8;
+  constexpr size_t commits = 64;
+  constexpr size_t record_size = 100;
+  constexpr size_t region = (1U << 16U);
+  constexpr unsigned window_us = 200;
+  constexpr const char* path = "/tmp/group_commit";
+
+  vt::check(vtpc_set_group_commit(1, window_us) == 0, "vtpc_set_group_commit");
+  {
+    auto file = vt::file::open_libc(path);
+    file->seek(0);
+    file->write(std::string(writers * region, ' '));
+  }
+
+  std::vector<int> handles(writers);
+  for (int& handle : handles) {
+    handle = vtpc_open(path, O_RDWR, 0);
+    vt::check(handle >= 0, "vtpc_open");
+  }
+
+  std::vector<std::string> failures(writers);
+  {
+    std::vector<std::jthread> threads;
+    for (size_t w = 0; w < writers; ++w) {
+      threads.emplace_back([&, w] {
+        for (size_t i = 0; i < commits; ++i) {
+          std::string text = record(w, i, record_size);
+          off_t offset = static_cast<off_t>(w * region + i * record_size);
+          if (vtpc_pwrite(handles[w], text.data(), text.size(), offset) !=
+              static_cast<ssize_t>(text.size())) {
+            failures[w] = "vtpc_pwrite";
+            return;
+          }
+          if (vtpc_fsync(handles[w]) != 0) {
+            failures[w] = "vtpc_fsync";
+            return;
+          }
+        }
+      });
+    }
+  }
+
+  for (const std::string& failure : failures) {
+    vt::check(failure.empty(), failure.c_str());
+  }
+
+  uint64_t syncs = 0;
+  for (int handle : handles) {
+    vtpc_stats stats{};
+    vt::check(vtpc_get_stats(handle, &stats) == 0, "vtpc_get_stats");
+    syncs += stats.device_syncs;
+    vt::check(vtpc_close(handle) == 0, "vtpc_close");
+  }
+
+  if (syncs * 2 > writers * commits) {
+    throw vt::exception() << "commits were not grouped: " << syncs << " fsyncs";
+  }
+
+  auto file = vt::file::open_libc(path);
+  for (size_t w = 0; w < writers; ++w) {
+    for (size_t i = 0; i < commits; ++i) {
+      file->seek(static_cast<off_t>(w * region + i * record_size));
+      if (file->read(record_size) != record(w, i, record_size)) {
+        throw vt::exception() << "record " << i << " of writer " << w << " is lost";
+      }
+    }
+  }
+
+  unlink(path);
+}
+
+// Commits of distinct files that land in one group must each sync their own
+// file.
+auto check_two_files() -> void {
+  constexpr unsigned window_us = 100000;
+  constexpr const char* paths[] = {"/tmp/group_commit_a", "/tmp/group_commit_b"};
+  constexpr size_t files = std::size(paths);
+
+  vt::check(vtpc_set_group_commit(1, window_us) == 0, "vtpc_set_group_commit");
+
+  std::vector<int> handles(files);
+  for (size_t f = 0; f < files; ++f) {
+    handles[f] = vtpc_open(paths[f], O_RDWR | O_CREAT | O_TRUNC, 0644);  // NOLINT
+    vt::check(handles[f] >= 0, "vtpc_open");
+  }
+
+  std::vector<std::string> failures(files);
+  {
+    std::latch ready(files);
+    std::vector<std::jthread> threads;
+    for (size_t f = 0; f < files; ++f) {
+      threads.emplace_back([&, f] {
+        std::string text = record(f, 0, 100);  // NOLINT
+        if (vtpc_pwrite(handles[f], text.data(), text.size(), 0) !=
+            static_cast<ssize_t>(text.size())) {
+          failures[f] = "vtpc_pwrite";
+        }
+        ready.arrive_and_wait();
+        if (vtpc_fsync(handles[f]) != 0) {
+          failures[f] = "vtpc_fsync";
+        }
+      });
+    }
+  }
+
+  for (const std::string& failure : failures) {
+    vt::check(failure.empty(), failure.c_str());
+  }
+
+  for (size_t f = 0; f < files; ++f) {
+    vtpc_stats stats{};
+    vt::check(vtpc_get_stats(handles[f], &stats) == 0, "vtpc_get_stats");
+    vt::check(vtpc_close(handles[f]) == 0, "vtpc_close");
+    if (stats.device_syncs != 1) {
+      throw vt::exception() << paths[f] << " was synced " << stats.device_syncs << " times";
+    }
+
+    auto file = vt::file::open_libc(paths[f]);
+    file->seek(0);
+    if (file->read(100) != record(f, 0, 100)) {  // NOLINT
+      throw vt::exception() << "record of " << paths[f] << " is lost";
+    }
+    unlink(paths[f]);
+  }
+}
+
+}  // namespace
+
+auto main() -> int try {
+  check_one_file();
+  check_two_files();
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
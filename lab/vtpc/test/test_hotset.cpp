@@ -0,0 +1,119 @@
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+
+#include "exception.hpp"
+#include "file.hpp"
+#include "workload.hpp"
+
+extern "C" {
+#include <fcntl.h>
+
+#include "vtpc.h"
+}
+
+namespace {
+
+constexpr const char* kPath = "/tmp/hotset";
+constexpr const char* kHotset = "/tmp/hotset.hot";
+constexpr size_t kPages = 64;
+constexpr size_t kCapacity = 16;
+constexpr size_t kFirst = 10;
+constexpr size_t kHot = 10;
+
+auto open_cache(bool hotset) -> int {
+  vtpc_options options;
+  vtpc_options_init(&options);
+  options.capacity = kCapacity;
+  options.hotset_path = hotset ? kHotset : nullptr;
+
+  int fd = vtpc_open_ex(kPath, O_RDWR, 0, &options);
+  vt::check(fd >= 0, "vtpc_open_ex");
+  return fd;
+}
+
+// Reads every page through the cache and compares it with libc.
+auto check_data(int fd) -> void {
+  const auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  auto file = vt::file::open_libc(kPath);
+  std::string block(page, ' ');
+  for (size_t i = 0; i < kPages; ++i) {
+    const auto offset = static_cast<off_t>(i * page);
+    vt::check(vtpc_pread(fd, block.data(), page, offset) == static_cast<ssize_t>(page), "vtpc_pread");
+    file->seek(offset);
+    if (block != file->read(page)) {
+      throw vt::exception() << "page " << i << " differs from libc";
+    }
+  }
+}
+
+auto restored_pages(int fd) -> uint64_t {
+  vtpc_stats stats{};
+  vt::check(vtpc_get_stats(fd, &stats) == 0, "vtpc_get_stats");
+  return stats.hotset_pages;
+}
+
+}  // namespace
+
+// A snapshot of the pages a handle held is prefetched by the next handle,
+// unless the file changed in between.
+auto main() -> int try {
+  const auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  std::default_random_engine random(8);  // NOLINT
+
+  {
+    auto file = vt::file::open_libc(kPath);
+    file->seek(0);
+    file->write(vt::random_string(random, kPages * page));
+  }
+  std::remove(kHotset);  // NOLINT(cert-err33-c)
+
+  // Without readahead the handle holds exactly the pages it read.
+  int fd = open_cache(false);
+  vt::check(vtpc_fadvise(fd, 0, 0, VTPC_FADV_RANDOM) == 0, "vtpc_fadvise");
+  std::string block(page, ' ');
+  for (size_t i = kFirst; i < kFirst + kHot; ++i) {
+    const auto offset = static_cast<off_t>(i * page);
+    vt::check(vtpc_pread(fd, block.data(), page, offset) == static_cast<ssize_t>(page), "vtpc_pread");
+  }
+  vt::check(vtpc_save_hotset(fd, kHotset) == 0, "vtpc_save_hotset");
+  vt::check(vtpc_close(fd) == 0, "vtpc_close");
+
+  fd = open_cache(true);
+  if (const uint64_t restored = restored_pages(fd); restored != kHot) {
+    throw vt::exception() << "restored " << restored << " pages instead of " << kHot;
+  }
+  check_data(fd);
+  vt::check(vtpc_close(fd) == 0, "vtpc_close");
+
+  // Timestamps may be coarser than the time the test takes.
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));  // NOLINT
+  {
+    auto file = vt::file::open_libc(kPath);
+    file->seek(static_cast<off_t>(kFirst * page));
+    file->write(vt::random_string(random, page));
+  }
+
+  fd = open_cache(true);
+  if (const uint64_t restored = restored_pages(fd); restored != 0) {
+    throw vt::exception() << "restored " << restored << " pages of a stale hotset";
+  }
+  check_data(fd);
+  vt::check(vtpc_close(fd) == 0, "vtpc_close");
+
+  std::remove(kHotset);  // NOLINT(cert-err33-c)
+  unlink(kPath);
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
@@ -0,0 +1,115 @@
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "exception.hpp"
+#include "file.hpp"
+#include "workload.hpp"
+
+extern "C" {
+#include <fcntl.h>
+
+#include "vtpc.h"
+}
+
+auto main() -> int try {
+  constexpr size_t seed = 7;
+  constexpr size_t steps = (1U << 12U);
+  constexpr size_t size = (1U << 20U);
+  constexpr size_t capacity = 64;
+  constexpr const char* path = "/tmp/map";
+
+  std::default_random_engine random(seed);  // NOLINT
+  std::uniform_int_distribution<uint8_t> char_dist(0);
+  std::uniform_int_distribution<off_t> offset_dist(0, size - 1);
+
+  std::string expected = vt::random_string(random, size);
+  {
+    auto file = vt::file::open_libc(path);
+    file->seek(0);
+    file->write(expected);
+    file->sync();
+  }
+
+  vtpc_options options;
+  vtpc_options_init(&options);
+  options.capacity = capacity;
+  int fd = vtpc_open_ex(path, O_RDWR, 0, &options);
+  vt::check(fd >= 0, "vtpc_open_ex");
+
+  // An unaligned read-only window sees the file.
+  constexpr off_t ro_offset = 1000;
+  constexpr size_t ro_len = 100000;
+  const char* ro = static_cast<const char*>(vtpc_map(fd, ro_offset, ro_len, PROT_READ));
+  vt::check(ro != nullptr, "vtpc_map");
+  vt::check(memcmp(ro, expected.data() + ro_offset, ro_len) == 0, "read-only window");
+
+  // Stores through a writable window are visible to vtpc_pread() at once.
+  constexpr off_t rw_offset = 600000;
+  constexpr size_t rw_len = 50000;
+  char* rw = static_cast<char*>(vtpc_map(fd, rw_offset, rw_len, PROT_READ | PROT_WRITE));
+  vt::check(rw != nullptr, "vtpc_map");
+  for (size_t i = 0; i < rw_len; i += 97) {  // NOLINT
+    rw[i] = static_cast<char>(char_dist(random));
+    expected[rw_offset + i] = rw[i];
+  }
+  std::string text(rw_len, 0);
+  vt::check(vtpc_pread(fd, text.data(), rw_len, rw_offset) == static_cast<ssize_t>(rw_len), "vtpc_pread");
+  vt::check(text == expected.substr(rw_offset, rw_len), "writable window");
+
+  // Windows stay pinned while reads all over the file evict everything else.
+  std::string buffer(4096, 0);  // NOLINT
+  for (size_t i = 0; i < steps; ++i) {
+    off_t offset = offset_dist(random);
+    size_t count = std::min(buffer.size(), size - static_cast<size_t>(offset));
+    vt::check(vtpc_pread(fd, buffer.data(), count, offset) == static_cast<ssize_t>(count), "vtpc_pread");
+    vt::check(memcmp(buffer.data(), expected.data() + offset, count) == 0, "pread");
+  }
+  vt::check(memcmp(ro, expected.data() + ro_offset, ro_len) == 0, "read-only window after eviction");
+  vt::check(memcmp(rw, expected.data() + rw_offset, rw_len) == 0, "writable window after eviction");
+
+  vtpc_stats stats{};
+  vt::check(vtpc_get_stats(fd, &stats) == 0, "vtpc_get_stats");
+  vt::check(stats.evictions > 0, "no evictions");
+
+  errno = 0;
+  vt::check(vtpc_map(fd, size - 10, 11, PROT_READ) == nullptr && errno == EINVAL, "map past EOF");
+  errno = 0;
+  vt::check(vtpc_map(fd, 0, size, PROT_READ) == nullptr && errno == ENOMEM, "map more than capacity");
+
+  vt::check(vtpc_fsync(fd) == 0, "vtpc_fsync");
+  {
+    auto file = vt::file::open_libc(path);
+    file->seek(rw_offset);
+    vt::check(file->read(rw_len) == expected.substr(rw_offset, rw_len), "synced window");
+  }
+
+  // Stores after the sync reach the file on close.
+  rw[0] = static_cast<char>(expected[rw_offset] ^ 1);
+  expected[rw_offset] = rw[0];
+  vt::check(vtpc_unmap(fd, const_cast<char*>(ro)) == 0, "vtpc_unmap");
+  vt::check(vtpc_unmap(fd, const_cast<char*>(ro)) == -1 && errno == EINVAL, "double vtpc_unmap");
+  vt::check(vtpc_close(fd) == 0, "vtpc_close");
+
+  {
+    auto file = vt::file::open_libc(path);
+    file->seek(0);
+    vt::check(file->read(size) == expected, "file after close");
+  }
+
+  unlink(path);
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
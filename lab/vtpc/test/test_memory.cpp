@@ -0,0 +1,88 @@
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+
+#include "cmp_file.hpp"
+#include "exception.hpp"
+#include "file.hpp"
+#include "workload.hpp"
+
+extern "C" {
+#include <fcntl.h>
+
+#include "vtpc.h"
+}
+
+auto main() -> int try {
+  constexpr size_t seed = 5;
+  constexpr size_t steps = (1U << 12U);
+  constexpr size_t size = (1U << 18U);
+  constexpr size_t budget_pages = 8;
+
+  const auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+  vtpc_options options;
+  vtpc_options_init(&options);
+  options.capacity = 32;  // NOLINT
+
+  std::default_random_engine random(seed);  // NOLINT
+
+  const auto run = [&](vt::file& file) {
+    vt::run_workload(
+        file,
+        random,
+        {.steps = steps, .size = size, .batch = size / 16, .read = 60, .write = 20, .seek = 21}
+    );
+  };
+
+  int other = vtpc_open_ex("/tmp/c", O_RDWR | O_CREAT | O_TRUNC, 0644, &options);
+  vt::check(other >= 0, "open");
+  std::string text = vt::random_string(random, size);
+  vt::check(vtpc_write(other, text.data(), size) == static_cast<ssize_t>(size), "write");
+
+  {
+    auto libc = vt::file::open_libc("/tmp/a");
+    auto vtpc = vt::file::open_vtpc("/tmp/b", options);
+    vt::cmp_file file(std::move(libc), std::move(vtpc));
+
+    file.seek(0);
+    file.write(vt::random_string(random, size));
+
+    vt::check(vtpc_set_memory_limit(budget_pages * page) == 0, "limit");
+    if (vtpc_get_memory_usage() > budget_pages * page) {
+      throw vt::exception() << "usage " << vtpc_get_memory_usage() << " over the limit";
+    }
+
+    run(file);
+    if (vtpc_get_memory_usage() > budget_pages * page) {
+      throw vt::exception() << "usage " << vtpc_get_memory_usage() << " over the limit";
+    }
+
+    vt::check(vtpc_set_memory_limit(0) == 0, "unlimit");
+    run(file);
+  }
+
+  vtpc_stats stats;
+  vt::check(vtpc_get_stats(other, &stats) == 0, "stats");
+  if (stats.reclaimed_pages == 0) {
+    throw vt::exception() << "lowering the limit reclaimed nothing";
+  }
+
+  std::string back(size, ' ');
+  vt::check(vtpc_pread(other, back.data(), size, 0) == static_cast<ssize_t>(size), "read");
+  if (back != text) {
+    throw vt::exception() << "reclaimed data differs";
+  }
+  vt::check(vtpc_close(other) == 0, "close");
+
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
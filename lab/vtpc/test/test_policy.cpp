@@ -0,0 +1,152 @@
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cmp_file.hpp"
+#include "exception.hpp"
+#include "file.hpp"
+#include "workload.hpp"
+
+extern "C" {
+#include <fcntl.h>
+
+#include "vtpc.h"
+#include "vtpc_trace.h"
+}
+
+namespace {
+
+constexpr const char* kTrace = "/tmp/vtpc-trace";
+
+auto check_trace() -> void {
+  std::ifstream in(kTrace, std::ios::binary);
+  vtpc_trace_header header{};
+  if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||  // NOLINT
+      header.magic != VTPC_TRACE_MAGIC || header.record_size != sizeof(vtpc_trace_record)) {
+    throw vt::exception() << "bad trace header";
+  }
+
+  const auto size = std::filesystem::file_size(kTrace);
+  if (size == sizeof(header) || (size - sizeof(header)) % sizeof(vtpc_trace_record) != 0) {
+    throw vt::exception() << "bad trace size " << size;
+  }
+}
+
+// Reads the given pages one at a time through a 3 page cache and returns
+// the number of hits.
+auto count_hits(int policy, const std::vector<size_t>& pages) -> uint64_t {
+  const auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+  vtpc_options options;
+  vtpc_options_init(&options);
+  options.capacity = 3;
+  options.policy = policy;
+
+  int fd = vtpc_open_ex("/tmp/b", O_RDONLY, 0, &options);
+  vt::check(fd >= 0, "vtpc_open_ex");
+  std::string buffer(page, ' ');
+  for (size_t index : pages) {
+    vt::check(
+        vtpc_pread(fd, buffer.data(), page, static_cast<off_t>(index * page)) ==
+            static_cast<ssize_t>(page),
+        "vtpc_pread"
+    );
+  }
+  vtpc_stats stats{};
+  vt::check(vtpc_get_stats(fd, &stats) == 0, "vtpc_get_stats");
+  vt::check(vtpc_close(fd) == 0, "vtpc_close");
+  if (stats.hits + stats.misses != pages.size()) {
+    throw vt::exception() << stats.hits << " hits and " << stats.misses << " misses for "
+                          << pages.size() << " reads";
+  }
+  return stats.hits;
+}
+
+// A loop over one page more than fits misses every time except under MRU,
+// while a page read between cold ones stays resident under LRU only.
+auto check_hits() -> void {
+  constexpr size_t rounds = 16;
+  constexpr size_t cold = 15;
+
+  std::vector<size_t> loop;
+  std::vector<size_t> hot;
+  for (size_t i = 0; i < rounds; ++i) {
+    loop.insert(loop.end(), {0, 1, 2, 3});
+    hot.insert(hot.end(), {0, 1 + (i % cold)});
+  }
+
+  if (count_hits(VTPC_POLICY_MRU, loop) == 0) {
+    throw vt::exception() << "MRU missed every page of the loop";
+  }
+  for (int policy : {VTPC_POLICY_LRU, VTPC_POLICY_FIFO, VTPC_POLICY_CLOCK}) {
+    if (const uint64_t hits = count_hits(policy, loop); hits != 0) {
+      throw vt::exception() << "policy " << policy << " hit " << hits << " pages of the loop";
+    }
+  }
+
+  const uint64_t lru = count_hits(VTPC_POLICY_LRU, hot);
+  const uint64_t mru = count_hits(VTPC_POLICY_MRU, hot);
+  if (lru != rounds - 1 || mru >= lru) {
+    throw vt::exception() << "hot page hits: LRU " << lru << ", MRU " << mru;
+  }
+}
+
+}  // namespace
+
+auto main() -> int try {
+  constexpr size_t seed = 4;
+  constexpr size_t steps = (1U << 12U);
+  constexpr size_t size = (1U << 16U);
+
+  std::default_random_engine random(seed);  // NOLINT
+
+  for (int policy : {VTPC_POLICY_MRU, VTPC_POLICY_LRU, VTPC_POLICY_FIFO, VTPC_POLICY_CLOCK}) {
+    std::remove(kTrace);  // NOLINT(cert-err33-c)
+
+    vtpc_options options;
+    vtpc_options_init(&options);
+    options.capacity = 3;
+    options.policy = policy;
+    options.trace_path = kTrace;
+
+    {
+      auto libc = vt::file::open_libc("/tmp/a");
+      auto vtpc = vt::file::open_vtpc("/tmp/b", options);
+      vt::cmp_file file(std::move(libc), std::move(vtpc));
+
+      file.seek(0);
+      file.write(vt::random_string(random, size));
+
+      vt::run_workload(
+          file,
+          random,
+          {.steps = steps,
+           .size = size,
+           .batch = size / 16,
+           .read = 60,
+           .write = 15,
+           .seek = 23}
+      );
+    }
+
+    check_trace();
+  }
+
+  check_hits();
+
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
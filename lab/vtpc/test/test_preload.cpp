@@ -0,0 +1,100 @@
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <string_view>
+
+#include "exception.hpp"
+#include "file.hpp"
+#include "workload.hpp"
+
+extern "C" {
+#include "vtpc_trace.h"
+}
+
+namespace {
+
+constexpr const char* kInput = "/tmp/vtpc-preload.dat";
+constexpr const char* kTrace = "/tmp/vtpc-preload.trace";
+
+auto slurp(const std::string& path) -> std::string {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    throw vt::exception() << "cannot read " << path;
+  }
+  return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+auto run(const std::string& command) -> void {
+  if (std::system(command.c_str()) != 0) {  // NOLINT(cert-env33-c, concurrency-mt-unsafe)
+    throw vt::exception() << "failed: " << command;
+  }
+}
+
+// Runs command with and without the preload library, where {out} names the
+// output file of the run. Output and diagnostics must match and the routed
+// run must have gone through vtpc.
+auto compare(const std::string& name, const std::string& command) -> void {
+  const std::string plain = "/tmp/plain-" + name;
+  const std::string routed = "/tmp/vtpc-preload-" + name;
+  const auto with_output = [&](const std::string& out) {
+    std::string text = command;
+    text.replace(text.find("{out}"), std::string_view("{out}").size(), out);
+    return text + " 2> " + out + ".err";
+  };
+
+  std::remove(kTrace);  // NOLINT(cert-err33-c)
+  run(with_output(plain));
+  run(std::string("VTPC_PRELOAD_PATTERN='/tmp/vtpc-preload*' VTPC_PRELOAD_TRACE=") + kTrace +
+      " LD_PRELOAD=" + VTPC_PRELOAD_LIBRARY + " " + with_output(routed));
+
+  if (slurp(plain) != slurp(routed)) {
+    throw vt::exception() << name << ": output differs with the preload library";
+  }
+  if (slurp(plain + ".err") != slurp(routed + ".err")) {
+    throw vt::exception() << name << ": diagnostics differ with the preload library: "
+                          << slurp(routed + ".err");
+  }
+  if (std::filesystem::file_size(kTrace) <= sizeof(vtpc_trace_header)) {
+    throw vt::exception() << name << ": no calls went through vtpc";
+  }
+  for (const std::string& path : {plain, routed, plain + ".err", routed + ".err"}) {
+    unlink(path.c_str());
+  }
+}
+
+}  // namespace
+
+// Unmodified tools read and write routed files as they would without vtpc.
+auto main() -> int try {
+  constexpr size_t size = (1U << 20U) + 123;
+  std::default_random_engine random(9);  // NOLINT
+
+  {
+    auto file = vt::file::open_libc(kInput);
+    file->seek(0);
+    file->write(vt::random_string(random, size));
+  }
+
+  compare("cat", std::string("cat ") + kInput + " > {out}");
+  compare("dd", std::string("dd if=") + kInput + " of={out} bs=3000 skip=5 status=none");
+  compare(
+      "dd-seek",
+      std::string("dd if=") + kInput + " of={out} bs=4096 count=40 seek=3 conv=notrunc status=none"
+  );
+
+  unlink(kInput);
+  std::remove(kTrace);  // NOLINT(cert-err33-c)
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
@@ -0,0 +1,126 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "exception.hpp"
+
+extern "C" {
+#include "vtpc_trace.h"
+}
+
+namespace {
+
+constexpr const char* kTrace = "/tmp/vtpc-sim-trace";
+constexpr uint32_t kPage = 4096;
+
+auto write_trace(const std::vector<uint64_t>& pages) -> void {
+  std::ofstream out(kTrace, std::ios::binary | std::ios::trunc);
+  const vtpc_trace_header header{
+      .magic = VTPC_TRACE_MAGIC, .record_size = sizeof(vtpc_trace_record), .reserved = 0
+  };
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));  // NOLINT
+  for (size_t i = 0; i < pages.size(); ++i) {
+    const vtpc_trace_record record{
+        .timestamp_ns = i,
+        .offset = pages[i] * kPage,
+        .length = kPage,
+        .op = VTPC_TRACE_READ,
+        .file = 0,
+        .tid = 1,
+        .reserved = 0,
+    };
+    out.write(reinterpret_cast<const char*>(&record), sizeof(record));  // NOLINT
+  }
+  if (!out) {
+    throw vt::exception() << "cannot write " << kTrace;
+  }
+}
+
+// Misses by policy and cache size, as printed by vtpc_sim.
+using misses_t = std::map<std::pair<std::string, size_t>, uint64_t>;
+
+auto simulate(const std::string& args) -> misses_t {
+  const std::string command = std::string(VTPC_SIM) + " --trace " + kTrace + " " + args;
+  FILE* pipe = popen(command.c_str(), "r");  // NOLINT(cert-env33-c)
+  if (pipe == nullptr) {
+    throw vt::exception() << "cannot run " << command;
+  }
+  std::string output;
+  char buffer[256];
+  while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {  // NOLINT
+    output += buffer;
+  }
+  if (pclose(pipe) != 0) {
+    throw vt::exception() << "failed: " << command;
+  }
+
+  misses_t misses;
+  std::istringstream lines(output);
+  std::string line;
+  std::getline(lines, line);
+  while (std::getline(lines, line)) {
+    std::istringstream fields(line);
+    std::string policy;
+    std::string field;
+    std::getline(fields, policy, ',');
+    std::getline(fields, field, ',');
+    const size_t size = std::stoul(field);
+    std::getline(fields, field, ',');  // cache_bytes
+    std::getline(fields, field, ',');  // accesses
+    std::getline(fields, field, ',');
+    misses[{policy, size}] = std::stoull(field);
+  }
+  return misses;
+}
+
+auto expect(const misses_t& misses, const std::string& policy, size_t size, uint64_t expected) -> void {
+  const auto it = misses.find({policy, size});
+  if (it == misses.end() || it->second != expected) {
+    throw vt::exception() << policy << " with " << size << " pages: "
+                          << (it == misses.end() ? 0 : it->second) << " misses, expected "
+                          << expected;
+  }
+}
+
+}  // namespace
+
+// vtpc_sim reports the exact miss counts of a known trace.
+auto main() -> int try {
+  // Belady's sequence: FIFO misses more with 4 pages than with 3.
+  write_trace({1, 2, 3, 4, 1, 2, 5, 1, 2, 3, 4, 5});
+  const misses_t misses = simulate("--sizes 3,4 --policy lru,fifo,opt");
+  expect(misses, "lru", 3, 10);  // NOLINT
+  expect(misses, "lru", 4, 8);   // NOLINT
+  expect(misses, "fifo", 3, 9);  // NOLINT
+  expect(misses, "fifo", 4, 10);  // NOLINT
+  expect(misses, "opt", 3, 7);   // NOLINT
+  expect(misses, "opt", 4, 6);   // NOLINT
+
+  // Every page is read twice in a row, so any cache of at least one page
+  // hits the second read. Sampled down, LRU and OPT run with the same
+  // single page.
+  std::vector<uint64_t> pairs;
+  for (uint64_t page = 0; page < 256; ++page) {  // NOLINT
+    pairs.insert(pairs.end(), {page, page});
+  }
+  write_trace(pairs);
+  const misses_t sampled = simulate("--sizes 8 --sample 0.1 --policy lru,opt");
+  if (sampled.at({"lru", 8}) != sampled.at({"opt", 8})) {
+    throw vt::exception() << "sampled LRU misses " << sampled.at({"lru", 8})
+                          << ", OPT misses " << sampled.at({"opt", 8});
+  }
+
+  std::remove(kTrace);  // NOLINT(cert-err33-c)
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
@@ -0,0 +1,150 @@
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "cmp_file.hpp"
+#include "exception.hpp"
+#include "file.hpp"
+#include "workload.hpp"
+
+extern "C" {
+#include <fcntl.h>
+
+#include "vtpc.h"
+}
+
+auto main() -> int try {
+  constexpr size_t seed = 3;
+  constexpr size_t steps = (1U << 13U);
+  constexpr size_t size = (1U << 16U);
+  constexpr size_t batch = (1U << 12U);
+
+  vtpc_options options;
+  vtpc_options_init(&options);
+  options.capacity = 2;
+  options.spill_path = "/tmp/vtpc-spill";
+  options.spill_bytes = (1U << 20U);
+
+  std::default_random_engine random(seed);  // NOLINT
+
+  const auto open = [&] {
+    auto libc = vt::file::open_libc("/tmp/a");
+    auto vtpc = vt::file::open_vtpc("/tmp/b", options);
+    return std::make_unique<vt::cmp_file>(std::move(libc), std::move(vtpc));
+  };
+
+  // Reads every page of a new handle and returns how many came from the
+  // spill, left behind by earlier handles.
+  const auto spill_hits = [&] {
+    const auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    int fd = vtpc_open_ex("/tmp/b", O_RDONLY, 0, &options);
+    vt::check(fd >= 0, "vtpc_open_ex");
+    auto libc = vt::file::open_libc("/tmp/a");
+    std::string block(page, ' ');
+    for (off_t offset = 0;; offset += static_cast<off_t>(page)) {
+      const ssize_t got = vtpc_pread(fd, block.data(), page, offset);
+      vt::check(got >= 0, "vtpc_pread");
+      if (got == 0) {
+        break;
+      }
+      libc->seek(offset);
+      if (block.substr(0, static_cast<size_t>(got)) != libc->read(static_cast<size_t>(got))) {
+        throw vt::exception() << "page at " << offset << " differs from libc";
+      }
+    }
+    vtpc_stats stats{};
+    vt::check(vtpc_get_stats(fd, &stats) == 0, "vtpc_get_stats");
+    vt::check(vtpc_close(fd) == 0, "vtpc_close");
+    return stats.spill_hits;
+  };
+
+  const auto run = [&](vt::file& file, bool write) {
+    vt::run_workload(
+        file,
+        random,
+        {.steps = steps,
+         .size = size,
+         .batch = batch,
+         .read = write ? 40U : 55U,  // NOLINT
+         .write = write ? 15U : 0U,  // NOLINT
+         .seek = 46}  // NOLINT
+    );
+  };
+
+  {
+    auto file = open();
+    file->seek(0);
+    file->write(vt::random_string(random, size));
+    run(*file, true);
+  }
+
+  {
+    auto file = open();
+    run(*file, false);
+  }
+
+  if (spill_hits() == 0) {
+    throw vt::exception() << "no evicted page was read back from the spill";
+  }
+
+  // Timestamps may be coarser than the time the test takes.
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));  // NOLINT
+  {
+    auto libc = vt::file::open_libc("/tmp/a");
+    auto other = vt::file::open_libc("/tmp/b");
+    std::string text = vt::random_string(random, size + batch);
+    for (auto* file : {libc.get(), other.get()}) {
+      file->seek(0);
+      file->write(text);
+    }
+  }
+
+  if (const uint64_t hits = spill_hits(); hits != 0) {
+    throw vt::exception() << hits << " pages of a changed file were read from the spill";
+  }
+
+  {
+    auto file = open();
+    run(*file, true);
+  }
+
+  // Pages dropped with DONTNEED must come from the file, not the spill.
+  {
+    int fd = vtpc_open_ex("/tmp/b", O_RDWR, 0, &options);
+    vt::check(fd >= 0, "vtpc_open_ex");
+    std::string text(size, ' ');
+    vt::check(vtpc_pread(fd, text.data(), size, 0) == static_cast<ssize_t>(size), "vtpc_pread");
+    std::string update = vt::random_string(random, size);
+    vt::check(vtpc_pwrite(fd, update.data(), size, 0) == static_cast<ssize_t>(size), "vtpc_pwrite");
+    vt::check(vtpc_fadvise(fd, 0, 0, VTPC_FADV_DONTNEED) == 0, "vtpc_fadvise");
+
+    vtpc_stats before{};
+    vt::check(vtpc_get_stats(fd, &before) == 0, "vtpc_get_stats");
+    vt::check(vtpc_pread(fd, text.data(), size, 0) == static_cast<ssize_t>(size), "vtpc_pread");
+    vtpc_stats after{};
+    vt::check(vtpc_get_stats(fd, &after) == 0, "vtpc_get_stats");
+    vt::check(vtpc_close(fd) == 0, "vtpc_close");
+    if (after.spill_hits != before.spill_hits) {
+      throw vt::exception() << after.spill_hits - before.spill_hits
+                            << " dropped pages were read from the spill";
+    }
+    if (text != update) {
+      throw vt::exception() << "data differs after DONTNEED";
+    }
+  }
+
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}
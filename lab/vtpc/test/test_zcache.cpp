@@ -0,0 +1,91 @@
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+
+#include "cmp_file.hpp"
+#include "exception.hpp"
+#include "file.hpp"
+#include "workload.hpp"
+
+extern "C" {
+#include <fcntl.h>
+
+#include "vtpc.h"
+}
+
+auto main() -> int try {
+  constexpr size_t seed = 2;
+  constexpr size_t steps = (1U << 14U);
+  constexpr size_t size = (1U << 16U);
+
+  vtpc_options options;
+  vtpc_options_init(&options);
+  options.capacity = 2;
+  options.zcache_bytes = (1U << 14U);
+
+  std::default_random_engine random(seed);  // NOLINT
+
+  {
+    auto libc = vt::file::open_libc("/tmp/a");
+    auto vtpc = vt::file::open_vtpc("/tmp/b", options);
+    vt::cmp_file file(std::move(libc), std::move(vtpc));
+
+    file.seek(0);
+    file.write(vt::random_text(random, size));
+
+    file.seek(0);
+    vt::run_workload(
+        file,
+        random,
+        {.steps = steps,
+         .size = size,
+         .batch = size / 16,
+         .read = 50,
+         .write = 20,
+         .seek = 28,
+         .text = 50}
+    );
+  }
+
+  // Text pages evicted by a scan come back from the compressed tier.
+  const auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  const std::string text = vt::random_text(random, 4 * page);
+  {
+    auto file = vt::file::open_libc("/tmp/b");
+    file->seek(0);
+    file->write(text);
+  }
+
+  int fd = vtpc_open_ex("/tmp/b", O_RDONLY, 0, &options);
+  vt::check(fd >= 0, "vtpc_open_ex");
+  std::string block(page, ' ');
+  for (size_t round = 0; round < 2; ++round) {
+    for (size_t offset = 0; offset < text.size(); offset += page) {
+      vt::check(
+          vtpc_pread(fd, block.data(), page, static_cast<off_t>(offset)) ==
+              static_cast<ssize_t>(page),
+          "vtpc_pread"
+      );
+      vt::check(block == text.substr(offset, page), "page differs");
+    }
+  }
+  vtpc_stats stats{};
+  vt::check(vtpc_get_stats(fd, &stats) == 0, "vtpc_get_stats");
+  vt::check(vtpc_close(fd) == 0, "vtpc_close");
+  if (stats.evictions == 0 || stats.zcache_hits == 0) {
+    throw vt::exception() << stats.zcache_hits << " zcache hits after " << stats.evictions
+                          << " evictions";
+  }
+
+  return 0;
+} catch (const std::exception& e) {
+  std::cerr << "exception: " << e.what() << '\n';
+  return 1;
+}